@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ADAPTIVE_H
+#define __ADAPTIVE_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "parameters.h"
+
+struct flat_combining;
+
+typedef enum {
+	ADAPT_LOCK = 0,
+	ADAPT_FC = 1
+} adapt_mode_t;
+
+/* a mode switch and the metric that triggered it */
+struct adapt_switch {
+	unsigned long update;
+	adapt_mode_t mode;
+	/* contention % to ADAPT_FC, combining degree * 100 to ADAPT_LOCK */
+	unsigned long metric;
+};
+
+/*
+ * the chosen backend either updated directly under the
+ * combiner lock or through flat combining, whichever
+ * suits the contention observed lately
+ */
+typedef struct adapt {
+	const struct data_struct_ops *ops;
+	size_t size;
+	void *leaf;
+	struct flat_combining *fc;
+	adapt_mode_t mode;
+	/* somebody is evaluating the last period */
+	int deciding;
+	/* updates so far, and per mode */
+	unsigned long updates;
+	unsigned long updates_fc;
+	/* lock mode: lock acquisitions and busy ones this period */
+	unsigned long win_direct;
+	unsigned long win_contended;
+	/* combining mode: counters at the start of the period */
+	unsigned long long last_applied;
+	unsigned long long last_passes;
+	/* switch decisions */
+	unsigned long switches[2];
+	struct adapt_switch log[ADAPT_LOG_LEN];
+} adapt_t;
+
+void adapt_set_leaf(void *s, const struct data_struct_ops *ops, size_t size);
+
+void adapt_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void adapt_cleanup(void *s);
+
+int adapt_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int adapt_find(void *s);
+int adapt_find_dl(void *s, __u64 *dline);
+
+void adapt_save(void *s, int nproc, FILE *f);
+void adapt_print(void *s, int nproc);
+
+int adapt_check(void *s, int nproc);
+int adapt_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __ADAPTIVE_H */
@@ -21,9 +21,13 @@
  * using a max-heap built with a static array.
  * array_heap.h
  */
+#ifndef __ARRAY_HEAP_H
+#define __ARRAY_HEAP_H
+
 #include <pthread.h>
 #include <linux/types.h>
 #include "common_ops.h"
+#include "locks.h"
 
 #define IDX_INVALID	-1
 #define MAX_CPU		-1
@@ -34,7 +38,13 @@ typedef struct array_item {
 } item;
 
 typedef struct heap_struct {
-	pthread_spinlock_t lock;
+	lock_t lock;
+	/*
+	 * sequence counter protecting the heap
+	 * from lockless readers: it is odd while
+	 * an update is in progress
+	 */
+	unsigned int seq;
 	int size;
 	int *cpu_to_idx;
 	item *elements;
@@ -56,3 +66,13 @@ int heap_extract_max(array_heap_t *h, int cpu);
 int array_heap_check(void *s, int nproc);
 
 void array_heap_save(void *s, int nproc, FILE *f);
+
+int array_heap_find(void *s);
+
+int array_heap_find_dl(void *s, __u64 *dline);
+
+int array_heap_check_cpu(void *s, int cpu, __u64 dline);
+
+void array_heap_cleanup(void *s);
+
+#endif /* __ARRAY_HEAP_H */
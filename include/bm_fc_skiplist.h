@@ -36,16 +36,16 @@ typedef struct fc_sl{
 	 * to a skiplist node
 	 */
 	struct fc_sl_node **cpu_to_node;
-  /* pseudo-random generation seed */
-	unsigned int seed;
+	/* contiguous area holding all the nodes */
+	char *nodes;
+	/* nodes to insert during a combining pass */
+	struct fc_sl_node **batch_nodes;
 	/* actual higher skiplist level */
 	unsigned int level;
 	/* skiplist elements number */
 	unsigned int cpu_num;
 	/* compare function */
 	int (*cmp_dl)(__u64 a, __u64 b);	
-	/* best CPU cache */
-	int cached_cpu;
 
 	/* flat combining structure */
 	struct flat_combining *fc;
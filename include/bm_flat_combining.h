@@ -27,11 +27,16 @@
 #include "parameters.h"
 
 /* flat combining parameters */
-#define PUB_RECORD_PER_CPU		10	/* no more than 32 publication record per CPU allowed in this implementation */
+#define PUB_RECORD_PER_CPU		10	/* no more than 64 publication record per CPU allowed in this implementation */
+
+#if PUB_RECORD_PER_CPU > 64
+#error "PUB_RECORD_PER_CPU must fit in a 64 bit record bitmap"
+#endif
 
 /* data structure operations type */
 typedef enum {
-	PREEMPT
+	PREEMPT,
+	FIND
 } op_type;
 
 /* data structure operations parameters */
@@ -45,6 +50,16 @@ typedef union{
 	preempt_params preempt_p;
 } params;
 
+/* data structure operations results */
+typedef struct{
+	int cpu;
+	__u64 dline;
+} find_result;
+
+typedef union{
+	find_result find_r;
+} result;
+
 /* data structure operations handler */
 typedef struct{
 	void (*function)(void *data_structure, int cpu, __u64 dline, int is_valid);
@@ -54,7 +69,11 @@ typedef union{
 	preempt_handler preempt_h;
 } handler;
 
-/* publication record */
+/*
+ * publication record, one cache line each so that the
+ * combiner reading a record never shares a line with
+ * the publisher filling the next one
+ */
 struct pub_record{
 	/* operation type */
 	op_type req;
@@ -62,16 +81,39 @@ struct pub_record{
 	params par;
 	/* operation handler */
 	handler h;
-};
+	/* operation result, valid once the record is released */
+	result res;
+	/* publication order among the records of a CPU */
+	unsigned long seq;
+} __attribute__((aligned(64)));
 
 /* flat combining helper structure */
 struct flat_combining;
 
 /* flat combining interface */
-struct flat_combining *fc_create(void *data_structure);
+struct flat_combining *fc_create(void *data_structure, int nproc);
 
 int fc_destroy(struct flat_combining *fc);
 
+/*
+ * finds go through the combiner as well: all the finds
+ * pending in a combining pass are served by a single call
+ * of the handler, after the pass updates are applied.
+ * With snapshot set finds don't wait for the combiner,
+ * they return what it found at the end of its last pass
+ */
+void fc_set_find(struct flat_combining *fc, int (*find)(void *data_structure, __u64 *dline), int snapshot);
+
+int fc_find(struct flat_combining *fc, __u64 *dline);
+
+/*
+ * with a batch handler the combiner collects the latest
+ * PREEMPT of every CPU found in a pass and hands them all
+ * to the handler at once, which can then apply them in
+ * the order that suits the data structure best
+ */
+void fc_set_batch(struct flat_combining *fc, void (*batch)(void *data_structure, struct pub_record **recs, int n));
+
 struct pub_record *fc_get_record(struct flat_combining *fc, const int cpu);
 
 void fc_publish_record(struct flat_combining *fc, const int cpu);
@@ -95,7 +137,22 @@ void fc_data_structure_lock(struct flat_combining *fc);
 
 void fc_data_structure_unlock(struct flat_combining *fc);
 
+/* 0 if the lock was taken, -1 if it is busy */
+int fc_data_structure_trylock(struct flat_combining *fc);
+
+/*
+ * apply the pending records, to be called with the
+ * data structure lock held, e.g. before checking it
+ */
+void fc_combine(struct flat_combining *fc);
+
 /* print helper function useful for debugging purpose */
 void fc_print_publication_list(struct flat_combining *fc, FILE *out);
 
+/* updates applied and combining passes applying them so far */
+void fc_counters(struct flat_combining *fc, unsigned long long *applied, unsigned long long *passes);
+
+/* applied and eliminated operations counters */
+void fc_print_stats(struct flat_combining *fc, const char *name, FILE *out);
+
 #endif
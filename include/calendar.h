@@ -0,0 +1,79 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CALENDAR_H
+#define __CALENDAR_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "locks.h"
+#include "parameters.h"
+
+#if (CAL_BUCKETS & (CAL_BUCKETS - 1)) || CAL_BUCKETS < 64 || CAL_BUCKETS > 4096
+#error "CAL_BUCKETS must be a power of 2 between 64 and 4096"
+#endif
+
+#define CAL_WORDS		(CAL_BUCKETS / 64)
+
+/*
+ * calendar queue (timing wheel) over deadlines: bucket
+ * dline % CAL_BUCKETS holds the CPUs with deadline dline,
+ * for deadlines in [origin, origin + CAL_BUCKETS)
+ */
+typedef struct cal {
+	lock_t lock;
+	/* lowest deadline the buckets can hold, it only grows */
+	__u64 origin;
+	/* bit i set if summary[i] isn't empty */
+	__u64 top;
+	/* bit b set if bucket b isn't empty */
+	__u64 summary[CAL_WORDS];
+	/* CPU bitmaps, cpu_words words per bucket */
+	__u64 *buckets;
+	/* CPUs whose deadline is out of the window */
+	__u64 *overflow;
+	int cpu_words;
+	/* bucket of every CPU, or CAL_OVERFLOW / CAL_NONE */
+	int *cpu_to_bucket;
+	/* deadline of every CPU, 0 if none */
+	__u64 *dline;
+	int nproc;
+	/* 1 if the best CPU is the one with the latest deadline */
+	int latest;
+	int (*cmp_dl)(__u64 a, __u64 b);
+} cal_t;
+
+void cal_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void cal_cleanup(void *s);
+
+int cal_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int cal_find(void *s);
+int cal_find_dl(void *s, __u64 *dline);
+
+void cal_save(void *s, int nproc, FILE *f);
+void cal_print(void *s, int nproc);
+
+int cal_check(void *s, int nproc);
+int cal_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __CALENDAR_H */
@@ -25,7 +25,6 @@
 #include <pthread.h>
 
 #include "parameters.h"
-#include "rq_heap.h"
 #include "kernel_data_struct.h"
 
 #include "cpumask.h"
@@ -51,6 +50,13 @@ struct data_struct_ops {
 	 * another CPU
 	 */
 	int (*data_find) (void *s);
+	/*
+	 * data_find_dl (optional) behaves like data_find but
+	 * also returns the deadline the CPU was found with,
+	 * so that callers can discard unsuitable candidates
+	 * before locking their runqueues
+	 */
+	int (*data_find_dl) (void *s, __u64 *dline);
 	int (*data_max) (void *s);
 
 	void (*data_load) (void *s, FILE *f);
@@ -89,11 +95,9 @@ void rq_lock (struct rq *rq);
 
 void rq_unlock (struct rq *rq);
 
-struct rq_heap_node* rq_peek (struct rq *rq);
+struct task_struct* rq_peek (struct rq *rq);
 
-struct rq_heap_node* rq_take (struct rq *rq);
-
-struct task_struct* rq_node_task_struct(struct rq_heap_node* h);
+struct task_struct* rq_take (struct rq *rq);
 
 void add_task_rq(struct rq* rq, struct task_struct* task);
 
@@ -105,4 +109,24 @@ int rq_check(struct rq *rq);
 
 void rq_print(struct rq *this_rq, FILE *out);
 
+#ifdef SCHED_DEADLINE
+void grq_init(struct global_rq *grq, int nproc);
+
+void grq_destroy(struct global_rq *grq);
+
+void grq_lock(struct global_rq *grq);
+
+void grq_unlock(struct global_rq *grq);
+
+struct task_struct *grq_curr(struct global_rq *grq, int cpu);
+
+int grq_add_task(struct global_rq *grq, int this_cpu, struct task_struct *task, int *preempted);
+
+int grq_finish(struct global_rq *grq, int cpu);
+
+int grq_check(struct global_rq *grq);
+
+void grq_print(struct global_rq *grq, FILE *out);
+#endif
+
 #endif /*__COMMON_OPS_H */
@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This code is adapted for use inside PRAcTISE from the Linux Kernel
+ * (kernel/sched/cpudeadline.h).
+ * You can find the Linux source code here http://www.kernel.org/
+ *
+ * Linux is a registered trademark of Linus Torvalds
+ */
+
+#ifndef __CPUDL_H
+#define __CPUDL_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "locks.h"
+
+#define IDX_INVALID		-1
+
+#define BITS_PER_LONG_LONG	(8 * sizeof(unsigned long long))
+
+typedef struct cpudl_item {
+	__u64 dl;
+	int cpu;
+	int idx;
+} cpudl_item;
+
+typedef struct cpudl {
+	lock_t lock;
+	int size;
+	int nproc;
+	/*
+	 * CPUs not in the heap, i.e. without any
+	 * deadline task; only the push structure
+	 * (ordered by latest deadline) keeps it,
+	 * for the pull one it is NULL
+	 */
+	unsigned long long *free_cpus;
+	cpudl_item *elements;
+	int (*cmp_dl)(__u64 a, __u64 b);
+} cpudl_t;
+
+void cpudl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+
+void cpudl_cleanup(void *s);
+
+int cpudl_set(void *s, int cpu, __u64 dl, int is_valid);
+
+int cpudl_find(void *s);
+
+int cpudl_find_dl(void *s, __u64 *dline);
+
+int cpudl_maximum(void *s);
+
+int cpudl_check(void *s, int nproc);
+
+int cpudl_check_cpu(void *s, int cpu, __u64 dline);
+
+void cpudl_save(void *s, int nproc, FILE *f);
+
+void cpudl_print(void *s, int nproc);
+
+#endif /* __CPUDL_H */
@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DELEGATION_H
+#define __DELEGATION_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "locks.h"
+
+/* the push and the pull data structures share the server */
+#define DELEG_MAX_INSTANCES		2
+
+/*
+ * request slot of a CPU: written by whoever holds the CPU
+ * runqueue lock, read by the server, a new even seq posts it
+ */
+struct deleg_req {
+	unsigned long seq;
+	int is_valid;
+	__u64 dline;
+} __attribute__((aligned(64)));
+
+/* response slot of a CPU: the seq of the last served request */
+struct deleg_resp {
+	unsigned long seq;
+} __attribute__((aligned(64)));
+
+typedef enum {
+	DELEG_CHECK = 0,
+	DELEG_CHECK_CPU,
+	DELEG_SAVE
+} deleg_ctl_op_t;
+
+/*
+ * control slot, for the threads that are not simulated CPUs
+ * (the checker): one request at a time, under the lock
+ */
+struct deleg_ctl {
+	lock_t lock;
+	unsigned long seq;
+	unsigned long done;
+	deleg_ctl_op_t op;
+	int nproc;
+	int cpu;
+	__u64 dline;
+	FILE *f;
+	int ret;
+} __attribute__((aligned(64)));
+
+/* result of the last find, published after every batch */
+struct deleg_snap {
+	unsigned int seq;
+	int cpu;
+	__u64 dline;
+} __attribute__((aligned(64)));
+
+/*
+ * the chosen backend owned by the server thread, the other
+ * CPUs only post requests and read the find snapshot
+ */
+typedef struct deleg {
+	const struct data_struct_ops *ops;
+	size_t size;
+	void *leaf;
+	int nproc;
+	struct deleg_req *req;
+	struct deleg_resp *resp;
+	struct deleg_ctl ctl;
+	struct deleg_snap snap;
+	/* server private */
+	unsigned long *served;
+	int *batch;
+	unsigned long long requests;
+	unsigned long long batches;
+} deleg_t;
+
+void deleg_set_leaf(void *s, const struct data_struct_ops *ops, size_t size);
+
+void deleg_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void deleg_cleanup(void *s);
+
+int deleg_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int deleg_find(void *s);
+int deleg_find_dl(void *s, __u64 *dline);
+
+void deleg_save(void *s, int nproc, FILE *f);
+void deleg_print(void *s, int nproc);
+
+int deleg_check(void *s, int nproc);
+int deleg_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __DELEGATION_H */
@@ -46,8 +46,8 @@ struct dl_sl{
  	 * con il loro indice, e i nodi della skiplist.
 	 */
 	struct dl_sl_node **rq_to_node;
-  /* Seme per la generazione di numeri pseudo-random */
-	unsigned int seed;
+	/* Area contigua che contiene tutti i nodi */
+	char *nodes;
 	/* Livello attuale della skiplist */
 	unsigned int level;
 	/* Dimensione della skiplist */
@@ -26,17 +26,14 @@
 #include <pthread.h>
 
 #include "common_ops.h"
-#include "flat_combining.h"
+#include "bm_flat_combining.h"
 
 /* doubly-linked skiplist */
 typedef struct _fc_dl_skiplist {
 	struct fc_dl_sl *list;
 	int (*cmp_dl)(__u64 a, __u64 b);
-  pthread_spinlock_t lock;
-  pub_list *p_list;
-  pub_record ***p_record_array;
-	/* array di indici dell'ultimo publication record utilizzato */
-  int *p_record_idx;
+	/* publication list e lock della struttura dati */
+	struct flat_combining *fc;
 } fc_dl_skiplist_t;
 
 struct fc_dl_sl{
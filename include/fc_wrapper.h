@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FC_WRAPPER_H
+#define __FC_WRAPPER_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+
+struct flat_combining;
+
+/*
+ * any backend behind the flat combining library: updates
+ * and finds are published and applied by the combiner,
+ * the backend itself is only touched by one CPU at a time
+ */
+typedef struct fcw {
+	const struct data_struct_ops *ops;
+	size_t size;
+	void *leaf;
+	struct flat_combining *fc;
+} fcw_t;
+
+void fcw_set_leaf(void *s, const struct data_struct_ops *ops, size_t size);
+
+void fcw_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void fcw_cleanup(void *s);
+
+int fcw_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int fcw_find(void *s);
+int fcw_find_dl(void *s, __u64 *dline);
+
+void fcw_save(void *s, int nproc, FILE *f);
+void fcw_print(void *s, int nproc);
+
+int fcw_check(void *s, int nproc);
+int fcw_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __FC_WRAPPER_H */
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FLAT_ARRAY_H
+#define __FLAT_ARRAY_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+
+/*
+ * keys are padded to a whole number of cache
+ * lines, i.e. of AVX-512 vectors
+ */
+#define FA_STRIDE		8
+
+/*
+ * flat array of per-CPU keys, find is a linear scan
+ * looking for the smallest one: keys are built so that
+ * the best CPU always has the smallest signed key and
+ * a CPU out of the structure has FA_EMPTY
+ */
+typedef struct flat_array {
+	__s64 *keys;
+	int nproc;
+	int len;
+	/* 1 if the best CPU is the one with the latest deadline */
+	int latest;
+	int (*scan)(const __s64 *keys, int len);
+	int (*cmp_dl)(__u64 a, __u64 b);
+} flat_array_t;
+
+void flat_array_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void flat_array_cleanup(void *s);
+
+int flat_array_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int flat_array_find(void *s);
+int flat_array_find_dl(void *s, __u64 *dline);
+
+void flat_array_save(void *s, int nproc, FILE *f);
+void flat_array_print(void *s, int nproc);
+
+int flat_array_check(void *s, int nproc);
+int flat_array_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __FLAT_ARRAY_H */
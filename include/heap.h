@@ -29,40 +29,48 @@
 typedef unsigned long long u64;
 typedef long long s64;
 
-typedef enum{DL_MIN, DL_NORMAL, DL_MAX} dl_t;
-
-typedef struct __dline_struct {
-    u64 value;
-    dl_t special;
-} dline_t;
-
-int dl_time_before(dline_t a, dline_t b);
+/*
+ * deadlines are stored as keys of a max-heap: with invert = 0
+ * (latest deadline on top) a key is the deadline and a CPU
+ * without deadline has the greatest key, with invert = ~0
+ * (earliest deadline on top) the key is ~deadline and a CPU
+ * without deadline has key 0: in both cases it is ~invert
+ */
+typedef u64 dline_t;
 
+/*
+ * the keys compared while sifting live here, one cache line
+ * per CPU like heap_node_t, so that a CPU updating its key
+ * does not invalidate the line of a neighbour
+ */
 typedef struct _node {
     int proc_index;
     dline_t deadline;
     int position;
-} node_t;
+} __attribute__((aligned(64))) node_t;
 
 typedef struct _heap_node {
     node_t *node;
-    pthread_mutex_t m;
-    char locked;
-    pthread_t id;
-} heap_node_t;
+    pthread_spinlock_t lock;
+} __attribute__((aligned(64))) heap_node_t;
 
 typedef struct _heap {
     int nproc;
+    /* levels of the heap, i.e. longest root to node path */
+    int depth;
+    u64 invert;
+    int (*cmp_dl)(__u64 a, __u64 b);
     heap_node_t *array;
 
     node_t *nodes;
 } heap_t;
 
+#define DLINE_MIN 0ULL
 #define DLINE(h,x) ((x<h->nproc) ? h->array[x].node->deadline : DLINE_MIN)
 #define ARRAY_PNODE(h, i) (h->array[i].node)
 #define PNODE_DLINE(h, p) (h->nodes[p].deadline)
 
-void heap_init(void *s, int nproc);
+void heap_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
 void heap_delete(void *s);
 
 #define heap_left(index) (2*(index)+1)
@@ -72,11 +80,14 @@ void heap_delete(void *s);
 #define heap_get_max_dline(h) ((h)->array[0].node->deadline)
 #define heap_get_max_node(h) ((h)->array[0].node)
 
-int heap_preempt(void *s, int proc, __u64 newdline, int is_valid);
+int heap_set_dline(void *s, int proc, __u64 dline, int is_valid);
 int heap_preempt_local(void *s, int proc, __u64 newdline, int is_valid);
 int heap_finish(void *s, int proc, __u64 deadline, int is_valid);
+int heap_find(void *s);
+int heap_find_dl(void *s, __u64 *dline);
 void heap_print(void *s, int nproc);
 int heap_check(void *s, int nproc);
+int heap_check_cpu(void *s, int proc, __u64 dline);
 
 void heap_save(void *s, int nproc, FILE *f);
 void heap_load(void *s, FILE *f);
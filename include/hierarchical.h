@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HIERARCHICAL_H
+#define __HIERARCHICAL_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "locks.h"
+
+struct hier_group {
+	/* serializes updates of the leaf and of its top entry */
+	lock_t lock;
+	void *leaf;
+	/* local index to CPU */
+	int *cpus;
+	int size;
+	/* what the top structure knows about the group */
+	int best_cpu;
+	__u64 best_dl;
+} __attribute__((aligned(64)));
+
+/*
+ * two level data structure: one leaf per CPUs
+ * group plus a top level holding the best CPU of
+ * every group, both instances of the same backend
+ */
+typedef struct hier {
+	const struct data_struct_ops *ops;
+	size_t size;
+	int nproc;
+	int ngroups;
+	int *cpu_to_group;
+	int *cpu_to_local;
+	struct hier_group *groups;
+	void *top;
+	/* last deadline set for every CPU, 0 if none */
+	__u64 *dline;
+} hier_t;
+
+void hier_set_leaf(void *s, const struct data_struct_ops *ops, size_t size);
+
+void hier_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void hier_cleanup(void *s);
+
+int hier_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int hier_find(void *s);
+int hier_find_dl(void *s, __u64 *dline);
+
+void hier_save(void *s, int nproc, FILE *f);
+void hier_print(void *s, int nproc);
+
+int hier_check(void *s, int nproc);
+int hier_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __HIERARCHICAL_H */
@@ -25,7 +25,8 @@
 
 #include "cpumask.h"
 #include "cpupri.h"
-#include "rq_heap.h"
+#include "rq_queue.h"
+#include "locks.h"
 
 struct task_struct {
 	int pid;
@@ -38,12 +39,24 @@ struct task_struct {
 	int runtime;
 #endif
 	struct rq *rq;
+	/* linkage in the runqueue */
+	struct rq_queue_node node;
+	/* linkage in the pushable tasks, valid if pushable is set */
+	struct rq_queue_node pushable_node;
+	int pushable;
 };
 
 struct rq {
 	int cpu;
-	struct rq_heap heap;
-	pthread_spinlock_t lock;
+	struct rq_queue queue;
+	/*
+	 * queued tasks that push may move: all but the
+	 * earliest one and those that failed to be pushed
+	 * since they last ran, as in Linux
+	 */
+	struct rq_queue pushable;
+	int nr_pushable;
+	lock_t lock;
 	/* cache values */
 #ifdef SCHED_DEADLINE
 	__u64 earliest, next;
@@ -57,6 +70,20 @@ struct rq {
 	FILE *log;
 };
 
+/*
+ * runqueue shared by all the CPUs (global EDF): each
+ * CPU runs one of the earliest tasks, the others wait
+ * in the queue, everything under a single lock
+ */
+struct global_rq {
+	lock_t lock;
+	struct rq_queue queue;
+	int nready;
+	int nproc;
+	/* task running on each CPU, NULL if idle */
+	struct task_struct **curr;
+};
+
 struct root_domain {
 #ifdef SCHED_RT
 	int rto_count;		/* operations on this MUST be ATOMIC */
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LAZY_DL_SKIPLIST_H
+#define __LAZY_DL_SKIPLIST_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "parameters.h"
+
+/* maximum number of levels of the skiplist */
+#define LAZY_SL_MAX_LEVEL		8
+
+struct lazy_sl_node {
+	__u64 dline;
+	int cpu;
+	/* highest level the node is linked at, fixed at init */
+	int level;
+	/* logically deleted, the node can't be a predecessor */
+	int marked;
+	/* linked at every level up to level */
+	int fully_linked;
+	/* linked at all, only read by the owner */
+	int in_list;
+	pthread_spinlock_t lock;
+	struct lazy_sl_node *next[LAZY_SL_MAX_LEVEL];
+} __attribute__((aligned(64)));
+
+/* skiplist with per-node locks and lockless searches */
+typedef struct lazy_dl_skiplist {
+	struct lazy_sl_node head;
+	/* one node for every CPU, reused across updates */
+	struct lazy_sl_node *nodes;
+	int nproc;
+	int (*cmp_dl)(__u64 a, __u64 b);
+} lazy_dl_skiplist_t;
+
+void lazy_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void lazy_sl_cleanup(void *s);
+
+int lazy_sl_preempt(void *s, int cpu, __u64 dline, int is_valid);
+
+int lazy_sl_find(void *s);
+
+void lazy_sl_save(void *s, int nproc, FILE *f);
+void lazy_sl_print(void *s, int nproc);
+
+int lazy_sl_check(void *s, int nproc);
+int lazy_sl_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __LAZY_DL_SKIPLIST_H */
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LF_DL_SKIPLIST_H
+#define __LF_DL_SKIPLIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "parameters.h"
+
+/* maximum number of levels of the skiplist */
+#define LF_SL_MAX_LEVEL			8
+
+/*
+ * nodes preallocated for every CPU: one is linked,
+ * the others wait for the end of their grace period
+ */
+#define LF_SL_NODES_PER_CPU		4
+
+/* worker threads, plus checker and main */
+#define LF_SL_MAX_THREADS		(NR_CPUS + 2)
+
+struct lf_sl_node {
+	__u64 dline;
+	int cpu;
+	/* highest level the node is linked at */
+	int level;
+	/* epoch the node was unlinked in, LF_SL_IN_USE if linked */
+	unsigned long retired;
+	/*
+	 * successors on every level, the lowest bit marks
+	 * the node as logically deleted at that level
+	 */
+	uintptr_t next[LF_SL_MAX_LEVEL];
+} __attribute__((aligned(64)));
+
+/* epoch announced by a thread (epoch << 1 | active) */
+struct lf_sl_slot {
+	unsigned long epoch;
+} __attribute__((aligned(64)));
+
+/* lock-free skiplist */
+typedef struct lf_dl_skiplist {
+	struct lf_sl_node head;
+	struct lf_sl_node *nodes;
+	/* node currently linked for every CPU, NULL if none */
+	struct lf_sl_node **rq_to_node;
+	int nproc;
+	int (*cmp_dl)(__u64 a, __u64 b);
+	unsigned long epoch __attribute__((aligned(64)));
+	struct lf_sl_slot slots[LF_SL_MAX_THREADS];
+} lf_dl_skiplist_t;
+
+void lf_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void lf_sl_cleanup(void *s);
+
+int lf_sl_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int lf_sl_find(void *s);
+
+void lf_sl_save(void *s, int nproc, FILE *f);
+void lf_sl_print(void *s, int nproc);
+
+int lf_sl_check(void *s, int nproc);
+int lf_sl_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __LF_DL_SKIPLIST_H */
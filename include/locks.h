@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOCKS_H
+#define __LOCKS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* busy waiting hint, also used by whoever polls a shared line */
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax()			__builtin_ia32_pause()
+#else
+#define cpu_relax()			__atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+
+/*
+ * lock implementations, one is chosen at startup with
+ * lock_select() and used by the runqueues and by every
+ * data structure protected by a single global lock
+ */
+typedef enum {
+	LOCK_SPIN = 0,		/* pthread spinlock, the default */
+	LOCK_TAS,			/* test and set */
+	LOCK_TTAS,			/* test and test and set, exponential backoff */
+	LOCK_TICKET,		/* FIFO ticket lock */
+	LOCK_MCS,			/* MCS queue lock, local spinning */
+	LOCK_CLH,			/* CLH queue lock, local spinning */
+	LOCK_COHORT			/* per cluster ticket locks over a global one */
+} lock_type_t;
+
+/* queue node of MCS and CLH locks, one per held lock */
+struct lock_qnode {
+	struct lock_qnode *next;
+	int locked;
+	/* thread local free list */
+	struct lock_qnode *pool_next;
+} __attribute__((aligned(64)));
+
+union lock_ticket {
+	uint64_t v;
+	struct {
+		uint32_t owner;
+		uint32_t next;
+	} t;
+};
+
+/* cluster lock of a cohort lock */
+struct lock_cohort_local {
+	union lock_ticket ticket;
+	/* the global lock is held on behalf of the cluster */
+	int global_owned;
+	/* consecutive hand-overs inside the cluster */
+	int passes;
+} __attribute__((aligned(64)));
+
+typedef struct lock {
+	union {
+		pthread_spinlock_t spin;
+		int tas;
+		union lock_ticket ticket;
+		struct {
+			struct lock_qnode *tail;
+			/* nodes of the holder, only read by it */
+			struct lock_qnode *holder;
+			struct lock_qnode *holder_pred;
+		} queue;
+		struct {
+			union lock_ticket global;
+			struct lock_cohort_local *local;
+			int holder_cluster;
+		} cohort;
+	} u;
+} lock_t;
+
+/*
+ * lock_select - choose the implementation by name, before
+ * any lock is initialized; -1 if the name is unknown
+ */
+int lock_select(const char *name);
+const char *lock_name(void);
+
+void lock_init(lock_t *l);
+void lock_destroy(lock_t *l);
+
+void lock_acquire(lock_t *l);
+/* 0 if the lock was taken, like pthread_spin_trylock() */
+int lock_tryacquire(lock_t *l);
+void lock_release(lock_t *l);
+
+#endif /* __LOCKS_H */
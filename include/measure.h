@@ -26,6 +26,7 @@
 #include <math.h>
 
 #include "parameters.h"
+#include "steady_state.h"
 
 /*
  * since we have to use a constant_tsc 
@@ -53,8 +54,8 @@
  */
 #define SAMPLES_MAX						1000000
 
-/* type used for samples storage */
-#define SAMPLES_TYPE					long unsigned
+/* type used for samples storage, the one of steady_state_start() */
+#define SAMPLES_TYPE					long long unsigned
 
 /* 
  * type used for ticks storage. 
@@ -67,6 +68,12 @@
 
 #define NANO_SECONDS_IN_SEC		1000000000
 
+/*
+ * normal quantile used for the percentile
+ * confidence interval (95% confidence)
+ */
+#define EARLY_STOP_Z					1.96
+
 #ifdef MEASURE_ALL
 	#define MEASURE_SLEEP
 	#define MEASURE_CYCLE
@@ -94,6 +101,10 @@
 	#define MEASURE
 #endif
 
+#if defined(EARLY_STOP) && !defined(MEASURE)
+	#error "EARLY_STOP needs an active measurement to watch"
+#endif
+
 /*
  * check supported platforms
  */
@@ -223,6 +234,9 @@
 
 #define ACCOUNT_PRINT(out, variable, cpu) account_print(out, #variable, cpu, IDENTIFIER(variable, _n_all))
 
+/* read by another thread while the CPU keeps recording */
+#define MEASURE_CONVERGED(variable, cpu) measure_converged(IDENTIFIER(variable, _elapsed[cpu]), __atomic_load_n(&IDENTIFIER(variable, _n_all[cpu]), __ATOMIC_RELAXED))
+
 #ifdef MEASURE_CYCLE
 	EXTERN_MEASURE_VARIABLE(cycle)
 	EXTERN_DECL(ALL_COUNTER(cycle))
@@ -292,6 +306,9 @@
 	EXTERN_DECL(ALL_COUNTER(pull_cycle))
 #endif
 
+/* number of cycles actually simulated by each CPU */
+extern SAMPLES_TYPE simulated_cycles[NR_CPUS];
+
 /* TSC measurement interface */
 
 void set_tsc_cost(const int cpu);
@@ -316,4 +333,8 @@ void measure_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *elapse
 void outcome_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *n_success, SAMPLES_TYPE *n_fail);
 void account_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *n_all);
 
+/* steady state interface */
+
+int measure_converged(SAMPLES_TYPE *samples, SAMPLES_TYPE n_all);
+
 #endif
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MULTIQUEUE_H
+#define __MULTIQUEUE_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+#include "array_heap.h"
+
+struct mq_queue {
+	array_heap_t heap;
+} __attribute__((aligned(64)));
+
+/*
+ * relaxed priority structure: CPUs are spread over
+ * independent heaps, find looks at two of them only
+ */
+typedef struct mq {
+	struct mq_queue *queues;
+	int nqueues;
+	int nproc;
+	int (*cmp_dl)(__u64 a, __u64 b);
+	/* placement quality accounting */
+	unsigned long long sampled;
+	unsigned long long exact;
+	unsigned long long gap;
+} mq_t;
+
+void mq_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void mq_cleanup(void *s);
+
+int mq_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int mq_find(void *s);
+int mq_find_dl(void *s, __u64 *dline);
+
+void mq_save(void *s, int nproc, FILE *f);
+void mq_print(void *s, int nproc);
+
+int mq_check(void *s, int nproc);
+int mq_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __MULTIQUEUE_H */
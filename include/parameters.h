@@ -140,6 +140,93 @@
  */
 //#define MEASURE_CPUPRI_FIND
 
+/*
+ * stop the simulation before NCYCLES cycles
+ * as soon as, on every CPU, the steady state
+ * EARLY_STOP_PERCENTILE of the EARLY_STOP_PROBE
+ * samples has a confidence interval narrower than
+ * EARLY_STOP_CI_WIDTH times its value.
+ * Warm-up samples are detected with MSER-5 and
+ * the main thread checks every EARLY_STOP_INTERVAL
+ * cycles, off the simulated CPUs.
+ * EARLY_STOP_PROBE must be an active measurement
+ */
+//#define EARLY_STOP
+#define EARLY_STOP_PROBE			push_find
+#define EARLY_STOP_PERCENTILE	0.99
+#define EARLY_STOP_CI_WIDTH		0.05
+#define EARLY_STOP_INTERVAL		100
+
+/*
+ * CPUs grouping of the hierarchical data structure:
+ * CPUs sharing the last level cache form a group, or
+ * CPUs in the same package (i.e. NUMA node on most
+ * machines) if HIER_GROUP_BY_PACKAGE is defined.
+ * If the topology can't be read from sysfs groups
+ * are made of HIER_GROUP_SIZE consecutive CPUs
+ */
+//#define HIER_GROUP_BY_PACKAGE
+#define HIER_GROUP_SIZE				8
+
+/*
+ * MultiQueue backend: CPUs per queue, and how often
+ * (one find every MQ_QUALITY_PERIOD) the answer is
+ * compared against the exact one to account the
+ * placement quality loss; 0 disables the accounting,
+ * which is also off when the find probes are measured
+ */
+#define MQ_CPUS_PER_QUEUE			4
+#define MQ_QUALITY_PERIOD			16
+
+/*
+ * calendar backend: number of one deadline wide
+ * buckets, a power of 2 not greater than 4096;
+ * keep it well above DMAX, CPUs with a deadline
+ * out of the window go to a linearly scanned set
+ */
+#define CAL_BUCKETS					512
+
+/*
+ * flat combining wrapper: with FC_READ_SNAPSHOT finds
+ * don't wait for the combiner, they return the best CPU
+ * found at the end of the last combining pass
+ */
+//#define FC_READ_SNAPSHOT
+
+/*
+ * adaptive backend: every ADAPT_PERIOD updates it moves
+ * to flat combining if at least ADAPT_TO_FC_CONTENTION %
+ * of the lock acquisitions found the lock busy, and back
+ * to the lock if combining passes applied less than
+ * ADAPT_TO_LOCK_DEGREE / 100 updates each on average.
+ * The first ADAPT_LOG_LEN switches are printed at cleanup
+ */
+#define ADAPT_PERIOD				256
+#define ADAPT_TO_FC_CONTENTION		25
+#define ADAPT_TO_LOCK_DEGREE		150
+#define ADAPT_LOG_LEN				32
+
+/*
+ * locks: TTAS backoff bounds in pause iterations, CPUs
+ * per cluster of the cohort lock (e.g. the cores of a
+ * socket) and how many times in a row the global lock
+ * can be handed over inside a cluster
+ */
+#define LOCK_BACKOFF_MIN			4
+#define LOCK_BACKOFF_MAX			1024
+#define LOCK_COHORT_SIZE			8
+#define LOCK_COHORT_PASSES			64
+
+/*
+ * delegation: pause iterations the server and its clients
+ * spin while waiting before they start yielding the CPU,
+ * since without a spare core they share the simulated ones
+ */
+#define DELEG_SPIN_MAX				1024
+
+/* children per node of the d-ary runqueue heap */
+#define RQ_DARY_ARITY				4
+
 /* CPUs number */
 #define NR_CPUS					48
 /* simulation cycles number */
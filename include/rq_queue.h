@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RQ_QUEUE_H
+#define __RQ_QUEUE_H
+
+#include <stdio.h>
+
+#include "rq_heap.h"
+
+struct task_struct;
+
+/*
+ * queue implementations of the runqueues, one is chosen
+ * at startup with rq_queue_select(); each keeps the
+ * earliest deadline (highest priority) task first
+ */
+typedef enum {
+	RQ_QUEUE_BINOMIAL = 0,	/* binomial heap, min and next cached */
+	RQ_QUEUE_PAIRING,		/* pairing heap */
+	RQ_QUEUE_DARY			/* RQ_DARY_ARITY-ary heap in an array */
+} rq_queue_type_t;
+
+/*
+ * linkage of a task in a queue, embedded in the task:
+ * the implementation in use owns the union
+ */
+struct rq_queue_node {
+	struct task_struct *task;
+	union {
+		/*
+		 * the binomial heap moves values between its nodes,
+		 * so they are allocated apart and it keeps this
+		 * reference to the one holding the task up to date
+		 */
+		struct rq_heap_node *binomial;
+		struct {
+			struct rq_queue_node *child, *sibling;
+			/* parent of the leftmost child, else left sibling */
+			struct rq_queue_node *prev;
+		} pairing;
+		/* position in the array */
+		int index;
+	} u;
+};
+
+struct rq_queue {
+	union {
+		struct rq_heap binomial;
+		struct rq_queue_node *pairing;
+		struct {
+			struct rq_queue_node **heap;
+			int size, capacity;
+		} dary;
+	} u;
+};
+
+int rq_queue_select(const char *name);
+const char *rq_queue_name(void);
+
+void rq_queue_init(struct rq_queue *q);
+void rq_queue_destroy(struct rq_queue *q);
+
+int rq_queue_empty(struct rq_queue *q);
+
+void rq_queue_insert(struct rq_queue *q, struct rq_queue_node *node);
+void rq_queue_remove(struct rq_queue *q, struct rq_queue_node *node);
+
+struct task_struct *rq_queue_peek(struct rq_queue *q);
+struct task_struct *rq_queue_peek_next(struct rq_queue *q);
+struct task_struct *rq_queue_take(struct rq_queue *q);
+struct task_struct *rq_queue_take_next(struct rq_queue *q);
+
+void rq_queue_for_each(struct rq_queue *q,
+		void (*fn)(struct task_struct *task, FILE *out), FILE *out);
+
+#endif /* __RQ_QUEUE_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STEADY_STATE_H
+#define __STEADY_STATE_H
+
+/*
+ * MSER-5: samples are grouped in batches of
+ * MSER_BATCH_SIZE and the warm-up period is the
+ * number of leading batches whose removal minimizes
+ * the standard error of the remaining batch means.
+ * Shared by the simulator (early stop) and the
+ * stats tools, so it sticks to ANSI C
+ */
+#define MSER_BATCH_SIZE		5
+
+long long unsigned steady_state_start(long long unsigned *samples, const long long unsigned total_number);
+
+#endif /* __STEADY_STATE_H */
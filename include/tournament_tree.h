@@ -0,0 +1,78 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TOURNAMENT_TREE_H
+#define __TOURNAMENT_TREE_H
+
+#include <stdio.h>
+#include <linux/types.h>
+
+#include "common_ops.h"
+
+/*
+ * every node of the tree is a single 64 bit word:
+ * the deadline lives in the upper TT_DL_BITS bits,
+ * the CPU index + 1 in the lower TT_CPU_BITS bits,
+ * so that 0 stands for an empty subtree
+ */
+#define TT_CPU_BITS		16
+#define TT_DL_BITS		(64 - TT_CPU_BITS)
+#define TT_CPU_MASK		((1ULL << TT_CPU_BITS) - 1)
+#define TT_DL_MAX		((1ULL << TT_DL_BITS) - 1)
+
+#define TT_PACK(dl, cpu)	(((__u64)(dl) << TT_CPU_BITS) | ((__u64)(cpu) + 1))
+#define TT_DL(w)		((w) >> TT_CPU_BITS)
+#define TT_CPU(w)		((int)((w) & TT_CPU_MASK) - 1)
+
+/*
+ * one word per cache line, CPUs updating
+ * their own leaves must not bounce
+ * each other's lines
+ */
+typedef struct tt_node {
+	__u64 w;
+} __attribute__((aligned(64))) tt_node_t;
+
+/*
+ * winner tree: nodes[1] is the root, node i
+ * has children 2i and 2i + 1, CPU i is the
+ * leaf nodes[leaves + i]
+ */
+typedef struct tournament_tree {
+	tt_node_t *nodes;
+	int leaves;
+	int nproc;
+	int (*cmp_dl)(__u64 a, __u64 b);
+} tournament_tree_t;
+
+void tt_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b));
+void tt_cleanup(void *s);
+
+int tt_set(void *s, int cpu, __u64 dline, int is_valid);
+
+int tt_find(void *s);
+int tt_find_dl(void *s, __u64 *dline);
+
+void tt_save(void *s, int nproc, FILE *f);
+void tt_print(void *s, int nproc);
+
+int tt_check(void *s, int nproc);
+int tt_check_cpu(void *s, int cpu, __u64 dline);
+
+#endif /* __TOURNAMENT_TREE_H */
@@ -0,0 +1,273 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Adaptive backend: the chosen backend is updated either directly,
+ * holding the combiner lock, or through flat combining. In lock mode
+ * the failed trylocks tell how contended the structure is, in
+ * combining mode the updates applied per pass (the combining degree)
+ * tell whether batching pays off. Every ADAPT_PERIOD updates the
+ * last period is evaluated, the two thresholds leave a gap between
+ * them so that the mode doesn't flip at every period.
+ *
+ * A direct update first applies the records still pending, so the
+ * updates of a CPU always reach the backend in order whatever the
+ * mode they were issued in. Finds go straight to the backend.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/types.h>
+
+#include "adaptive.h"
+#include "bm_flat_combining.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+/*
+ * adapt_set_leaf - select the wrapped backend, to be
+ * called before adapt_init
+ * @s:		the adaptive data structure
+ * @ops:	operations of the backend
+ * @size:	size of an instance of the backend
+ */
+void adapt_set_leaf(void *s, const struct data_struct_ops *ops, size_t size)
+{
+	adapt_t *a = (adapt_t *)s;
+
+	a->ops = ops;
+	a->size = size;
+}
+
+/* combiner side handler, called with the combiner lock held */
+static void adapt_apply(void *s, int cpu, __u64 dline, int is_valid)
+{
+	adapt_t *a = (adapt_t *)s;
+
+	a->ops->data_preempt(a->leaf, cpu, dline, is_valid);
+}
+
+void adapt_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	adapt_t *a = (adapt_t *)s;
+
+	a->leaf = calloc(1, a->size);
+	if (!a->leaf) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+	a->ops->data_init(a->leaf, nproc, cmp_dl);
+	a->fc = fc_create(a, nproc);
+	a->mode = ADAPT_LOCK;
+}
+
+void adapt_cleanup(void *s)
+{
+	adapt_t *a = (adapt_t *)s;
+	int i, n;
+
+	printf("Adaptive: %lu switches to flat combining, %lu to lock, "
+			"%.2f%% of %lu updates combined\n",
+			a->switches[ADAPT_FC], a->switches[ADAPT_LOCK],
+			a->updates ? 100.0 * a->updates_fc / a->updates : 0.0,
+			a->updates);
+	n = a->switches[ADAPT_FC] + a->switches[ADAPT_LOCK];
+	for (i = 0; i < n && i < ADAPT_LOG_LEN; i++)
+		if (a->log[i].mode == ADAPT_FC)
+			printf("\tupdate %lu: to flat combining, %lu%% contended\n",
+					a->log[i].update, a->log[i].metric);
+		else
+			printf("\tupdate %lu: to lock, combining degree %.2f\n",
+					a->log[i].update, a->log[i].metric / 100.0);
+	fc_print_stats(a->fc, "Adaptive, combining mode", stdout);
+
+	fc_destroy(a->fc);
+	a->ops->data_cleanup(a->leaf);
+	free(a->leaf);
+}
+
+static void adapt_switch(adapt_t *a, adapt_mode_t mode, unsigned long update,
+		unsigned long metric)
+{
+	unsigned long n = a->switches[ADAPT_FC] + a->switches[ADAPT_LOCK];
+
+	if (n < ADAPT_LOG_LEN) {
+		a->log[n].update = update;
+		a->log[n].mode = mode;
+		a->log[n].metric = metric;
+	}
+	a->switches[mode]++;
+
+	if (mode == ADAPT_FC)
+		fc_counters(a->fc, &a->last_applied, &a->last_passes);
+	else {
+		__atomic_store_n(&a->win_direct, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&a->win_contended, 0, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&a->mode, mode, __ATOMIC_RELAXED);
+}
+
+/*
+ * adapt_decide - evaluate the period just ended, one
+ * thread at a time, the others go on in the old mode
+ * @update:	number of the update ending the period
+ */
+static void adapt_decide(adapt_t *a, unsigned long update)
+{
+	unsigned long direct, contended;
+	unsigned long long applied, passes;
+
+	if (__atomic_exchange_n(&a->deciding, 1, __ATOMIC_ACQUIRE))
+		return;
+
+	if (a->mode == ADAPT_LOCK) {
+		direct = __atomic_exchange_n(&a->win_direct, 0, __ATOMIC_RELAXED);
+		contended = __atomic_exchange_n(&a->win_contended, 0, __ATOMIC_RELAXED);
+		if (direct && contended * 100 >= ADAPT_TO_FC_CONTENTION * direct)
+			adapt_switch(a, ADAPT_FC, update, contended * 100 / direct);
+	} else {
+		fc_counters(a->fc, &applied, &passes);
+		applied -= a->last_applied;
+		passes -= a->last_passes;
+		if (passes && applied * 100 < ADAPT_TO_LOCK_DEGREE * passes)
+			adapt_switch(a, ADAPT_LOCK, update, applied * 100 / passes);
+		else
+			fc_counters(a->fc, &a->last_applied, &a->last_passes);
+	}
+
+	__atomic_store_n(&a->deciding, 0, __ATOMIC_RELEASE);
+}
+
+int adapt_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	adapt_t *a = (adapt_t *)s;
+	struct pub_record *rec;
+	unsigned long update;
+
+	if (__atomic_load_n(&a->mode, __ATOMIC_RELAXED) == ADAPT_LOCK) {
+		__atomic_fetch_add(&a->win_direct, 1, __ATOMIC_RELAXED);
+		if (fc_data_structure_trylock(a->fc)) {
+			__atomic_fetch_add(&a->win_contended, 1, __ATOMIC_RELAXED);
+			fc_data_structure_lock(a->fc);
+		}
+		/* records left by the combining mode come first */
+		fc_combine(a->fc);
+		a->ops->data_preempt(a->leaf, cpu, dline, is_valid);
+		fc_data_structure_unlock(a->fc);
+	} else {
+		__atomic_fetch_add(&a->updates_fc, 1, __ATOMIC_RELAXED);
+		rec = fc_get_record(a->fc, cpu);
+		rec->req = PREEMPT;
+		rec->par.preempt_p.cpu = cpu;
+		rec->par.preempt_p.dline = dline;
+		rec->par.preempt_p.is_valid = is_valid;
+		rec->h.preempt_h.function = adapt_apply;
+		fc_publish_record(a->fc, cpu);
+
+		fc_try_combiner(a->fc);
+	}
+
+	update = __atomic_add_fetch(&a->updates, 1, __ATOMIC_RELAXED);
+	if (!(update % ADAPT_PERIOD))
+		adapt_decide(a, update);
+
+	return 0;
+}
+
+int adapt_find_dl(void *s, __u64 *dline)
+{
+	adapt_t *a = (adapt_t *)s;
+
+	*dline = 0;
+	if (a->ops->data_find_dl)
+		return a->ops->data_find_dl(a->leaf, dline);
+
+	return a->ops->data_find(a->leaf);
+}
+
+int adapt_find(void *s)
+{
+	adapt_t *a = (adapt_t *)s;
+
+	return a->ops->data_find(a->leaf);
+}
+
+/*
+ * save and checks apply the pending updates first: the
+ * checker holds every runqueue lock, so nothing else can
+ * be published meanwhile
+ */
+void adapt_save(void *s, int nproc, FILE *f)
+{
+	adapt_t *a = (adapt_t *)s;
+
+	fc_data_structure_lock(a->fc);
+	fc_combine(a->fc);
+	fprintf(f, "Adaptive, %s mode:\n",
+			a->mode == ADAPT_FC ? "flat combining" : "lock");
+	a->ops->data_save(a->leaf, nproc, f);
+	fc_data_structure_unlock(a->fc);
+}
+
+void adapt_print(void *s, int nproc)
+{
+	adapt_save(s, nproc, stdout);
+}
+
+int adapt_check(void *s, int nproc)
+{
+	adapt_t *a = (adapt_t *)s;
+	int ret;
+
+	fc_data_structure_lock(a->fc);
+	fc_combine(a->fc);
+	ret = a->ops->data_check(a->leaf, nproc);
+	fc_data_structure_unlock(a->fc);
+
+	return ret;
+}
+
+int adapt_check_cpu(void *s, int cpu, __u64 dline)
+{
+	adapt_t *a = (adapt_t *)s;
+	int ret;
+
+	fc_data_structure_lock(a->fc);
+	fc_combine(a->fc);
+	ret = a->ops->data_check_cpu(a->leaf, cpu, dline);
+	fc_data_structure_unlock(a->fc);
+
+	return ret;
+}
+
+const struct data_struct_ops adapt_ops = {
+	.data_init = adapt_init,
+	.data_cleanup = adapt_cleanup,
+	.data_preempt = adapt_set,
+	.data_finish = adapt_set,
+	.data_find = adapt_find,
+	.data_find_dl = adapt_find_dl,
+	.data_max = adapt_find,
+	.data_save = adapt_save,
+	.data_print = adapt_print,
+	.data_check = adapt_check,
+	.data_check_cpu = adapt_check_cpu
+};
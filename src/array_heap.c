@@ -44,6 +44,36 @@ static inline int right_child(int i) {
         return (i << 1) + 2;
 }
 
+/*
+ * Sequence counter helpers, as in the Linux seqcount_t:
+ * writers (already serialized by h->lock) make the counter
+ * odd while they modify the heap, readers retry if the
+ * counter was odd or has changed while they were reading.
+ */
+static inline void write_seqcount_begin(array_heap_t *h) {
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqcount_end(array_heap_t *h) {
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned int read_seqcount_begin(array_heap_t *h) {
+	unsigned int seq;
+
+	while ((seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE)) & 1)
+		__builtin_ia32_pause();
+
+	return seq;
+}
+
+static inline int read_seqcount_retry(array_heap_t *h, unsigned int seq) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&h->seq, __ATOMIC_RELAXED) != seq;
+}
+
 void exchange(array_heap_t *h, int a, int b) {
 	int cpu_tmp;
 	__u64 dl_a = h->elements[a].dl, dl_b = h->elements[b].dl;
@@ -63,7 +93,8 @@ void array_heap_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b)) {
 	int i;
 	array_heap_t *h = (array_heap_t*) s;
 
-	pthread_spin_init(&h->lock, 0);
+	lock_init(&h->lock);
+	h->seq = 0;
 	h->size = 0;
 	h->cmp_dl = cmp_dl;
 	h->cpu_to_idx = (int*)malloc(sizeof(int)*nproc);
@@ -149,14 +180,16 @@ int heap_set(void *s, int cpu, __u64 dline, int is_valid) {
 	 * }
 	 */
 
-	pthread_spin_lock(&h->lock);
+	lock_acquire(&h->lock);
 	old_idx = h->cpu_to_idx[cpu];
 	
 	if (!is_valid && old_idx == IDX_INVALID) {
-		pthread_spin_unlock(&h->lock);
+		lock_release(&h->lock);
 		return -1;
 	}
 
+	write_seqcount_begin(h);
+
 	if (!is_valid) {
 		new_cpu = h->elements[h->size - 1].cpu;
 		h->elements[old_idx].dl = h->elements[h->size - 1].dl;
@@ -172,7 +205,8 @@ int heap_set(void *s, int cpu, __u64 dline, int is_valid) {
 		}
 		max_heapify(h, old_idx);
 
-		pthread_spin_unlock(&h->lock);
+		write_seqcount_end(h);
+		lock_release(&h->lock);
 		return -1;
 	}
 
@@ -186,7 +220,8 @@ int heap_set(void *s, int cpu, __u64 dline, int is_valid) {
 		heap_change_key(h, old_idx, dline, 1);
 	}
 
-	pthread_spin_unlock(&h->lock);
+	write_seqcount_end(h);
+	lock_release(&h->lock);
 	return idx;
 }
 
@@ -236,7 +271,7 @@ int array_heap_check(void *s, int nproc)
 	int i, flag = 1;
 	array_heap_t *h = (array_heap_t*) s;
 
-	pthread_spin_lock(&h->lock);
+	lock_acquire(&h->lock);
 
 	for (i = 0; i < nproc; i++) {
 		/* 
@@ -281,7 +316,7 @@ int array_heap_check(void *s, int nproc)
 	}
 
 out:
-	pthread_spin_unlock(&h->lock);
+	lock_release(&h->lock);
 	if (flag == 0)
 		print_array_heap(s, nproc);
 	return flag;
@@ -292,7 +327,7 @@ void array_heap_save(void *s, int nproc, FILE *f)
 	int i;
 	array_heap_t *h = (array_heap_t*) s;
 
-	pthread_spin_lock(&h->lock);
+	lock_acquire(&h->lock);
 	fprintf(f, "Heap (%d elements):\n", h->size);
 	fprintf(f, "[ ");
 	for (i = 0; i < h->size; i++)
@@ -305,36 +340,65 @@ void array_heap_save(void *s, int nproc, FILE *f)
 	for (i = 0; i < nproc; i++)
 		fprintf(f, " %d", h->cpu_to_idx[i]);
 	fprintf(f, "\n");
-	pthread_spin_unlock(&h->lock);
+	lock_release(&h->lock);
 
 	return;
 }
 
 void array_heap_cleanup(void *s)
 {
-	return;
+	array_heap_t *h = (array_heap_t*) s;
+
+	lock_destroy(&h->lock);
 }
 
-int array_heap_find(void *s)
+/*
+ * Lockless find: returns the CPU on top of the heap
+ * and stores its deadline in dline; the (cpu, dline)
+ * pair is consistent, since we retry if a writer
+ * modified the heap while we were reading it.
+ */
+int array_heap_find_dl(void *s, __u64 *dline)
 {
-	int cpu = -1;
+	int cpu;
+	__u64 dl;
+	unsigned int seq;
 	array_heap_t *h = (array_heap_t*) s;
 
-	if (h->size > 0)
-		cpu = heap_maximum(s);
+	do {
+		seq = read_seqcount_begin(h);
+		cpu = -1;
+		dl = 0;
+		if (h->size > 0) {
+			cpu = h->elements[0].cpu;
+			dl = h->elements[0].dl;
+		}
+	} while (read_seqcount_retry(h, seq));
+
+	*dline = dl;
 
 	return cpu;
 }
 
+int array_heap_find(void *s)
+{
+	__u64 dline;
+
+	return array_heap_find_dl(s, &dline);
+}
+
 int array_heap_check_cpu (void *s, int cpu, __u64 dline){
 	array_heap_t *h = (array_heap_t*) s;
 	int flag = 0;
 
-	pthread_spin_lock(&h->lock);
-	if (h->elements[h->cpu_to_idx[cpu]].dl == dline)
+	lock_acquire(&h->lock);
+	/* a CPU out of the heap must have no deadline */
+	if (h->cpu_to_idx[cpu] == IDX_INVALID)
+		flag = !dline;
+	else if (h->elements[h->cpu_to_idx[cpu]].dl == dline)
 		flag = 1;
 
-	pthread_spin_unlock(&h->lock);
+	lock_release(&h->lock);
 	
 	return flag;
 }
@@ -345,6 +409,7 @@ const struct data_struct_ops array_heap_ops = {
 	.data_preempt = heap_set,
 	.data_finish = heap_set,
 	.data_find = array_heap_find,
+	.data_find_dl = array_heap_find_dl,
 	.data_max = heap_maximum,
 	//.data_load = heap_load,
 	.data_save = array_heap_save,
@@ -19,9 +19,9 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <linux/types.h>
-#include <time.h>
 #include <pthread.h>
 
 #include "common_ops.h"
@@ -31,32 +31,54 @@
 
 /* skiplist parameters */
 #define	MAX_LEVEL           8
-#define LEVEL_PROB_VALUE    0.20
+/* one node every 2^LEVEL_SHIFT goes up a level */
+#define LEVEL_SHIFT         2
 #define OUT_OF_LIST					-1
-#define NO_CACHED_CPU				-1
+#define CACHE_LINE					64
+/* max nodes crossed by a partial move */
+#define MOVE_STEPS					8
+
+/* pointers to next and previous nodes on a level */
+struct fc_sl_link{
+	struct fc_sl_node *next;
+	struct fc_sl_node *prev;
+};
 
+/*
+ * the key and the level 0 links are in the first cache
+ * line, upper levels are allocated up to the node height
+ */
 struct fc_sl_node{
 	/* task deadline */
 	__u64 dline;
-	/* node level */
+	/* node level, OUT_OF_LIST if not linked */
 	int level;
-	/* pointers to next and previous nodes */
-	struct fc_sl_node *next[MAX_LEVEL];
-	struct fc_sl_node *prev[MAX_LEVEL];
 	/* CPU index */
 	unsigned int cpu_idx;
+	/* node height, fixed at init */
+	int height;
+	struct fc_sl_link links[];
 };
 
-static inline unsigned int sl_rand_level(unsigned int *seed, unsigned int max)
+/*
+ * there is exactly one node per CPU, so heights are given
+ * once and for all: node idx reaches level k if idx + 1 is
+ * a multiple of 2^(k * LEVEL_SHIFT), i.e. every level holds
+ * a quarter of the nodes of the one below
+ */
+static inline int sl_height(unsigned int idx)
 {
-	unsigned int level = 0;
+	int height = __builtin_ctz(idx + 1) / LEVEL_SHIFT;
 
-	max = max > MAX_LEVEL - 1 ? MAX_LEVEL - 1 : max;
+	return height > MAX_LEVEL - 1 ? MAX_LEVEL - 1 : height;
+}
 
-	while(rand_r(seed) > ((1 - LEVEL_PROB_VALUE) * RAND_MAX) && level < max)
-		level++;
+/* size of a node of the given height, rounded to a cache line */
+static inline size_t sl_node_size(int height)
+{
+	size_t size = sizeof(struct fc_sl_node) + (height + 1) * sizeof(struct fc_sl_link);
 
-	return level;
+	return (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
 }
 
 static __u64 sl_detach(fc_sl_t *list, struct fc_sl_node *p)
@@ -64,12 +86,12 @@ static __u64 sl_detach(fc_sl_t *list, struct fc_sl_node *p)
 	unsigned int i;
 
 	for(i = 0; i <= p->level; i++){
-		p->prev[i]->next[i] = p->next[i];
-		if(p->next[i])
-			p->next[i]->prev[i] = p->prev[i];
+		p->links[i].prev->links[i].next = p->links[i].next;
+		if(p->links[i].next)
+			p->links[i].next->links[i].prev = p->links[i].prev;
 	}
 
-	while(!list->head->next[list->level] && list->level > 0)
+	while(!list->head->links[list->level].next && list->level > 0)
 		list->level--;
 
 	p->level = OUT_OF_LIST;
@@ -89,13 +111,30 @@ static inline __u64 sl_remove_idx(fc_sl_t *list, const unsigned int cpu_idx)
 	return sl_detach(list, p);
 }
 
+/* link a node at its height after the predecessors found by a search */
+static inline void sl_link(fc_sl_t *list, struct fc_sl_node *new_node, struct fc_sl_node **update)
+{
+	unsigned int i;
+
+	new_node->level = new_node->height;
+	while(new_node->level > list->level)
+		update[++list->level] = list->head;
+
+	for(i = 0; i <= new_node->level; i++){
+		new_node->links[i].next = update[i]->links[i].next;
+		update[i]->links[i].next = new_node;
+		new_node->links[i].prev = update[i];
+		if(new_node->links[i].next)
+			new_node->links[i].next->links[i].prev = new_node;
+	}
+}
+
 static void sl_insert(fc_sl_t *list, const unsigned int cpu_idx, __u64 dline)
 {
-	struct fc_sl_node *p;
+	struct fc_sl_node *p, *next;
 	struct fc_sl_node *update[MAX_LEVEL];
 	struct fc_sl_node *new_node;
 	int cmp_res, level;
-	unsigned int i, rand_level;
 
 	new_node = list->cpu_to_node[cpu_idx];
 	new_node->dline = dline;
@@ -105,30 +144,78 @@ static void sl_insert(fc_sl_t *list, const unsigned int cpu_idx, __u64 dline)
 	while(level >= 0){
 		update[level] = p;
 
-		if(!p->next[level]){
+		next = p->links[level].next;
+		if(!next){
 			level--;
 			continue;
 		}
 		
-		cmp_res = list->cmp_dl(p->next[level]->dline, new_node->dline);
-		if(cmp_res > 0)
-			p = p->next[level];
-		else
+		cmp_res = list->cmp_dl(next->dline, new_node->dline);
+		if(cmp_res > 0){
+			p = next;
+			/* the next comparison reads the following node */
+			__builtin_prefetch(p->links[level].next);
+		}else
 			level--;
 	}
 
-	rand_level = sl_rand_level(&list->seed, list->level + 1);
-	new_node->level = rand_level;
-	if(rand_level > list->level)
-		update[++list->level] = list->head;
+	sl_link(list, new_node, update);
+}
 
-	for(i = 0; i <= rand_level; i++){
-		new_node->next[i] = update[i]->next[i];
-		update[i]->next[i] = new_node;
-		new_node->prev[i] = update[i];
-		if(new_node->next[i])
-			new_node->next[i]->prev[i] = new_node;
+/*
+ * sl_update - change the deadline of a node already in the list.
+ * The commonest update moves a deadline a little forward: if the
+ * node is still in order with its level 0 neighbours only the key
+ * is rewritten. Otherwise the node is detached and its new place
+ * is looked for starting from the old one, forward or backward, on
+ * the node's top level, then going down as a normal search does;
+ * past MOVE_STEPS nodes we fall back to a search from the head.
+ */
+static void sl_update(fc_sl_t *list, struct fc_sl_node *node, __u64 dline)
+{
+	struct fc_sl_node *p, *prev, *next;
+	struct fc_sl_node *update[MAX_LEVEL];
+	int i, steps = 0, top = node->level;
+
+	prev = node->links[0].prev;
+	next = node->links[0].next;
+	if((prev == list->head || !list->cmp_dl(dline, prev->dline)) &&
+			(!next || !list->cmp_dl(next->dline, dline))){
+		node->dline = dline;
+		return;
+	}
+
+	p = node->links[top].prev;
+	sl_detach(list, node);
+	node->dline = dline;
+
+	if(p != list->head && list->cmp_dl(dline, p->dline)){
+		while(p != list->head && list->cmp_dl(dline, p->dline)){
+			if(++steps > MOVE_STEPS)
+				goto full_search;
+			p = p->links[top].prev;
+		}
+	}else{
+		while(p->links[top].next && list->cmp_dl(p->links[top].next->dline, dline)){
+			if(++steps > MOVE_STEPS)
+				goto full_search;
+			p = p->links[top].next;
+		}
 	}
+	update[top] = p;
+
+	for(i = top - 1; i >= 0; i--){
+		p = update[i + 1];
+		while(p->links[i].next && list->cmp_dl(p->links[i].next->dline, dline))
+			p = p->links[i].next;
+		update[i] = p;
+	}
+
+	sl_link(list, node, update);
+	return;
+
+full_search:
+	sl_insert(list, node->cpu_idx, dline);
 }
 
 /*
@@ -138,43 +225,156 @@ static void sl_insert(fc_sl_t *list, const unsigned int cpu_idx, __u64 dline)
  */
 static void sl_dispatcher(void *s, int cpu, __u64 dline, int is_valid)
 {
-	sl_remove_idx((fc_sl_t *)s, cpu);
+	fc_sl_t *list = (fc_sl_t *)s;
+
+	if(is_valid && list->cpu_to_node[cpu]->level != OUT_OF_LIST){
+		sl_update(list, list->cpu_to_node[cpu], dline);
+		return;
+	}
+
+	sl_remove_idx(list, cpu);
 
 	if(is_valid)
-		sl_insert((fc_sl_t *)s, cpu, dline);
+		sl_insert(list, cpu, dline);
+}
+
+/*
+ * sl_snapshot - best CPU and its deadline, run by the combiner
+ * with the data structure lock held at the end of every pass
+ * that applied updates: fc_sl_find() returns the last result
+ */
+static int sl_snapshot(void *s, __u64 *dline)
+{
+	fc_sl_t *list = (fc_sl_t *)s;
+	struct fc_sl_node *node = list->head->links[0].next;
+
+	if(!node){
+		*dline = 0;
+		return -1;
+	}
+
+	*dline = node->dline;
+	return node->cpu_idx;
+}
+
+/*
+ * sl_batch - apply the latest update of every CPU found by a
+ * combining pass. Updates keeping the node in order are done
+ * in place and removals right away, the other nodes are sorted
+ * by their new deadline and inserted in a single left to right
+ * sweep: the predecessors of a key are never before the ones of
+ * the previous key, so every level search starts from the
+ * furthest of the node found on the level above and the last
+ * predecessor on this level, instead of from the head.
+ */
+static void sl_batch(void *s, struct pub_record **recs, int n)
+{
+	fc_sl_t *list = (fc_sl_t *)s;
+	struct fc_sl_node *update[MAX_LEVEL];
+	struct fc_sl_node *node, *prev, *next, *p;
+	struct fc_sl_node **nodes = list->batch_nodes;
+	preempt_params *par;
+	int i, j, level, ninsert = 0;
+
+	for(i = 0; i < n; i++){
+		par = &recs[i]->par.preempt_p;
+		node = list->cpu_to_node[par->cpu];
+
+		if(par->is_valid && node->level != OUT_OF_LIST){
+			prev = node->links[0].prev;
+			next = node->links[0].next;
+			if((prev == list->head || !list->cmp_dl(par->dline, prev->dline)) &&
+					(!next || !list->cmp_dl(next->dline, par->dline))){
+				node->dline = par->dline;
+				continue;
+			}
+		}
+
+		sl_remove_idx(list, par->cpu);
+		if(!par->is_valid)
+			continue;
+
+		node->dline = par->dline;
+		/* insertion sort, batches are at most one node per CPU */
+		for(j = ninsert++; j > 0 && list->cmp_dl(node->dline, nodes[j - 1]->dline); j--)
+			nodes[j] = nodes[j - 1];
+		nodes[j] = node;
+	}
+
+	for(level = 0; level < MAX_LEVEL; level++)
+		update[level] = list->head;
+
+	for(i = 0; i < ninsert; i++){
+		node = nodes[i];
+		p = list->head;
+		for(level = list->level; level >= 0; level--){
+			if(p == list->head || (update[level] != list->head &&
+						list->cmp_dl(p->dline, update[level]->dline)))
+				p = update[level];
+			while(p->links[level].next && list->cmp_dl(p->links[level].next->dline, node->dline))
+				p = p->links[level].next;
+			update[level] = p;
+		}
+
+		sl_link(list, node, update);
+
+		/* the node just linked precedes the next keys */
+		for(level = 0; level <= node->level; level++)
+			update[level] = node;
+	}
 }
 
 void fc_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
 {
 	fc_sl_t *p = (fc_sl_t *)s;
 	unsigned int i;
+	size_t size = 0;
+	char *node;
+	int err;
 
 	p->cmp_dl = cmp_dl;
-	p->head = (struct fc_sl_node *)calloc(1, sizeof(*p->head));
-	p->seed = time(NULL);
+	p->head = (struct fc_sl_node *)calloc(1, sl_node_size(MAX_LEVEL - 1));
+	p->head->height = MAX_LEVEL - 1;
 	p->cpu_to_node = (struct fc_sl_node **)calloc(nproc, sizeof(*p->cpu_to_node));
 
-	/* nodes preallocation */
-	for(i = 0; i < nproc; i++){
-		p->cpu_to_node[i] = (struct fc_sl_node *)calloc(1, sizeof(*p->cpu_to_node[i]));
+	/* nodes preallocation, contiguous and cache aligned */
+	for(i = 0; i < nproc; i++)
+		size += sl_node_size(sl_height(i));
+	err = posix_memalign((void **)&p->nodes, CACHE_LINE, size);
+	if(err){
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(p->nodes, 0, size);
+
+	for(i = 0, node = p->nodes; i < nproc; i++){
+		p->cpu_to_node[i] = (struct fc_sl_node *)node;
 		p->cpu_to_node[i]->level = OUT_OF_LIST;
 		p->cpu_to_node[i]->cpu_idx = i;
+		p->cpu_to_node[i]->height = sl_height(i);
+		node += sl_node_size(sl_height(i));
 	}
 
 	p->cpu_num = nproc;
-	p->cached_cpu = NO_CACHED_CPU;
+
+	p->batch_nodes = (struct fc_sl_node **)calloc(nproc, sizeof(*p->batch_nodes));
 
 	/* flat combining inizialization */
-	p->fc = fc_create(p);
+	p->fc = fc_create(p, nproc);
+	fc_set_batch(p->fc, sl_batch);
+	fc_set_find(p->fc, sl_snapshot, 1);
 }
 
 void fc_sl_cleanup(void *s)
 {
 	fc_sl_t *p = (fc_sl_t *)s;
-	unsigned int i;
 
-	for(i = 0; i < p->cpu_num; i++)
-		free(p->cpu_to_node[i]);
+	fc_print_stats(p->fc, p->cmp_dl == __dl_time_after ?
+		"Bitmap flat combining skiplist (latest first)" :
+		"Bitmap flat combining skiplist (earliest first)", stdout);
+
+	free(p->nodes);
+	free(p->batch_nodes);
 	free(p->cpu_to_node);
 	free(p->head);
 	
@@ -185,37 +385,6 @@ int fc_sl_preempt(void *s, int cpu, __u64 dline, int is_valid)
 {
 	fc_sl_t *p = (fc_sl_t *)s;
 	struct pub_record *rec;
-	int now_cached_cpu;
-
-	/* 
-	 * if is_valid is set we may have 
-	 * to update the cached CPU 
-	 */
-	if(is_valid)
-		do{
-			/*
-			 * at every iteration we have to read
-			 * p->cached_cpu since it may be changed
-			 */
-			now_cached_cpu = p->cached_cpu;
-			if(now_cached_cpu != NO_CACHED_CPU && p->cmp_dl(p->cpu_to_node[now_cached_cpu]->dline, dline))
-				break;
-		}while(!__sync_bool_compare_and_swap(&p->cached_cpu, now_cached_cpu, cpu));
-
-	/*
-	 * if is_valid is clear we may have
-	 * to clear the cached CPU
-	 */
-	if(!is_valid)
-		do{
-			/*
-			 * at every iteration we have to read
-			 * p->cached_cpu since it may be changed
-			 */
-			now_cached_cpu = p->cached_cpu;
-			if(now_cached_cpu == NO_CACHED_CPU || now_cached_cpu != cpu)
-				break;
-		}while(!__sync_bool_compare_and_swap(&p->cached_cpu, p->cached_cpu, NO_CACHED_CPU));
 
 	rec = fc_get_record(p->fc, cpu);
 	rec->req = PREEMPT;
@@ -233,19 +402,10 @@ int fc_sl_preempt(void *s, int cpu, __u64 dline, int is_valid)
 int fc_sl_find(void *s)
 {
 	fc_sl_t *p = (fc_sl_t *)s;
-	struct fc_sl_node *node;
-	int candidate_cpu;
-
-	/* read cached CPU*/
-	candidate_cpu = p->cached_cpu;
-	if(candidate_cpu == NO_CACHED_CPU){
-		/* best CPU from data structure */
-		node = p->head->next[0];
-		if(node)
-			candidate_cpu = node->cpu_idx;
-	}
+	__u64 dline;
 
-	return candidate_cpu;
+	/* what the combiner found at the end of its last pass */
+	return fc_find(p->fc, &dline);
 }
 
 /* FIXME */
@@ -267,7 +427,7 @@ void fc_sl_save(void *s, int nproc, FILE *f){
 
 	for(i = p->level; i >= 0; i--){
 		fprintf(f, "%u:\t", i);
-		for(node = p->head->next[i]; node; node = node->next[i])
+		for(node = p->head->links[i].next; node; node = node->links[i].next)
 			fprintf(f, "%llu ", node->dline);
 		fprintf(f, "\n");
 	}
@@ -296,16 +456,17 @@ int fc_sl_check(void *s, int nproc){
 
 	/* to check we need to obtain a lock on data structure */
 	fc_data_structure_lock(p->fc);
+	fc_combine(p->fc);
 
 	/* skiplist levels number check */
 	for(i = 0; i < MAX_LEVEL; i++)
-		if(p->head->next[i] != NULL)
+		if(p->head->links[i].next != NULL)
 			max_level = i;
 	if(max_level != p->level){
 		fprintf(stderr, "ERROR: skiplist levels number\n");
 		fprintf(stderr, "list->level: %u max_level: %u\n", p->level, max_level);
 		for(i = 0; i < MAX_LEVEL; i++)
-			printf("level %u: %p\n", i, p->head->next[i]);
+			printf("level %u: %p\n", i, p->head->links[i].next);
 		flag = 0;	
 	}
 
@@ -313,10 +474,10 @@ int fc_sl_check(void *s, int nproc){
 
 	/* forward check */
 	for(i = 0; i < p->level; i++){
-		if(!(node = p->head->next[i]))
+		if(!(node = p->head->links[i].next))
 			continue;
 		
-		while((next_node = node->next[i])){
+		while((next_node = node->links[i].next)){
 			if(p->cmp_dl(node->dline, next_node->dline) < 0){
 				fprintf(stderr, "ERROR: forward check failed (level: %u) on nodes prev: %llu and next: %llu\n", i, node->dline, next_node->dline);
 				flag = 0;
@@ -327,15 +488,15 @@ int fc_sl_check(void *s, int nproc){
 
 	/* backward check */
 	for(i = 0; i < p->level; i++){
-		if(!(node = p->head->next[i]))
+		if(!(node = p->head->links[i].next))
 			continue;
 
 		/* we reach the last node */
-		while(node->next[i])
-			node = node->next[i];
+		while(node->links[i].next)
+			node = node->links[i].next;
 			
 		/* check */
-		while((prev_node = node->prev[i])){
+		while((prev_node = node->links[i].prev)){
 			if(p->cmp_dl(prev_node->dline, node->dline) < 0){
 				fprintf(stderr, "ERROR: backward check failed (level: %u) on nodes prev: %llu and next: %llu\n", i, node->dline, next_node->dline);
 				flag = 0;
@@ -350,26 +511,21 @@ int fc_sl_check(void *s, int nproc){
 }
 
 /*
- * since the update of the data structure
- * is deferred, there's no guarantee that
- * the node in it is updated, so this check
- * makes no sense in case of asynchronous
- * flat combining
+ * the update of the data structure is deferred,
+ * the pending records are applied before checking:
+ * the checker holds every runqueue lock, so nothing
+ * else can be published meanwhile
  */
 int fc_sl_check_cpu(void *s, int cpu, __u64 dline){
-	return 1;
-#if 0
 	fc_sl_t *p = (fc_sl_t *)s;
 	struct fc_sl_node *node;
 	int flag = 1;
 
 	/* to check we need to obtain a lock on data structure */
 	fc_data_structure_lock(p->fc);
+	fc_combine(p->fc);
 
 	node = p->cpu_to_node[cpu];
-	if(!node)
-		return 0;
-	
 	if(!dline && node->level != OUT_OF_LIST)
 		flag = 0;
 
@@ -379,10 +535,8 @@ int fc_sl_check_cpu(void *s, int cpu, __u64 dline){
 	fc_data_structure_unlock(p->fc);
 
 	return flag;
-#endif
 }
 
-/* abstract functions mapping struct */
 const struct data_struct_ops bm_fc_skiplist_ops = {
 	.data_init = fc_sl_init,
 	.data_cleanup = fc_sl_cleanup,
@@ -28,91 +28,101 @@
 #include <string.h>
 
 #include "bm_flat_combining.h"
+#include "locks.h"
 
 /* bitmap management helper functions */
-inline void bitmap64_set(int64_t *bitmap, int n){	
-	*bitmap |= ((int64_t)1 << n);
-}
-
-inline void bitmap32_set(int32_t *bitmap, int n){	
-	*bitmap |= ((int32_t)1 << n);
-}
-
-inline void bitmap64_clear(int64_t *bitmap, int n){
-	*bitmap &= ~((int64_t)1 << n);
-}
+#define BITS_PER_WORD				64
+#define BIT_WORD(n)				((n) / BITS_PER_WORD)
+#define BIT_MASK(n)				((uint64_t)1 << ((n) % BITS_PER_WORD))
+#define BITS_TO_WORDS(n)			(((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
 
-inline void bitmap32_clear(int32_t *bitmap, int n){
-	*bitmap &= ~((int32_t)1 << n);
-}
-
-inline int bitmap64_test(int64_t *bitmap, int n){
-	return ((*bitmap & ((int64_t)1 << n)) > (int64_t)0);
+/*
+ * updates are atomic: a word is shared among the publishers
+ * of up to 64 CPUs and the current combiner. A set releases
+ * what the publisher wrote before it, a take acquires it
+ * back on the combiner side
+ */
+static inline void bitmap_set(uint64_t *bitmap, int n){
+	__atomic_fetch_or(&bitmap[BIT_WORD(n)], BIT_MASK(n), __ATOMIC_RELEASE);
 }
 
-inline int bitmap32_test(int32_t *bitmap, int n){
-	return ((*bitmap & ((int32_t)1 << n)) > (int32_t)0);
+static inline int bitmap_test(uint64_t *bitmap, int n){
+	return (__atomic_load_n(&bitmap[BIT_WORD(n)], __ATOMIC_ACQUIRE) & BIT_MASK(n)) != 0;
 }
 
-inline int bitmap64_ffs(int64_t *bitmap){
-	return ffsll(*bitmap) - 1;
+/* takes the whole word, acquiring what the setters released */
+static inline uint64_t bitmap_take(uint64_t *word){
+	return __atomic_exchange_n(word, 0, __ATOMIC_ACQUIRE);
 }
 
-inline int bitmap32_ffs(int32_t *bitmap){
-	return ffs(*bitmap) - 1;
+static inline int bitmap_ffs(uint64_t word){
+	return ffsll(word) - 1;
 }
 
-inline void bitmap64_print(int64_t *bitmap, FILE *out){
-	fprintf(out, "Bitmap 64:\t");
-	fprintf(out, "%lld\t", *bitmap);
-	fprintf(out, "\n");
-}
+static inline void bitmap_print(uint64_t *bitmap, int nbits, FILE *out){
+	int i;
 
-inline void bitmap32_print(int32_t *bitmap, FILE *out){
-	fprintf(out, "Bitmap 32:\t");
-	fprintf(out, "%d\t", *bitmap);
+	for(i = BITS_TO_WORDS(nbits) - 1; i >= 0; i--)
+		fprintf(out, "%016llx", (unsigned long long)bitmap[i]);
 	fprintf(out, "\n");
 }
 
-/* data structure lock */
-#define DS_LOCK_LOCKED				1
-#define DS_LOCK_UNLOCKED			0
-
-struct data_structure_lock{
-	int lock;
-};
-
-/* data structure lock interface */
-void fc_lock(struct data_structure_lock *ds_lock)
+/* data structure lock, one of the selectable locks */
+static inline int fc_trylock(lock_t *ds_lock)
 {
-	while(!__sync_bool_compare_and_swap(&ds_lock->lock, 0, 1))
-		;
+	return lock_tryacquire(ds_lock);
 }
 
-int fc_trylock(struct data_structure_lock *ds_lock)
+static inline void fc_lock(lock_t *ds_lock)
 {
-	if(__sync_bool_compare_and_swap(&ds_lock->lock, 0, 1))
-		return 0;
-	else
-		return -1;
+	lock_acquire(ds_lock);
 }
 
-void fc_unlock(struct data_structure_lock *ds_lock)
+static inline void fc_unlock(lock_t *ds_lock)
 {
-	ds_lock->lock = 0;
-	__sync_synchronize();
+	lock_release(ds_lock);
 }
 
-/* publication record list */
-struct pub_list{
-	/* publisher CPUs bitmap*/
-	int64_t cpu_bitmap;
+/*
+ * per CPU publication state, on its own cache line: only
+ * the owner CPU and the combiner clearing the consumed
+ * records ever touch it
+ */
+struct pub_cpu{
 	/* active publication records bitmap */
-	int32_t rec_bitmap[NR_CPUS];
-	/* publication record array*/
-	struct pub_record rec_array[NR_CPUS * PUB_RECORD_PER_CPU];
-	/* last used per CPU publication record index */
-	int last_used_idx[NR_CPUS];
+	uint64_t rec_bitmap;
+	/* last used publication record index */
+	int last_used_idx;
+	/* last publication sequence number */
+	unsigned long last_seq;
+} __attribute__((aligned(64)));
+
+/*
+ * publication record list
+ *
+ * publisher CPUs are tracked by a two level bitmap: one word
+ * every 64 CPUs, plus a summary word with a bit set for every
+ * non empty CPU word, so that a combiner finds the next
+ * publisher with two ffs() even with thousands of CPUs.
+ * Publishers from 0 to nproc - 1 are the CPUs updating the
+ * data structure, the following nproc are the threads
+ * waiting for a find, with a single record each
+ */
+struct pub_list{
+	/* number of CPUs */
+	int nproc;
+	/* number of publishers, updaters and readers */
+	int npub;
+	/* non empty cpu_bitmap words */
+	uint64_t *summary;
+	/* publisher CPUs bitmap */
+	uint64_t *cpu_bitmap;
+	/* per CPU publication state */
+	struct pub_cpu *cpus;
+	/* publication record array, PUB_RECORD_PER_CPU per CPU */
+	struct pub_record *rec_array;
+	/* find records, one per reader */
+	struct pub_record *read_array;
 };
 
 /* flat combining helper structure */
@@ -122,44 +132,279 @@ struct flat_combining{
 	/* publication list */
 	struct pub_list map;
 	/* data structure lock */
-	struct data_structure_lock ds_lock;
+	lock_t ds_lock;
+	/* operations applied and eliminated by combiners */
+	unsigned long long applied;
+	unsigned long long eliminated;
+	/* combining passes that applied something */
+	unsigned long long passes;
+	/* finds served and handler calls serving them */
+	unsigned long long finds;
+	unsigned long long find_calls;
+	/* find handler */
+	int (*find)(void *data_structure, __u64 *dline);
+	/* readers collected during a combining pass */
+	int *readers;
+	int nreaders;
+	/* batch handler and batch collected during a combining pass */
+	void (*batch_fn)(void *data_structure, struct pub_record **recs, int n);
+	struct pub_record **batch;
+	uint64_t *batch_bits;
+	int *batch_cpus;
+	int nbatch;
+	/* snapshot of the last find, under a sequence counter */
+	int snapshot;
+	unsigned int snap_seq;
+	int snap_cpu;
+	__u64 snap_dline;
 };
 
-/* flat combining interface */
-static void fc_do_combiner(struct flat_combining *fc)
+/* find record index of the calling thread, -1 until it first reads */
+static __thread int fc_reader_id = -1;
+static int fc_readers;
+
+/*
+ * a publisher sets its record bit, then its CPU bit and
+ * then the summary bit; the combiner clears them in the
+ * opposite order before reading the level below, so a
+ * record published meanwhile is never lost
+ */
+static void fc_mark_cpu(struct pub_list *map, const int cpu)
+{
+	bitmap_set(map->cpu_bitmap, cpu);
+	bitmap_set(map->summary, BIT_WORD(cpu));
+}
+
+/*
+ * a PREEMPT overwrites the whole state of a CPU, so among
+ * the records published by a CPU only the latest one has
+ * to be applied, the others are eliminated
+ */
+static void fc_combine_cpu(struct flat_combining *fc, const int cpu_index)
+{
+	struct pub_list *map = &fc->map;
+	struct pub_record *rec, *last;
+	int rec_index;
+	uint64_t pending, batch;
+
+	while((batch = __atomic_load_n(&map->cpus[cpu_index].rec_bitmap, __ATOMIC_ACQUIRE))){
+		last = NULL;
+		pending = batch;
+		while((rec_index = bitmap_ffs(pending)) >= 0){
+			rec = &map->rec_array[cpu_index * PUB_RECORD_PER_CPU + rec_index];
+			if(!last || (long)(rec->seq - last->seq) > 0)
+				last = rec;
+			pending &= pending - 1;
+		}
+		fc->eliminated += __builtin_popcountll(batch) - 1;
+
+		/* FIND records live in read_array, never in a CPU batch */
+		if(last->req == PREEMPT){
+			last->h.preempt_h.function(fc->data_structure, last->par.preempt_p.cpu, last->par.preempt_p.dline, last->par.preempt_p.is_valid);
+			fc->applied++;
+		}
+
+		/* records can be reused only once they are not read anymore */
+		__atomic_fetch_and(&map->cpus[cpu_index].rec_bitmap, ~batch, __ATOMIC_RELEASE);
+	}
+}
+
+/*
+ * read combining: a single call of the find handler, after
+ * the updates of the pass, serves all the pending finds
+ */
+static void fc_serve_finds(struct flat_combining *fc, int nreaders)
 {
 	struct pub_list *map = &fc->map;
 	struct pub_record *rec;
-	int cpu_index, rec_index;
+	__u64 dline;
+	int cpu, i;
+
+	cpu = fc->find(fc->data_structure, &dline);
+	fc->find_calls++;
+
+	if(fc->snapshot){
+		__atomic_store_n(&fc->snap_seq, fc->snap_seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		__atomic_store_n(&fc->snap_cpu, cpu, __ATOMIC_RELAXED);
+		__atomic_store_n(&fc->snap_dline, dline, __ATOMIC_RELAXED);
+		__atomic_store_n(&fc->snap_seq, fc->snap_seq + 1, __ATOMIC_RELEASE);
+	}
 
-	while((cpu_index = bitmap64_ffs(&map->cpu_bitmap)) >= 0){
-		while((rec_index = bitmap32_ffs(&map->rec_bitmap[cpu_index])) >= 0){
-			rec = &map->rec_array[cpu_index * PUB_RECORD_PER_CPU + rec_index];
-			switch(rec->req){
-				case PREEMPT:
-					rec->h.preempt_h.function(fc->data_structure, rec->par.preempt_p.cpu, rec->par.preempt_p.dline, rec->par.preempt_p.is_valid);
-					break;
+	for(i = 0; i < nreaders; i++){
+		rec = &map->read_array[fc->readers[i]];
+		rec->res.find_r.cpu = cpu;
+		rec->res.find_r.dline = dline;
+		/* releases the result to the reader */
+		__atomic_fetch_and(&map->cpus[map->nproc + fc->readers[i]].rec_bitmap, 0, __ATOMIC_RELEASE);
+	}
+	fc->finds += nreaders;
+}
+
+/*
+ * batch mode: only collect the latest record of the CPU, the
+ * batch handler applies the records of all the CPUs at once
+ * at the end of the pass
+ */
+static void fc_collect_cpu(struct flat_combining *fc, const int cpu_index)
+{
+	struct pub_list *map = &fc->map;
+	struct pub_record *rec, *last = NULL;
+	int rec_index;
+	uint64_t pending, batch;
+
+	batch = __atomic_load_n(&map->cpus[cpu_index].rec_bitmap, __ATOMIC_ACQUIRE);
+	if(!batch)
+		return;
+
+	pending = batch;
+	while((rec_index = bitmap_ffs(pending)) >= 0){
+		rec = &map->rec_array[cpu_index * PUB_RECORD_PER_CPU + rec_index];
+		if(!last || (long)(rec->seq - last->seq) > 0)
+			last = rec;
+		pending &= pending - 1;
+	}
+	fc->eliminated += __builtin_popcountll(batch) - 1;
+
+	fc->batch[fc->nbatch] = last;
+	fc->batch_bits[fc->nbatch] = batch;
+	fc->batch_cpus[fc->nbatch++] = cpu_index;
+}
+
+static void fc_apply_batch(struct flat_combining *fc)
+{
+	struct pub_list *map = &fc->map;
+	int i;
+
+	if(!fc->nbatch)
+		return;
+
+	fc->batch_fn(fc->data_structure, fc->batch, fc->nbatch);
+	fc->applied += fc->nbatch;
+
+	/* records can be reused only once they are not read anymore */
+	for(i = 0; i < fc->nbatch; i++)
+		__atomic_fetch_and(&map->cpus[fc->batch_cpus[i]].rec_bitmap, ~fc->batch_bits[i], __ATOMIC_RELEASE);
+	fc->nbatch = 0;
+}
+
+/* one sweep of the publication list, returns the publishers found */
+static int fc_sweep(struct flat_combining *fc)
+{
+	struct pub_list *map = &fc->map;
+	int sum_index, word_index, bit, cpu_bit, pub, found = 0;
+	uint64_t word, cpus;
+
+	for(sum_index = 0; sum_index < BITS_TO_WORDS(BITS_TO_WORDS(map->npub)); sum_index++){
+		word = bitmap_take(&map->summary[sum_index]);
+		while((bit = bitmap_ffs(word)) >= 0){
+			word &= word - 1;
+			word_index = sum_index * BITS_PER_WORD + bit;
+			cpus = bitmap_take(&map->cpu_bitmap[word_index]);
+			while((cpu_bit = bitmap_ffs(cpus)) >= 0){
+				cpus &= cpus - 1;
+				pub = word_index * BITS_PER_WORD + cpu_bit;
+				if(pub >= map->nproc)
+					fc->readers[fc->nreaders++] = pub - map->nproc;
+				else if(fc->batch_fn)
+					fc_collect_cpu(fc, pub);
+				else
+					fc_combine_cpu(fc, pub);
+				found++;
 			}
-			bitmap32_clear(&map->rec_bitmap[cpu_index], rec_index);
 		}
-		bitmap64_clear(&map->cpu_bitmap, cpu_index);
 	}
+
+	return found;
+}
+
+/*
+ * without a batch handler sweeps are repeated until nothing
+ * is pending; with it a single sweep makes the batch, records
+ * published meanwhile wait for the next pass, as the CPUs
+ * waiting for a free record keep on marking themselves
+ */
+static int fc_do_combiner(struct flat_combining *fc)
+{
+	unsigned long long applied = fc->applied;
+	int found, total = 0;
+
+	fc->nreaders = 0;
+	if(fc->batch_fn){
+		total = fc_sweep(fc);
+		fc_apply_batch(fc);
+	}else
+		while((found = fc_sweep(fc)))
+			total += found;
+
+	if(fc->applied != applied)
+		__atomic_store_n(&fc->passes, fc->passes + 1, __ATOMIC_RELAXED);
+
+	if(fc->nreaders || (fc->snapshot && fc->applied != applied))
+		fc_serve_finds(fc, fc->nreaders);
+
+	return total;
 }
 
-struct flat_combining *fc_create(void *data_structure)
+struct flat_combining *fc_create(void *data_structure, int nproc)
 {
 	struct flat_combining *fc;
+	struct pub_list *map;
 
 	fc = (struct flat_combining *)calloc(1, sizeof(*fc));
-	fc->ds_lock.lock = DS_LOCK_UNLOCKED;
+	if(!fc){
+		fprintf(stderr, "could not allocate flat combining structure\n");
+		exit(-1);
+	}
+	lock_init(&fc->ds_lock);
 	fc->data_structure = data_structure;
 
+	map = &fc->map;
+	map->nproc = nproc;
+	map->npub = 2 * nproc;
+	map->summary = (uint64_t *)calloc(BITS_TO_WORDS(BITS_TO_WORDS(map->npub)), sizeof(*map->summary));
+	map->cpu_bitmap = (uint64_t *)calloc(BITS_TO_WORDS(map->npub), sizeof(*map->cpu_bitmap));
+	fc->readers = (int *)calloc(nproc, sizeof(*fc->readers));
+	fc->batch = (struct pub_record **)calloc(nproc, sizeof(*fc->batch));
+	fc->batch_bits = (uint64_t *)calloc(nproc, sizeof(*fc->batch_bits));
+	fc->batch_cpus = (int *)calloc(nproc, sizeof(*fc->batch_cpus));
+	if(posix_memalign((void **)&map->cpus, 64, map->npub * sizeof(*map->cpus)))
+		map->cpus = NULL;
+	else
+		memset(map->cpus, 0, map->npub * sizeof(*map->cpus));
+	if(posix_memalign((void **)&map->rec_array, 64, nproc * PUB_RECORD_PER_CPU * sizeof(*map->rec_array)))
+		map->rec_array = NULL;
+	else
+		memset(map->rec_array, 0, nproc * PUB_RECORD_PER_CPU * sizeof(*map->rec_array));
+	if(posix_memalign((void **)&map->read_array, 64, nproc * sizeof(*map->read_array)))
+		map->read_array = NULL;
+	else
+		memset(map->read_array, 0, nproc * sizeof(*map->read_array));
+	if(!map->summary || !map->cpu_bitmap || !map->cpus || !map->rec_array || !map->read_array || !fc->readers ||
+			!fc->batch || !fc->batch_bits || !fc->batch_cpus){
+		fprintf(stderr, "could not allocate publication list for %d CPUs\n", nproc);
+		exit(-1);
+	}
+
 	return fc;
 }
 
 int fc_destroy(struct flat_combining *fc)
 {
+	struct pub_list *map;
+
 	if(fc){
+		map = &fc->map;
+		free(map->summary);
+		free(map->cpu_bitmap);
+		free(map->cpus);
+		free(map->rec_array);
+		free(map->read_array);
+		free(fc->readers);
+		free(fc->batch);
+		free(fc->batch_bits);
+		free(fc->batch_cpus);
+		lock_destroy(&fc->ds_lock);
 		free(fc);	
 		return 0;
 	}
@@ -173,20 +418,19 @@ struct pub_record *fc_get_record(struct flat_combining *fc, const int cpu)
 	int idx_to_use;
 
 	/* next publication record to use */
-	idx_to_use = map->last_used_idx[cpu];
+	idx_to_use = map->cpus[cpu].last_used_idx;
 
 	while(1){
 		/* if not busy we use it */
-		if(!bitmap32_test(&map->rec_bitmap[cpu], idx_to_use))
+		if(!bitmap_test(&map->cpus[cpu].rec_bitmap, idx_to_use))
 			return &map->rec_array[cpu * PUB_RECORD_PER_CPU + idx_to_use];
 
 		/* no free record: 
 		 * set bit in cpu_bitmap then 
 		 * spin to become a combiner 
 		 */
-		while(bitmap32_test(&map->rec_bitmap[cpu], idx_to_use)){
-			bitmap64_set(&map->cpu_bitmap, cpu);
-			__sync_synchronize();
+		while(bitmap_test(&map->cpus[cpu].rec_bitmap, idx_to_use)){
+			fc_mark_cpu(map, cpu);
 			fc_try_combiner(fc);
 		}
 	}
@@ -196,13 +440,79 @@ struct pub_record *fc_get_record(struct flat_combining *fc, const int cpu)
 void fc_publish_record(struct flat_combining *fc, const int cpu)
 {
 	struct pub_list *map = &fc->map;
+	struct pub_cpu *pc = &map->cpus[cpu];
 	int idx_to_use;
 
-	idx_to_use = map->last_used_idx[cpu];
-	map->last_used_idx[cpu] = (map->last_used_idx[cpu] + 1) % PUB_RECORD_PER_CPU;
+	idx_to_use = pc->last_used_idx;
+	pc->last_used_idx = (pc->last_used_idx + 1) % PUB_RECORD_PER_CPU;
+	map->rec_array[cpu * PUB_RECORD_PER_CPU + idx_to_use].seq = ++pc->last_seq;
+
+	/* releases the record contents to the combiner */
+	bitmap_set(&pc->rec_bitmap, idx_to_use);
+	fc_mark_cpu(map, cpu);
+}
 
-	bitmap32_set(&map->rec_bitmap[cpu], idx_to_use);
-	bitmap64_set(&map->cpu_bitmap, cpu);
+void fc_set_find(struct flat_combining *fc, int (*find)(void *data_structure, __u64 *dline), int snapshot)
+{
+	fc_lock(&fc->ds_lock);
+	fc->find = find;
+	fc->snapshot = snapshot;
+	if(snapshot)
+		fc_serve_finds(fc, 0);
+	fc_unlock(&fc->ds_lock);
+}
+
+void fc_set_batch(struct flat_combining *fc, void (*batch)(void *data_structure, struct pub_record **recs, int n))
+{
+	fc_lock(&fc->ds_lock);
+	fc->batch_fn = batch;
+	fc_unlock(&fc->ds_lock);
+}
+
+int fc_find(struct flat_combining *fc, __u64 *dline)
+{
+	struct pub_list *map = &fc->map;
+	struct pub_record *rec;
+	unsigned int seq;
+	int cpu, pub;
+
+	if(fc->snapshot){
+		do{
+			seq = __atomic_load_n(&fc->snap_seq, __ATOMIC_ACQUIRE);
+			cpu = __atomic_load_n(&fc->snap_cpu, __ATOMIC_RELAXED);
+			*dline = __atomic_load_n(&fc->snap_dline, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		}while((seq & 1) || seq != __atomic_load_n(&fc->snap_seq, __ATOMIC_RELAXED));
+
+		return cpu;
+	}
+
+	if(fc_reader_id == -1)
+		fc_reader_id = __atomic_fetch_add(&fc_readers, 1, __ATOMIC_RELAXED);
+
+	if(fc_reader_id >= map->nproc){
+		/* more threads than find records, read under the lock */
+		fc_lock(&fc->ds_lock);
+		fc_do_combiner(fc);
+		cpu = fc->find(fc->data_structure, dline);
+		fc_unlock(&fc->ds_lock);
+
+		return cpu;
+	}
+
+	pub = map->nproc + fc_reader_id;
+	rec = &map->read_array[fc_reader_id];
+	rec->req = FIND;
+	bitmap_set(&map->cpus[pub].rec_bitmap, 0);
+	fc_mark_cpu(map, pub);
+
+	/* the combiner clears the record once the result is there */
+	while(bitmap_test(&map->cpus[pub].rec_bitmap, 0))
+		fc_try_combiner(fc);
+
+	*dline = rec->res.find_r.dline;
+
+	return rec->res.find_r.cpu;
 }
 
 void fc_try_combiner(struct flat_combining *fc)
@@ -223,6 +533,17 @@ void fc_data_structure_unlock(struct flat_combining *fc)
 	fc_unlock(&fc->ds_lock);
 }
 
+int fc_data_structure_trylock(struct flat_combining *fc)
+{
+	return fc_trylock(&fc->ds_lock);
+}
+
+void fc_combine(struct flat_combining *fc)
+{
+	while(fc_do_combiner(fc))
+		;
+}
+
 void fc_print_publication_list(struct flat_combining *fc, FILE *out)
 {
 	struct pub_list *map = &fc->map;
@@ -231,11 +552,36 @@ void fc_print_publication_list(struct flat_combining *fc, FILE *out)
 	if(!out)
 		return;
 
-	bitmap64_print(&map->cpu_bitmap, out);
-	for(i = 0; i < NR_CPUS; i++){
-		fprintf(out, "[%d] ", i);
-		bitmap32_print(&map->rec_bitmap[i], out);
+	fprintf(out, "Summary:\t");
+	bitmap_print(map->summary, BITS_TO_WORDS(map->npub), out);
+	fprintf(out, "Publishers:\t");
+	bitmap_print(map->cpu_bitmap, map->npub, out);
+	for(i = 0; i < map->npub; i++){
+		fprintf(out, "[%d]\t", i);
+		bitmap_print(&map->cpus[i].rec_bitmap, PUB_RECORD_PER_CPU, out);
 	}
 
 	fprintf(out, "\n");
 }
+
+void fc_counters(struct flat_combining *fc, unsigned long long *applied, unsigned long long *passes)
+{
+	*applied = __atomic_load_n(&fc->applied, __ATOMIC_RELAXED);
+	*passes = __atomic_load_n(&fc->passes, __ATOMIC_RELAXED);
+}
+
+void fc_print_stats(struct flat_combining *fc, const char *name, FILE *out)
+{
+	if(!out || !(fc->applied + fc->eliminated))
+		return;
+
+	fprintf(out, "%s: %llu updates applied, %llu eliminated (%.2f%%)\n",
+		name, fc->applied, fc->eliminated,
+		100.0 * fc->eliminated / (fc->applied + fc->eliminated));
+	if(fc->snapshot)
+		fprintf(out, "%s: %llu find snapshots taken\n", name, fc->find_calls);
+	else if(fc->find_calls)
+		fprintf(out, "%s: %llu finds served by %llu calls (%.2f finds per call)\n",
+			name, fc->finds, fc->find_calls,
+			(double)fc->finds / fc->find_calls);
+}
@@ -0,0 +1,467 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Calendar queue: deadlines produced by arrival_process() live in a
+ * narrow window, so a CPU is kept in the bucket of its deadline and a
+ * two level summary bitmap (one word, then CAL_WORDS words) tells
+ * which buckets are not empty. Updates, serialized by a spinlock, are
+ * a bit clear plus a bit set; find, without locks, looks for the first
+ * (or last) non empty bucket starting from the origin of the window and
+ * takes the first CPU in it: every CPU in a bucket has the same deadline.
+ *
+ * The window only moves forward: when a deadline beyond its end comes
+ * the buckets left behind are moved to the overflow set, which is also
+ * where deadlines older than the origin go. Find compares the CPUs in
+ * the overflow set with the bucket winner, one by one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "calendar.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+#define CAL_MASK		(CAL_BUCKETS - 1)
+#define CAL_NONE		-1
+#define CAL_OVERFLOW		-2
+
+/* find retries when it races with an update */
+#define CAL_FIND_TRIES		3
+
+static inline __u64 *cal_bucket(cal_t *c, int b)
+{
+	return &c->buckets[b * c->cpu_words];
+}
+
+static inline __u64 cal_load(__u64 *w)
+{
+	return __atomic_load_n(w, __ATOMIC_ACQUIRE);
+}
+
+static inline void cal_store(__u64 *w, __u64 v)
+{
+	__atomic_store_n(w, v, __ATOMIC_RELEASE);
+}
+
+static int cal_bucket_empty(cal_t *c, int b)
+{
+	__u64 *bm = cal_bucket(c, b);
+	int i;
+
+	for (i = 0; i < c->cpu_words; i++)
+		if (bm[i])
+			return 0;
+
+	return 1;
+}
+
+/*
+ * cal_bucket_first - first CPU of a bucket, -1 if empty
+ */
+static int cal_bucket_first(cal_t *c, int b)
+{
+	__u64 *bm = cal_bucket(c, b), w;
+	int i;
+
+	for (i = 0; i < c->cpu_words; i++) {
+		w = cal_load(&bm[i]);
+		if (w)
+			return i * 64 + __builtin_ctzll(w);
+	}
+
+	return -1;
+}
+
+/*
+ * the following must be called with c->lock held,
+ * bits are set from the bucket up to the top word
+ * and cleared the other way round, so that a reader
+ * going down finds at worst an empty bucket
+ */
+
+static void cal_bucket_add(cal_t *c, int b, int cpu)
+{
+	__u64 *bm = cal_bucket(c, b);
+
+	cal_store(&bm[cpu / 64], bm[cpu / 64] | (1ULL << (cpu % 64)));
+	cal_store(&c->summary[b / 64], c->summary[b / 64] | (1ULL << (b % 64)));
+	cal_store(&c->top, c->top | (1ULL << (b / 64)));
+	c->cpu_to_bucket[cpu] = b;
+}
+
+static void cal_bucket_del(cal_t *c, int b, int cpu)
+{
+	__u64 *bm = cal_bucket(c, b);
+
+	cal_store(&bm[cpu / 64], bm[cpu / 64] & ~(1ULL << (cpu % 64)));
+	if (cal_bucket_empty(c, b)) {
+		cal_store(&c->summary[b / 64], c->summary[b / 64] & ~(1ULL << (b % 64)));
+		if (!c->summary[b / 64])
+			cal_store(&c->top, c->top & ~(1ULL << (b / 64)));
+	}
+	c->cpu_to_bucket[cpu] = CAL_NONE;
+}
+
+static void cal_overflow_add(cal_t *c, int cpu)
+{
+	cal_store(&c->overflow[cpu / 64], c->overflow[cpu / 64] | (1ULL << (cpu % 64)));
+	c->cpu_to_bucket[cpu] = CAL_OVERFLOW;
+}
+
+static void cal_overflow_del(cal_t *c, int cpu)
+{
+	cal_store(&c->overflow[cpu / 64], c->overflow[cpu / 64] & ~(1ULL << (cpu % 64)));
+	c->cpu_to_bucket[cpu] = CAL_NONE;
+}
+
+/*
+ * cal_advance - move the window so that it starts at
+ * origin, CPUs in the buckets left behind are moved
+ * to the overflow set
+ */
+static void cal_advance(cal_t *c, __u64 origin)
+{
+	__u64 d;
+	int b, cpu;
+
+	for (d = c->origin; d < origin && d < c->origin + CAL_BUCKETS; d++) {
+		b = d & CAL_MASK;
+		while ((cpu = cal_bucket_first(c, b)) != -1) {
+			cal_bucket_del(c, b, cpu);
+			cal_overflow_add(c, cpu);
+		}
+	}
+	cal_store(&c->origin, origin);
+}
+
+/*
+ * lockless bucket search
+ */
+
+/*
+ * cal_next_bucket - first non empty bucket at or
+ * after start, wrapping around, -1 if none
+ */
+static int cal_next_bucket(cal_t *c, int start)
+{
+	int w = start / 64, w2;
+	__u64 bits, top;
+
+	bits = cal_load(&c->summary[w]) & (~0ULL << (start % 64));
+	if (bits)
+		return w * 64 + __builtin_ctzll(bits);
+
+	top = cal_load(&c->top);
+	/* words after w first, then from 0 up to w */
+	bits = w == 63 ? 0 : top & (~0ULL << (w + 1));
+	if (!bits)
+		bits = top & (w == 63 ? ~0ULL : (2ULL << w) - 1);
+	if (!bits)
+		return -1;
+
+	w2 = __builtin_ctzll(bits);
+	bits = cal_load(&c->summary[w2]);
+	if (w2 == w)
+		bits &= (1ULL << (start % 64)) - 1;
+	if (!bits)
+		return -1;
+
+	return w2 * 64 + __builtin_ctzll(bits);
+}
+
+/*
+ * cal_prev_bucket - first non empty bucket at or
+ * before start, wrapping around, -1 if none
+ */
+static int cal_prev_bucket(cal_t *c, int start)
+{
+	int w = start / 64, w2;
+	__u64 bits, top;
+
+	bits = cal_load(&c->summary[w]) & (~0ULL >> (63 - start % 64));
+	if (bits)
+		return w * 64 + 63 - __builtin_clzll(bits);
+
+	top = cal_load(&c->top);
+	/* words before w first, then from the last one down to w */
+	bits = top & ((1ULL << w) - 1);
+	if (!bits)
+		bits = top & (~0ULL << w);
+	if (!bits)
+		return -1;
+
+	w2 = 63 - __builtin_clzll(bits);
+	bits = cal_load(&c->summary[w2]);
+	if (w2 == w)
+		bits &= start % 64 == 63 ? 0 : ~0ULL << (start % 64 + 1);
+	if (!bits)
+		return -1;
+
+	return w2 * 64 + 63 - __builtin_clzll(bits);
+}
+
+void cal_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	cal_t *c = (cal_t *)s;
+	int i;
+
+	lock_init(&c->lock);
+	c->origin = 0;
+	c->top = 0;
+	memset(c->summary, 0, sizeof(c->summary));
+	c->nproc = nproc;
+	c->cmp_dl = cmp_dl;
+	c->latest = cmp_dl(1, 0);
+	c->cpu_words = (nproc + 63) / 64;
+
+	c->buckets = (__u64 *)calloc(CAL_BUCKETS * c->cpu_words, sizeof(*c->buckets));
+	c->overflow = (__u64 *)calloc(c->cpu_words, sizeof(*c->overflow));
+	c->cpu_to_bucket = (int *)malloc(nproc * sizeof(*c->cpu_to_bucket));
+	c->dline = (__u64 *)calloc(nproc, sizeof(*c->dline));
+	if (!c->buckets || !c->overflow || !c->cpu_to_bucket || !c->dline) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	for (i = 0; i < nproc; i++)
+		c->cpu_to_bucket[i] = CAL_NONE;
+}
+
+void cal_cleanup(void *s)
+{
+	cal_t *c = (cal_t *)s;
+
+	lock_destroy(&c->lock);
+	free(c->dline);
+	free(c->cpu_to_bucket);
+	free(c->overflow);
+	free(c->buckets);
+}
+
+int cal_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	cal_t *c = (cal_t *)s;
+	int b;
+
+	if (cpu < 0 || cpu >= c->nproc) {
+		fprintf(stderr, "WARNING: cal_set on CPU %d, only %d CPUs available\n",
+				cpu, c->nproc);
+		return -1;
+	}
+
+	lock_acquire(&c->lock);
+
+	b = c->cpu_to_bucket[cpu];
+	if (b == CAL_OVERFLOW)
+		cal_overflow_del(c, cpu);
+	else if (b != CAL_NONE)
+		cal_bucket_del(c, b, cpu);
+
+	__atomic_store_n(&c->dline[cpu], is_valid ? dline : 0, __ATOMIC_RELEASE);
+
+	if (is_valid) {
+		if (dline >= c->origin + CAL_BUCKETS)
+			cal_advance(c, dline - CAL_BUCKETS + 1);
+
+		if (dline < c->origin)
+			cal_overflow_add(c, cpu);
+		else
+			cal_bucket_add(c, dline & CAL_MASK, cpu);
+	}
+
+	lock_release(&c->lock);
+
+	return 0;
+}
+
+/*
+ * cal_find_dl - return the best CPU and its deadline,
+ * -1 if there isn't any
+ * @s:			the calendar
+ * @dline:	where to store the deadline of the CPU found
+ */
+int cal_find_dl(void *s, __u64 *dline)
+{
+	cal_t *c = (cal_t *)s;
+	int tries, b, i, cpu = -1, other;
+	__u64 origin, dl = 0, other_dl, w;
+
+	for (tries = 0; tries < CAL_FIND_TRIES && cpu == -1; tries++) {
+		origin = cal_load(&c->origin);
+		if (c->latest)
+			b = cal_prev_bucket(c, (origin + CAL_BUCKETS - 1) & CAL_MASK);
+		else
+			b = cal_next_bucket(c, origin & CAL_MASK);
+		if (b == -1)
+			break;
+		/* an emptied bucket means we raced with an update */
+		cpu = cal_bucket_first(c, b);
+	}
+	if (cpu != -1)
+		dl = cal_load(&c->dline[cpu]);
+
+	for (i = 0; i < c->cpu_words; i++)
+		for (w = cal_load(&c->overflow[i]); w; w &= w - 1) {
+			other = i * 64 + __builtin_ctzll(w);
+			other_dl = cal_load(&c->dline[other]);
+			if (other_dl && (cpu == -1 || c->cmp_dl(other_dl, dl))) {
+				cpu = other;
+				dl = other_dl;
+			}
+		}
+
+	*dline = dl;
+
+	return cpu;
+}
+
+int cal_find(void *s)
+{
+	__u64 dline;
+
+	return cal_find_dl(s, &dline);
+}
+
+void cal_save(void *s, int nproc, FILE *f)
+{
+	cal_t *c = (cal_t *)s;
+	int i, b;
+
+	lock_acquire(&c->lock);
+
+	fprintf(f, "Calendar (origin %llu):\n[ ", c->origin);
+	for (i = 0; i < nproc; i++) {
+		b = c->cpu_to_bucket[i];
+		if (b == CAL_NONE)
+			fprintf(f, "(%d, -) ", i);
+		else
+			fprintf(f, "(%d, %llu%s) ", i, c->dline[i],
+					b == CAL_OVERFLOW ? " overflow" : "");
+	}
+	fprintf(f, "]\n");
+
+	lock_release(&c->lock);
+}
+
+void cal_print(void *s, int nproc)
+{
+	cal_save(s, nproc, stdout);
+}
+
+/*
+ * cal_check - every CPU must be where its deadline says, the
+ * summary bitmaps must reflect the buckets and find must
+ * return a CPU with the best deadline
+ */
+int cal_check(void *s, int nproc)
+{
+	cal_t *c = (cal_t *)s;
+	int i, b, cpu, best = -1, flag = 1;
+	__u64 dl, best_dl = 0;
+
+	lock_acquire(&c->lock);
+
+	for (i = 0; i < nproc && flag; i++) {
+		dl = c->dline[i];
+		b = c->cpu_to_bucket[i];
+		if (!dl)
+			flag = b == CAL_NONE;
+		else if (dl < c->origin || dl >= c->origin + CAL_BUCKETS)
+			flag = b == CAL_OVERFLOW &&
+				(c->overflow[i / 64] >> (i % 64)) & 1;
+		else
+			flag = b == (dl & CAL_MASK) &&
+				(cal_bucket(c, b)[i / 64] >> (i % 64)) & 1;
+		if (!flag)
+			printf("CPU %d (deadline %llu) is in the wrong place (%d)!\n",
+				i, dl, b);
+		if (dl && (best == -1 || c->cmp_dl(dl, best_dl))) {
+			best = i;
+			best_dl = dl;
+		}
+	}
+
+	for (b = 0; b < CAL_BUCKETS && flag; b++) {
+		for (i = 0; i < nproc; i++)
+			if ((cal_bucket(c, b)[i / 64] >> (i % 64)) & 1 &&
+					c->cpu_to_bucket[i] != b) {
+				printf("CPU %d is a stale entry of bucket %d!\n", i, b);
+				flag = 0;
+			}
+		if (((c->summary[b / 64] >> (b % 64)) & 1) == cal_bucket_empty(c, b)) {
+			printf("Summary bit of bucket %d is wrong!\n", b);
+			flag = 0;
+		}
+	}
+
+	for (i = 0; i < CAL_WORDS && flag; i++)
+		if (((c->top >> i) & 1) != !!c->summary[i]) {
+			printf("Top bit of summary word %d is wrong!\n", i);
+			flag = 0;
+		}
+
+	if (flag) {
+		cpu = cal_find_dl(s, &dl);
+		if (cpu != -1 ? dl != best_dl : best != -1) {
+			printf("Find returned CPU %d (deadline %llu), CPU %d"
+				" (deadline %llu) expected!\n", cpu, dl, best, best_dl);
+			flag = 0;
+		}
+	}
+
+	lock_release(&c->lock);
+
+	if (!flag)
+		cal_print(s, nproc);
+
+	return flag;
+}
+
+int cal_check_cpu(void *s, int cpu, __u64 dline)
+{
+	cal_t *c = (cal_t *)s;
+	int flag;
+
+	lock_acquire(&c->lock);
+	flag = c->dline[cpu] == dline &&
+		(c->cpu_to_bucket[cpu] == CAL_NONE) == !dline;
+	lock_release(&c->lock);
+
+	return flag;
+}
+
+const struct data_struct_ops calendar_ops = {
+	.data_init = cal_init,
+	.data_cleanup = cal_cleanup,
+	.data_preempt = cal_set,
+	.data_finish = cal_set,
+	.data_find = cal_find,
+	.data_find_dl = cal_find_dl,
+	.data_max = cal_find,
+	.data_save = cal_save,
+	.data_print = cal_print,
+	.data_check = cal_check,
+	.data_check_cpu = cal_check_cpu
+};
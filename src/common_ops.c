@@ -24,7 +24,7 @@
 
 #include "common_ops.h"
 #include "kernel_data_struct.h"
-#include "rq_heap.h"
+#include "rq_queue.h"
 #include "measure.h"
 #include "parameters.h"
 
@@ -36,7 +36,8 @@
 
 /*
  * With this source file we implement a
- * runqueue based on a binomial heap.
+ * runqueue based on a priority queue
+ * chosen at startup (see rq_queue.c).
  * Since we have some discrepancies from
  * Linux scheduler, we indicate these
  * with a comment like "in Linux..."
@@ -89,28 +90,16 @@ int __prio_lower(int a, int b)
 #endif /* SCHED_RT */
 
 /*
- * task_compare - compare the deadlines of two struct rq_heap_node,
+ * task_compare - compare the deadlines of two tasks,
  * return > 0 if the first is earlier than the second one
- * @a:		pointer to first struct rq_heap_node
- * @b:		pointer to second struct rq_heap_node
+ * @a:		pointer to first struct task_struct
+ * @b:		pointer to second struct task_struct
  */
-static int task_compare(struct rq_heap_node* _a, struct rq_heap_node* _b)
+static int task_compare(struct task_struct *a, struct task_struct *b)
 {
-	struct task_struct *a, *b;
-
-	if(!_a || !_b){
-#ifdef DEBUG	
-		fprintf(stderr, "ERROR: passing NULL pointer to task_compare!\n");
-#endif /* DEBUG */
-		exit(-1);
-	}
-
-	a = (struct task_struct*) rq_heap_node_value(_a);
-	b = (struct task_struct*) rq_heap_node_value(_b);
-
 	if(!a || !b){
 #ifdef DEBUG	
-		fprintf(stderr, "ERROR: passing NULL pointer to __dl_time_before!\n");
+		fprintf(stderr, "ERROR: passing NULL pointer to task_compare!\n");
 #endif /* DEBUG */
 		exit(-1);
 	}
@@ -134,6 +123,9 @@ void task_init(struct task_struct *t, __u64 dline, int pid)
 {
 	t->pid = pid;
 	t->deadline = dline;
+	t->node.task = t;
+	t->pushable_node.task = t;
+	t->pushable = 0;
 }
 #endif /* SCHED_DEADLINE */
 
@@ -151,6 +143,9 @@ void task_init(struct task_struct *t, int prio, int runtime, int pid)
 	t->prio = prio;
 	t->runtime = runtime;
 	cpumask_setall(&t->cpus_allowed);
+	t->node.task = t;
+	t->pushable_node.task = t;
+	t->pushable = 0;
 }
 #endif /* SCHED_RT */
 
@@ -165,8 +160,10 @@ void task_init(struct task_struct *t, int prio, int runtime, int pid)
 void rq_init (struct rq *rq, int cpu, struct root_domain *rd, FILE *f)
 {
 	rq->cpu = cpu;
-	rq_heap_init(&rq->heap);
-	pthread_spin_init(&rq->lock, 0);
+	rq_queue_init(&rq->queue);
+	rq_queue_init(&rq->pushable);
+	rq->nr_pushable = 0;
+	lock_init(&rq->lock);
 
 #ifdef SCHED_DEADLINE
 	rq->earliest = 0;
@@ -189,13 +186,16 @@ void rq_init (struct rq *rq, int cpu, struct root_domain *rd, FILE *f)
  */
 void rq_destroy (struct rq *rq)
 {
-	struct rq_heap_node *node;
+	struct task_struct *task;
 
-	while(!rq_heap_empty(&rq->heap)){
-		node = rq_heap_take(task_compare, &rq->heap);
-		free((struct task_struct *)rq_heap_node_value(node));
-		free(node);
-	}
+	while((task = rq_queue_take(&rq->pushable)))
+		task->pushable = 0;
+	rq->nr_pushable = 0;
+	rq_queue_destroy(&rq->pushable);
+
+	while((task = rq_queue_take(&rq->queue)))
+		free(task);
+	rq_queue_destroy(&rq->queue);
 }
 
 /*
@@ -204,12 +204,7 @@ void rq_destroy (struct rq *rq)
  */
 void rq_lock (struct rq *rq)
 {	
-	if(pthread_spin_lock(&rq->lock)){
-#ifdef DEBUG
-		fprintf(stderr, "error while acquiring spin lock on runqueue %d\n", rq->cpu);
-#endif /* DEBUG */
-		exit(-1);	
-	}
+	lock_acquire(&rq->lock);
 }
 
 /*
@@ -218,12 +213,7 @@ void rq_lock (struct rq *rq)
  */
 void rq_unlock (struct rq *rq)
 {
-	if(pthread_spin_unlock(&rq->lock)){
-#ifdef DEBUG
-		fprintf(stderr, "error while releasing spin lock on runqueue %d\n", rq->cpu);
-#endif /* DEBUG */
-		exit(-1);
-	}
+	lock_release(&rq->lock);
 }
 
 /*
@@ -273,9 +263,50 @@ static void rq_double_lock(struct rq *rq1, struct rq *rq2){
  * return a pointer to the task if runqueue is not empty, NULL otherwise
  * @rq:		the runqueue we want to peek at
  */
-struct rq_heap_node *rq_peek (struct rq *rq)
+struct task_struct *rq_peek (struct rq *rq)
 {
-	return rq_heap_peek(task_compare, &rq->heap);
+	return rq_queue_peek(&rq->queue);
+}
+
+/*
+ * enqueue_pushable_task - let push consider a queued task
+ * @rq:			the runqueue of the task
+ * @task:		the task
+ */
+static void enqueue_pushable_task(struct rq *rq, struct task_struct *task)
+{
+	if(task->pushable)
+		return;
+
+	rq_queue_insert(&rq->pushable, &task->pushable_node);
+	task->pushable = 1;
+	rq->nr_pushable++;
+}
+
+/*
+ * dequeue_pushable_task - hide a task from push, because it
+ * runs, leaves the runqueue or could not be pushed anywhere
+ * @rq:			the runqueue of the task
+ * @task:		the task
+ */
+static void dequeue_pushable_task(struct rq *rq, struct task_struct *task)
+{
+	if(!task->pushable)
+		return;
+
+	rq_queue_remove(&rq->pushable, &task->pushable_node);
+	task->pushable = 0;
+	rq->nr_pushable--;
+}
+
+/*
+ * pick_next_pushable_task - return the earliest deadline
+ * (highest priority) pushable task, NULL if none
+ * @rq:			the runqueue
+ */
+static struct task_struct *pick_next_pushable_task(struct rq *rq)
+{
+	return rq_queue_peek(&rq->pushable);
 }
 
 /*
@@ -283,10 +314,9 @@ struct rq_heap_node *rq_peek (struct rq *rq)
  * return a pointer to that task if runqueue is not empty, NULL otherwise
  * @rq: the runqueue we want to take the task from
  */
-struct rq_heap_node *rq_take (struct rq *rq)
+struct task_struct *rq_take (struct rq *rq)
 {
-	struct rq_heap_node  *ns_taken, *ns_next;
-	struct task_struct* ts_next;
+	struct task_struct *ts_taken, *ts_next;
 	int is_valid;
 
 #ifdef MEASURE_DEQUEUE_CYCLE
@@ -308,10 +338,15 @@ struct rq_heap_node *rq_take (struct rq *rq)
 #endif
 	}
 
-	ns_taken = rq_heap_take(task_compare, &rq->heap);
+	ts_taken = rq_queue_take(&rq->queue);
 #ifdef MEASURE_DEQUEUE_NUMBER
 	MEASURE_ACCOUNT_EVENT(dequeue_number, rq->cpu)
 #endif /* MEASURE_DEQUEUE_NUMBER */
+	if(ts_taken)
+		dequeue_pushable_task(rq, ts_taken);
+	/* the new earliest task runs, it is not pushable anymore */
+	if((ts_next = rq_queue_peek(&rq->queue)))
+		dequeue_pushable_task(rq, ts_next);
 
 #ifdef SCHED_RT
 	/* highest cache update */
@@ -338,9 +373,8 @@ struct rq_heap_node *rq_take (struct rq *rq)
 #endif /* MEASURE_PUSH_PREEMPT */
 #endif /* SCHED_DEADLINE */
 	/* next cache update */
-	ns_next = rq_heap_peek_next(task_compare, &rq->heap);
-	if (ns_next != NULL) {
-		ts_next = (struct task_struct*) rq_heap_node_value(ns_next);
+	ts_next = rq_queue_peek_next(&rq->queue);
+	if (ts_next != NULL) {
 #ifdef SCHED_DEADLINE
 		rq->next = ts_next->deadline;
 #endif /* SCHED_DEADLINE */
@@ -365,19 +399,19 @@ struct rq_heap_node *rq_take (struct rq *rq)
 	MEASURE_END(dequeue_cycle, rq->cpu)
 #endif
 
-	return ns_taken;
+	return ts_taken;
 }
 
 /*
- * rq_take_next - remove the next earliest deadline task in the runqueue,
- * return a pointer to that task if runqueue has two or more deadline task
- * in it, NULL otherwise
+ * __rq_take_next - remove a task other than the earliest deadline one
+ * from the runqueue, the next earliest if task is NULL, return a pointer
+ * to the removed task, NULL if the runqueue has less than two tasks
  * @rq:		the runqueue we want to take the task from
+ * @task:	the task to remove, NULL for the next earliest
  */
-struct rq_heap_node *rq_take_next (struct rq *rq)
+static struct task_struct *__rq_take_next (struct rq *rq, struct task_struct *task)
 {
-	struct rq_heap_node *ns_next, *new_ns_next;
-	struct task_struct* new_ts_next;
+	struct task_struct *ts_next, *new_ts_next;
 	int is_valid;
 
 #ifdef MEASURE_DEQUEUE_CYCLE
@@ -392,14 +426,19 @@ struct rq_heap_node *rq_take_next (struct rq *rq)
 #endif
 	}
 
-	ns_next = rq_heap_take_next(task_compare, &rq->heap);
+	if(task){
+		rq_queue_remove(&rq->queue, &task->node);
+		ts_next = task;
+	} else
+		ts_next = rq_queue_take_next(&rq->queue);
 #ifdef MEASURE_DEQUEUE_NUMBER
 		MEASURE_ACCOUNT_EVENT(dequeue_number, rq->cpu)
 #endif
+	if(ts_next)
+		dequeue_pushable_task(rq, ts_next);
 
 	/* next cache update */
-	if (ns_next != NULL && (new_ns_next = rq_heap_peek_next(task_compare, &rq->heap))) {
-		new_ts_next = (struct task_struct *)rq_heap_node_value(new_ns_next);
+	if (ts_next != NULL && (new_ts_next = rq_queue_peek_next(&rq->queue))) {
 #ifdef SCHED_DEADLINE
 		rq->next = new_ts_next->deadline;
 #endif /* SCHED_DEADLINE */
@@ -424,7 +463,18 @@ struct rq_heap_node *rq_take_next (struct rq *rq)
 	MEASURE_END(dequeue_cycle, rq->cpu)
 #endif
 
-	return ns_next;
+	return ts_next;
+}
+
+/*
+ * rq_take_next - remove the next earliest deadline task in the runqueue,
+ * return a pointer to that task if runqueue has two or more deadline task
+ * in it, NULL otherwise
+ * @rq:		the runqueue we want to take the task from
+ */
+struct task_struct *rq_take_next (struct rq *rq)
+{
+	return __rq_take_next(rq, NULL);
 }
 
 /*
@@ -447,21 +497,21 @@ void add_task_rq(struct rq* rq, struct task_struct* task)
 	int old_highest = rq->highest, old_next = rq->next;
 	task->rq = rq;
 #endif
-	struct rq_heap_node* hn;
+	struct task_struct *curr = rq->nrunning ? rq_queue_peek(&rq->queue) : NULL;
 	int is_valid;
 
-	hn = calloc(1, sizeof(*hn));
-	if(!hn){
-		fprintf(stderr, "out of memory\n");
-		fflush(stderr);
-		exit(-1);	
-	}
-
-	rq_heap_node_init(hn, task);
-	rq_heap_insert(task_compare, &rq->heap, hn);
+	rq_queue_insert(&rq->queue, &task->node);
 #ifdef MEASURE_ENQUEUE_NUMBER
 		MEASURE_ACCOUNT_EVENT(enqueue_number, rq->cpu)
 #endif
+	/*
+	 * a task that does not run is pushable, and so
+	 * becomes the one it preempts (put_prev_task() in Linux)
+	 */
+	if(rq_queue_peek(&rq->queue) != task)
+		enqueue_pushable_task(rq, task);
+	else if(curr)
+		enqueue_pushable_task(rq, curr);
 
 	/* min and next cache update */
 #ifdef SCHED_DEADLINE
@@ -557,7 +607,6 @@ static int find_earlier_rq(int this_cpu){
  */
 static struct rq *find_lock_earlier_rq(struct rq *this_rq){
 	struct rq *earlier_rq = NULL;
-	struct rq_heap_node *node;
 	int tries;
 	int cpu;
 
@@ -573,8 +622,7 @@ static struct rq *find_lock_earlier_rq(struct rq *this_rq){
 		rq_double_lock(this_rq, earlier_rq);
 
 		/* check if the candidate runqueue still has task in */ 
-		node = rq_heap_peek_next(task_compare, &earlier_rq->heap);
-		if(node)
+		if(rq_queue_peek_next(&earlier_rq->queue))
 			break;
 
 		/* retry */
@@ -591,7 +639,6 @@ static struct rq *find_lock_earlier_rq(struct rq *this_rq){
  */
 int rq_pull_tasks(struct rq* this_rq)
 {
-	struct rq_heap_node *node;
 	struct task_struct *task;
 	struct rq *src_rq;
 #ifdef SCHED_RT
@@ -644,8 +691,7 @@ int rq_pull_tasks(struct rq* this_rq)
 		if(src_rq->nrunning <= 1)
 			goto skip;
 
-		node = rq_heap_peek_next(task_compare, &src_rq->heap);
-		task = rq_heap_node_value(node);
+		task = rq_queue_peek_next(&src_rq->queue);
 
 		/*
 		 * Do we have an RT task that preempts
@@ -676,8 +722,7 @@ int rq_pull_tasks(struct rq* this_rq)
 			/*
 			 * migrate task
 			 */
-			node = rq_take_next(src_rq);
-			task = rq_heap_node_value(node);
+			task = rq_take_next(src_rq);
 			add_task_rq(this_rq, task);
 		}
 
@@ -704,12 +749,10 @@ skip:
 		/* 
 		 * migrate task 
 		 */
-		node = rq_take_next(src_rq);
-		task = rq_heap_node_value(node);
+		task = rq_take_next(src_rq);
 		add_task_rq(this_rq, task);
 
 		rq_unlock(src_rq);
-		free(node);
 
 		return 1;
 	}
@@ -774,6 +817,7 @@ static int find_lowest_rq(struct task_struct *task, int this_cpu){
  */
 static int find_later_rq(struct task_struct *task, int this_cpu){
 	int best_cpu;
+	__u64 best_dl = 0;
 
 	/* 
 	 * in Linux there's a idle CPUs mask
@@ -787,12 +831,24 @@ static int find_later_rq(struct task_struct *task, int this_cpu){
 #ifdef MEASURE_PUSH_FIND
 	MEASURE_START(push_find, this_cpu)
 #endif
-	best_cpu = dso->data_find(push_data_struct);
+	if (dso->data_find_dl)
+		best_cpu = dso->data_find_dl(push_data_struct, &best_dl);
+	else
+		best_cpu = dso->data_find(push_data_struct);
 #ifdef MEASURE_PUSH_FIND
 	MEASURE_END(push_find, this_cpu)
 	REGISTER_OUTCOME(push_find, this_cpu, best_cpu, -1)
 #endif
 
+	/*
+	 * if the best candidate doesn't have a later
+	 * deadline there's no point in locking
+	 * its runqueue: nobody else has
+	 */
+	if (best_cpu != -1 && best_dl &&
+			!__dl_time_before(task->deadline, best_dl))
+		return -1;
+
 	return best_cpu;
 }
 #endif
@@ -809,7 +865,6 @@ static struct rq* find_lock_later_rq(struct task_struct *task,
 		struct rq *this_rq)
 {
 	struct rq *later_rq = NULL;
-	struct rq_heap_node *node;
 	int tries;
 	int cpu;
 
@@ -829,8 +884,7 @@ static struct rq* find_lock_later_rq(struct task_struct *task,
 		 * deadlock avoidance purpose)
 		 */
 		rq_double_lock(this_rq, later_rq);
-		node = rq_heap_peek_next(task_compare, &this_rq->heap);
-		if(rq_heap_node_value(node) != task){	/* something changed */
+		if(pick_next_pushable_task(this_rq) != task){	/* something changed */
 			rq_unlock(later_rq);
 			later_rq = NULL;
 
@@ -841,9 +895,11 @@ static struct rq* find_lock_later_rq(struct task_struct *task,
 		 * check if later_rq actually contains a task
 		 * with a later deadline. This is necessary 'cause
 		 * in some implementations of the global data structure
-		 * we can have a misalignment
+		 * we can have a misalignment; an idle later_rq
+		 * (as returned by the cpudl fast path) is always fine
 		 */
-		if(__dl_time_before(task->deadline, later_rq->earliest))
+		if(!later_rq->nrunning ||
+				__dl_time_before(task->deadline, later_rq->earliest))
 			break;
 
 		/* retry */
@@ -867,7 +923,6 @@ static struct rq* find_lock_lowest_rq(struct task_struct *task,
 		struct rq *this_rq)
 {
 	struct rq *lowest_rq = NULL;
-	struct rq_heap_node *node;
 	int tries;
 	int cpu;
 
@@ -887,8 +942,7 @@ static struct rq* find_lock_lowest_rq(struct task_struct *task,
 		 * deadlock avoidance purpose)
 		 */
 		rq_double_lock(this_rq, lowest_rq);
-		node = rq_heap_peek_next(task_compare, &this_rq->heap);
-		if(rq_heap_node_value(node) != task || 
+		if(pick_next_pushable_task(this_rq) != task || 
 			!cpumask_test_cpu(lowest_rq->cpu, tsk_cpus_allowed(task))){	/* something changed */
 
 			rq_unlock(lowest_rq);
@@ -916,12 +970,12 @@ static struct rq* find_lock_lowest_rq(struct task_struct *task,
 
 /*
  * rq_push_task - try to push a task from an overloaded runqueue
- * to another, return 1 if push take place, 0 otherwise
+ * to another, return 1 if push take place or the candidate turned
+ * out not to be pushable, 0 when there is nothing left to try
  * @this_rq:	the source runqueue
  */
 static int rq_push_task(struct rq* this_rq, int *push_count)
 {
-	struct rq_heap_node *node;
 	struct task_struct *next_task;
 #ifdef SCHED_DEADLINE
 	struct rq *later_rq;
@@ -934,26 +988,16 @@ static int rq_push_task(struct rq* this_rq, int *push_count)
 	if (!this_rq->overloaded)
 		return 0;
 
-	/* catch the next earliest deadline task */
 	/*
-	 * in Linux we have a pushable tasks RB-tree,
-	 * so we take the first task from that tree,
-	 * not the next task enqueued
+	 * catch the earliest deadline pushable task, none
+	 * if all the waiting ones already failed to be pushed
 	 */
-	node = rq_heap_peek_next(task_compare, &this_rq->heap);
-	if (!node){
-#ifdef DEBUG
-		fprintf(this_rq->log, "[%d] ERROR: runqueue is overloaded but rq_heap_peek_next returns NULL\n", this_rq->cpu);
-		rq_print(this_rq, this_rq->log);
-		exit(-1);
-#endif
+	next_task = pick_next_pushable_task(this_rq);
+	if (!next_task)
 		return 0;
-	}
-	next_task = rq_heap_node_value(node);
 
 retry:
-	node = rq_heap_peek(task_compare, &this_rq->heap);
-	if (next_task == rq_heap_node_value(node)) {
+	if (next_task == rq_queue_peek(&this_rq->queue)) {
 #ifdef DEBUG
 		fprintf(this_rq->log, "[%d] WARNING: next_task = min_task inside push\n", this_rq->cpu);
 #endif
@@ -991,21 +1035,16 @@ retry:
 		 * releases rq->lock, then it is possible that next_task
 		 * has migrated
 		 */
-		node = rq_heap_peek_next(task_compare, &this_rq->heap);
-		task = rq_heap_node_value(node);
+		task = pick_next_pushable_task(this_rq);
 		if (task == next_task) {
 			/*
-			 * The task is still there, we don't try
-			 * again.
-			 */
-			/*
-			 * in Linux:
-			 * 1) dequeue_pushable_task()
-			 * 2) goto out
-			 * since here we have no pushable task RB-tree,
-			 * we simply stop to push and return 0
+			 * The task is still there: nobody wants it,
+			 * so it is not pushable until it runs again
+			 * and the next push tries the next candidate
+			 * (Linux stops pushing here)
 			 */
-			return 0;
+			dequeue_pushable_task(this_rq, next_task);
+			goto out;
 		}
 
 		/*
@@ -1022,8 +1061,7 @@ retry:
 	/*
 	 * migrate task
 	 */
-	node = rq_take_next(this_rq);
-	next_task = rq_heap_node_value(node);
+	__rq_take_next(this_rq, next_task);
 #ifdef SCHED_DEADLINE
 	add_task_rq(later_rq, next_task);
 #endif
@@ -1039,15 +1077,14 @@ retry:
 #ifdef SCHED_RT
 	rq_unlock(lowest_rq);
 #endif
-	free(node);
 
 out:
 	return 1;
 }
 
 /*
- * rq_push_tasks: keep pushing tasks as it
- * fails to move one. For performance measurements
+ * rq_push_tasks: keep pushing tasks until no
+ * pushable one is left. For performance measurements
  * purpose we account the number of successfully
  * pushed tasks.
  * @this_rq:	the runqueue we want to push task from
@@ -1056,13 +1093,207 @@ int rq_push_tasks(struct rq* this_rq)
 {
 	int push_count = 0;
 
-	/* Terminates as is fails to move a task */
+	/* Terminates as it runs out of pushable tasks */
 	while (rq_push_task(this_rq, &push_count))
 		;
 
 	return push_count;
 }
 
+#ifdef SCHED_DEADLINE
+/*
+ * Global EDF: a single runqueue shared by all the CPUs, under
+ * one lock and with no push or pull. The task running on a CPU
+ * sits in grq->curr, out of the queue, so that the running tasks
+ * are the M earliest ones and the queue holds those waiting.
+ */
+
+/**
+ * grq_init - initialize the global runqueue
+ * @grq:		the global runqueue
+ * @nproc:	number of CPUs sharing it
+ */
+void grq_init(struct global_rq *grq, int nproc)
+{
+	rq_queue_init(&grq->queue);
+	lock_init(&grq->lock);
+	grq->nready = 0;
+	grq->nproc = nproc;
+
+	grq->curr = calloc(nproc, sizeof(*grq->curr));
+	if(!grq->curr){
+		fprintf(stderr, "out of memory\n");
+		fflush(stderr);
+		exit(-1);
+	}
+}
+
+/*
+ * grq_destroy - destroy the global runqueue, freeing
+ * both the running and the waiting tasks
+ * @grq:		the global runqueue
+ */
+void grq_destroy(struct global_rq *grq)
+{
+	struct task_struct *task;
+	int cpu;
+
+	while((task = rq_queue_take(&grq->queue)))
+		free(task);
+	rq_queue_destroy(&grq->queue);
+	for(cpu = 0; cpu < grq->nproc; cpu++)
+		free(grq->curr[cpu]);
+	free(grq->curr);
+	lock_destroy(&grq->lock);
+}
+
+void grq_lock(struct global_rq *grq)
+{
+	lock_acquire(&grq->lock);
+}
+
+void grq_unlock(struct global_rq *grq)
+{
+	lock_release(&grq->lock);
+}
+
+/*
+ * grq_curr - return the task running on a CPU, NULL if idle
+ * @grq:		the global runqueue
+ * @cpu:		the CPU
+ */
+struct task_struct *grq_curr(struct global_rq *grq, int cpu)
+{
+	return grq->curr[cpu];
+}
+
+/*
+ * grq_enqueue - make a task wait in the global runqueue
+ * @grq:				the global runqueue
+ * @this_cpu:		the calling CPU, for the probes
+ * @task:				the task
+ */
+static void grq_enqueue(struct global_rq *grq, int this_cpu, struct task_struct *task)
+{
+#ifdef MEASURE_ENQUEUE_CYCLE
+	MEASURE_START(enqueue_cycle, this_cpu)
+#endif
+
+	rq_queue_insert(&grq->queue, &task->node);
+	grq->nready++;
+#ifdef MEASURE_ENQUEUE_NUMBER
+	MEASURE_ACCOUNT_EVENT(enqueue_number, this_cpu)
+#endif
+
+#ifdef MEASURE_ENQUEUE_CYCLE
+	MEASURE_END(enqueue_cycle, this_cpu)
+#endif
+}
+
+/*
+ * grq_find_cpu - find where a new task should run: an idle CPU,
+ * the calling one first, or else the CPU running the latest
+ * deadline task, if it is later than the new one; return -1 if
+ * the task has to wait. This is what push find does with one
+ * runqueue per CPU, so it goes in the same probe
+ * @grq:				the global runqueue
+ * @this_cpu:		the calling CPU
+ * @task:				the new task
+ */
+static int grq_find_cpu(struct global_rq *grq, int this_cpu, struct task_struct *task)
+{
+	struct task_struct *curr;
+	int cpu, best_cpu = -1;
+
+#ifdef MEASURE_PUSH_FIND
+	MEASURE_START(push_find, this_cpu)
+#endif
+
+	if(!grq->curr[this_cpu])
+		best_cpu = this_cpu;
+	else
+		for(cpu = 0; cpu < grq->nproc; cpu++){
+			curr = grq->curr[cpu];
+			if(!curr){
+				best_cpu = cpu;
+				break;
+			}
+			if(best_cpu == -1 || __dl_time_after(curr->deadline, grq->curr[best_cpu]->deadline))
+				best_cpu = cpu;
+		}
+
+	if(best_cpu != -1 && grq->curr[best_cpu] &&
+			!__dl_time_before(task->deadline, grq->curr[best_cpu]->deadline))
+		best_cpu = -1;
+
+#ifdef MEASURE_PUSH_FIND
+	MEASURE_END(push_find, this_cpu)
+	REGISTER_OUTCOME(push_find, this_cpu, best_cpu, -1)
+#endif
+
+	return best_cpu;
+}
+
+/*
+ * grq_add_task - a new task arrives: it runs on an idle CPU or
+ * preempts the latest deadline one, else it waits; return the
+ * CPU where the task runs, -1 if it waits
+ * @grq:				the global runqueue
+ * @this_cpu:		the CPU where the task arrived
+ * @task:				the new task
+ * @preempted:	set if a running task has been preempted
+ */
+int grq_add_task(struct global_rq *grq, int this_cpu, struct task_struct *task, int *preempted)
+{
+	int cpu;
+
+	*preempted = 0;
+	cpu = grq_find_cpu(grq, this_cpu, task);
+	if(cpu == -1){
+		grq_enqueue(grq, this_cpu, task);
+		return -1;
+	}
+
+	if(grq->curr[cpu]){
+		grq_enqueue(grq, this_cpu, grq->curr[cpu]);
+		*preempted = 1;
+	}
+	grq->curr[cpu] = task;
+
+	return cpu;
+}
+
+/*
+ * grq_finish - the task running on a CPU finishes and the
+ * earliest waiting one takes its place; return 0 if the CPU
+ * becomes idle
+ * @grq:		the global runqueue
+ * @cpu:		the CPU
+ */
+int grq_finish(struct global_rq *grq, int cpu)
+{
+	free(grq->curr[cpu]);
+	grq->curr[cpu] = NULL;
+
+	if(rq_queue_empty(&grq->queue))
+		return 0;
+
+#ifdef MEASURE_DEQUEUE_CYCLE
+	MEASURE_START(dequeue_cycle, cpu)
+#endif
+	grq->curr[cpu] = rq_queue_take(&grq->queue);
+	grq->nready--;
+#ifdef MEASURE_DEQUEUE_NUMBER
+	MEASURE_ACCOUNT_EVENT(dequeue_number, cpu)
+#endif
+#ifdef MEASURE_DEQUEUE_CYCLE
+	MEASURE_END(dequeue_cycle, cpu)
+#endif
+
+	return 1;
+}
+#endif /* SCHED_DEADLINE */
+
 /**************************************
 *		Some useful debugging functions		*
 **************************************/
@@ -1082,36 +1313,15 @@ static void task_print(struct task_struct *task, FILE *out)
 #endif
 }
 
-/*
- * rq_heap_print_recursive - print recursively binomial heap nodes
- * @node:		a pointer to a heap node we want to print
- * @out:		output stream
- */
-static void rq_heap_print_recursive(struct rq_heap_node *node, FILE *out){
-	if(!node)
-		return;
-
-	/* print node value */
-	task_print((struct task_struct *)node->value, out);
-
-	if(!node->parent){			/* binomial tree root */
-		rq_heap_print_recursive(node->child, out);
-		rq_heap_print_recursive(node->next, out);
-	}else{
-		rq_heap_print_recursive(node->next, out);
-		rq_heap_print_recursive(node->child, out);
-	}
-}
-
 /*
  * rq_check - check runqueue correctness
  * @rq:		the runqueue we want to check
  */
 int rq_check(struct rq *rq){
-	struct rq_heap *rq_to_check;
-	struct rq_heap rq_backup;
-	struct rq_heap_node *min, *next, *node;
-	int flag = 1;
+	struct rq_queue *rq_to_check;
+	struct rq_queue rq_backup;
+	struct task_struct *min, *next, *task;
+	int flag = 1, pushable = 0;
 
 	if(!rq)
 		return 0;
@@ -1131,15 +1341,15 @@ int rq_check(struct rq *rq){
 	if(rq->nrunning < 2 && rq->overloaded)
 		flag = 0;
 
-	rq_to_check = &rq->heap;
+	rq_to_check = &rq->queue;
 
 #ifdef SCHED_DEADLINE
-	if(!rq->earliest && !rq->next && !rq_heap_empty(rq_to_check))
+	if(!rq->earliest && !rq->next && !rq_queue_empty(rq_to_check))
 		flag = 0;
 #endif
 
 #ifdef SCHED_RT
-	if(!rq->highest && !rq->next && !rq_heap_empty(rq_to_check))
+	if(!rq->highest && !rq->next && !rq_queue_empty(rq_to_check))
 		flag = 0;
 #endif
 
@@ -1147,31 +1357,43 @@ int rq_check(struct rq *rq){
 	 * initialize a backup runqueue where
 	 * we save extracted node
 	 */
-	rq_heap_init(&rq_backup);
+	rq_queue_init(&rq_backup);
 
-	next = rq_heap_take_next(task_compare, rq_to_check);
-	min = rq_heap_take(task_compare, rq_to_check);
+	next = rq_queue_take_next(rq_to_check);
+	min = rq_queue_take(rq_to_check);
 
 	if(min && next && task_compare(next, min))
 		flag = 0;
-	if(!min && !next && (!rq_heap_empty(rq_to_check)))
+	if(!min && !next && (!rq_queue_empty(rq_to_check)))
+		flag = 0;
+	/* the running task is never pushable */
+	if(min && min->pushable)
 		flag = 0;
+	if(next && next->pushable)
+		pushable++;
 
 	if(min)
-		rq_heap_insert(task_compare, &rq_backup, min);
+		rq_queue_insert(&rq_backup, &min->node);
 	if(next)
-		rq_heap_insert(task_compare, &rq_backup, next);
+		rq_queue_insert(&rq_backup, &next->node);
 
-	while((node = rq_heap_take(task_compare, rq_to_check))){
-		if(task_compare(node, min) ||	task_compare(node, next))
+	while((task = rq_queue_take(rq_to_check))){
+		if(task_compare(task, min) ||	task_compare(task, next))
 			flag = 0;
+		if(task->pushable)
+			pushable++;
 
-		rq_heap_insert(task_compare, &rq_backup, node);
+		rq_queue_insert(&rq_backup, &task->node);
 	}
 
+	/* every pushable task is queued */
+	if(pushable != rq->nr_pushable)
+		flag = 0;
+
 	/* restore checked runqueue */
-	while((node = rq_heap_take(task_compare, &rq_backup)))
-		rq_heap_insert(task_compare, rq_to_check, node);
+	while((task = rq_queue_take(&rq_backup)))
+		rq_queue_insert(rq_to_check, &task->node);
+	rq_queue_destroy(&rq_backup);
 
 	return flag;
 }
@@ -1182,6 +1404,8 @@ int rq_check(struct rq *rq){
  * @out:				output stream
  */
 void rq_print(struct rq *this_rq, FILE *out){
+	struct task_struct *task;
+
 	if(!this_rq)
 		return;
 
@@ -1197,17 +1421,94 @@ void rq_print(struct rq *this_rq, FILE *out){
 	fprintf(out, "cached value --> highest: %d, next: %d\n", this_rq->highest, this_rq->next);
 #endif
 
-	if(this_rq->heap.min){
-		fprintf(out, "min cached node:\n");
-		task_print((struct task_struct *)this_rq->heap.min->value, out);
+	if((task = rq_queue_peek(&this_rq->queue))){
+		fprintf(out, "min node:\n");
+		task_print(task, out);
 	}
-	if(this_rq->heap.next){
-		fprintf(out, "next cached node:\n");
-		task_print((struct task_struct *)this_rq->heap.next->value, out);
+	if((task = rq_queue_peek_next(&this_rq->queue))){
+		fprintf(out, "next node:\n");
+		task_print(task, out);
 	}
 	
-	fprintf(out, "nodes in binomial heap:\n");
-	rq_heap_print_recursive(this_rq->heap.head, out);
+	fprintf(out, "nodes in %s queue:\n", rq_queue_name());
+	rq_queue_for_each(&this_rq->queue, task_print, out);
+
+	fprintf(out, "pushable nodes: %d\n", this_rq->nr_pushable);
+	rq_queue_for_each(&this_rq->pushable, task_print, out);
 
 	fprintf(out, "----end runqueue %d----\n\n", this_rq->cpu);
 }
+
+#ifdef SCHED_DEADLINE
+/*
+ * grq_check - check global runqueue correctness: waiting tasks
+ * are in deadline order and none of them is earlier than a
+ * running one or waits while a CPU is idle
+ * @grq:		the global runqueue
+ */
+int grq_check(struct global_rq *grq)
+{
+	struct rq_queue rq_backup;
+	struct task_struct *task, *prev = NULL, *latest = NULL;
+	int cpu, idle = 0, count = 0, flag = 1;
+
+	for(cpu = 0; cpu < grq->nproc; cpu++){
+		task = grq->curr[cpu];
+		if(!task)
+			idle = 1;
+		else if(!latest || __dl_time_after(task->deadline, latest->deadline))
+			latest = task;
+	}
+
+	rq_queue_init(&rq_backup);
+
+	while((task = rq_queue_take(&grq->queue))){
+		if(prev && task_compare(task, prev))
+			flag = 0;
+		if(latest && __dl_time_before(task->deadline, latest->deadline))
+			flag = 0;
+		count++;
+
+		rq_queue_insert(&rq_backup, &task->node);
+		prev = task;
+	}
+
+	if(count != grq->nready || (count && idle))
+		flag = 0;
+
+	/* restore checked runqueue */
+	while((task = rq_queue_take(&rq_backup)))
+		rq_queue_insert(&grq->queue, &task->node);
+	rq_queue_destroy(&rq_backup);
+
+	return flag;
+}
+
+/*
+ * grq_print - print current global runqueue state
+ * @grq:		the global runqueue
+ * @out:		output stream
+ */
+void grq_print(struct global_rq *grq, FILE *out)
+{
+	int cpu;
+
+	fprintf(out, "\n");
+
+	fprintf(out, "----global runqueue----\n");
+
+	fprintf(out, "nready: %d\n", grq->nready);
+	for(cpu = 0; cpu < grq->nproc; cpu++){
+		fprintf(out, "cpu %d runs:\n", cpu);
+		if(grq->curr[cpu])
+			task_print(grq->curr[cpu], out);
+		else
+			fprintf(out, "\tidle\n");
+	}
+
+	fprintf(out, "nodes in %s queue:\n", rq_queue_name());
+	rq_queue_for_each(&grq->queue, task_print, out);
+
+	fprintf(out, "----end global runqueue----\n\n");
+}
+#endif /* SCHED_DEADLINE */
@@ -0,0 +1,463 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This code is adapted for use inside PRAcTISE from the Linux Kernel
+ * (kernel/sched/cpudeadline.c).
+ * You can find the Linux source code here http://www.kernel.org/
+ *
+ * Linux is a registered trademark of Linus Torvalds
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "cpudl.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+static inline int parent(int i)
+{
+	return (i - 1) >> 1;
+}
+
+static inline int left_child(int i)
+{
+	return (i << 1) + 1;
+}
+
+static inline int right_child(int i)
+{
+	return (i << 1) + 2;
+}
+
+static inline void free_cpus_set(cpudl_t *cp, int cpu)
+{
+	if (cp->free_cpus)
+		__sync_fetch_and_or(&cp->free_cpus[cpu / BITS_PER_LONG_LONG],
+				1ULL << (cpu % BITS_PER_LONG_LONG));
+}
+
+static inline void free_cpus_clear(cpudl_t *cp, int cpu)
+{
+	if (cp->free_cpus)
+		__sync_fetch_and_and(&cp->free_cpus[cpu / BITS_PER_LONG_LONG],
+				~(1ULL << (cpu % BITS_PER_LONG_LONG)));
+}
+
+static inline int free_cpus_test(cpudl_t *cp, int cpu)
+{
+	return (cp->free_cpus[cpu / BITS_PER_LONG_LONG] >>
+			(cpu % BITS_PER_LONG_LONG)) & 1;
+}
+
+/*
+ * free_cpus_first - return the first idle CPU,
+ * -1 if every CPU has a deadline task
+ */
+static int free_cpus_first(cpudl_t *cp)
+{
+	int i, words = (cp->nproc + BITS_PER_LONG_LONG - 1) / BITS_PER_LONG_LONG;
+	unsigned long long word;
+
+	for (i = 0; i < words; i++) {
+		word = cp->free_cpus[i];
+		if (word)
+			return i * BITS_PER_LONG_LONG + __builtin_ctzll(word);
+	}
+
+	return -1;
+}
+
+static void cpudl_heapify_down(cpudl_t *cp, int idx)
+{
+	int l, r, largest;
+	int orig_cpu = cp->elements[idx].cpu;
+	__u64 orig_dl = cp->elements[idx].dl;
+
+	if (left_child(idx) >= cp->size)
+		return;
+
+	/* adapted from lib/prio_heap.c */
+	while (1) {
+		__u64 largest_dl;
+
+		l = left_child(idx);
+		r = right_child(idx);
+		largest = idx;
+		largest_dl = orig_dl;
+
+		if ((l < cp->size) && cp->cmp_dl(orig_dl,
+					cp->elements[l].dl)) {
+			largest = l;
+			largest_dl = cp->elements[l].dl;
+		}
+		if ((r < cp->size) && cp->cmp_dl(largest_dl,
+					cp->elements[r].dl))
+			largest = r;
+
+		if (largest == idx)
+			break;
+
+		/* pull largest child onto idx */
+		cp->elements[idx].cpu = cp->elements[largest].cpu;
+		cp->elements[idx].dl = cp->elements[largest].dl;
+		cp->elements[cp->elements[idx].cpu].idx = idx;
+		idx = largest;
+	}
+	/* actual push down of saved original values orig_* */
+	cp->elements[idx].cpu = orig_cpu;
+	cp->elements[idx].dl = orig_dl;
+	cp->elements[cp->elements[idx].cpu].idx = idx;
+}
+
+static void cpudl_heapify_up(cpudl_t *cp, int idx)
+{
+	int p;
+	int orig_cpu = cp->elements[idx].cpu;
+	__u64 orig_dl = cp->elements[idx].dl;
+
+	if (idx == 0)
+		return;
+
+	do {
+		p = parent(idx);
+		if (cp->cmp_dl(orig_dl, cp->elements[p].dl))
+			break;
+		/* pull parent onto idx */
+		cp->elements[idx].cpu = cp->elements[p].cpu;
+		cp->elements[idx].dl = cp->elements[p].dl;
+		cp->elements[cp->elements[idx].cpu].idx = idx;
+		idx = p;
+	} while (idx != 0);
+	/* actual push up of saved original values orig_* */
+	cp->elements[idx].cpu = orig_cpu;
+	cp->elements[idx].dl = orig_dl;
+	cp->elements[cp->elements[idx].cpu].idx = idx;
+}
+
+static void cpudl_heapify(cpudl_t *cp, int idx)
+{
+	if (idx > 0 && cp->cmp_dl(cp->elements[parent(idx)].dl,
+				cp->elements[idx].dl))
+		cpudl_heapify_up(cp, idx);
+	else
+		cpudl_heapify_down(cp, idx);
+}
+
+/*
+ * cpudl_init - initialize the cpudl structure
+ * @s:			the cpudl structure
+ * @nproc:	number of CPUs
+ * @cmp_dl:	deadline comparison, the CPU for which it is
+ * false against every other one stays on top of the heap
+ */
+void cpudl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int i;
+
+	lock_init(&cp->lock);
+	cp->size = 0;
+	cp->nproc = nproc;
+	cp->cmp_dl = cmp_dl;
+
+	cp->elements = (cpudl_item *)calloc(nproc, sizeof(*cp->elements));
+	if (!cp->elements) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+	for (i = 0; i < nproc; i++)
+		cp->elements[i].idx = IDX_INVALID;
+
+	/*
+	 * idle CPUs are the best target for a push,
+	 * but they have nothing to be pulled
+	 */
+	cp->free_cpus = NULL;
+	if (cmp_dl == __dl_time_before) {
+		cp->free_cpus = (unsigned long long *)calloc((nproc + BITS_PER_LONG_LONG - 1) / BITS_PER_LONG_LONG,
+				sizeof(*cp->free_cpus));
+		if (!cp->free_cpus) {
+			fprintf(stderr, "calloc(): %s\n", strerror(errno));
+			exit(-1);
+		}
+		for (i = 0; i < nproc; i++)
+			free_cpus_set(cp, i);
+	}
+}
+
+/*
+ * cpudl_cleanup - free the cpudl structure
+ * @s:			the cpudl structure
+ */
+void cpudl_cleanup(void *s)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+
+	lock_destroy(&cp->lock);
+	free(cp->free_cpus);
+	free(cp->elements);
+}
+
+/*
+ * cpudl_clear - remove a CPU from the cpudl max-heap
+ * @cp:		the cpudl max-heap context
+ * @cpu:	the target CPU
+ *
+ * Called with cp->lock held.
+ */
+static void cpudl_clear(cpudl_t *cp, int cpu)
+{
+	int old_idx, new_cpu;
+
+	old_idx = cp->elements[cpu].idx;
+	if (old_idx == IDX_INVALID) {
+		/*
+		 * Nothing to remove if old_idx was invalid.
+		 * This could happen if a rq_offline_dl is
+		 * called for a CPU without -dl tasks running.
+		 */
+	} else {
+		new_cpu = cp->elements[cp->size - 1].cpu;
+		cp->elements[old_idx].dl = cp->elements[cp->size - 1].dl;
+		cp->elements[old_idx].cpu = new_cpu;
+		cp->size--;
+		cp->elements[new_cpu].idx = old_idx;
+		cp->elements[cpu].idx = IDX_INVALID;
+		cpudl_heapify(cp, old_idx);
+
+		free_cpus_set(cp, cpu);
+	}
+}
+
+/*
+ * cpudl_set - update the cpudl max-heap
+ * @s:				the cpudl max-heap context
+ * @cpu:			the target CPU
+ * @dl:				the new earliest deadline for this CPU
+ * @is_valid:	0 if the CPU has no more deadline tasks
+ *
+ * Notes: assumes cpu_rq(cpu)->lock is locked
+ *
+ * Returns: -1 if the CPU is out of range, 0 otherwise
+ */
+int cpudl_set(void *s, int cpu, __u64 dl, int is_valid)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int old_idx;
+
+	if (cpu < 0 || cpu >= cp->nproc) {
+		fprintf(stderr, "WARNING: cpudl_set on CPU %d, only %d CPUs available\n",
+				cpu, cp->nproc);
+		return -1;
+	}
+
+	lock_acquire(&cp->lock);
+
+	if (!is_valid) {
+		cpudl_clear(cp, cpu);
+		lock_release(&cp->lock);
+		return 0;
+	}
+
+	old_idx = cp->elements[cpu].idx;
+	if (old_idx == IDX_INVALID) {
+		int new_idx = cp->size++;
+
+		cp->elements[new_idx].dl = dl;
+		cp->elements[new_idx].cpu = cpu;
+		cp->elements[cpu].idx = new_idx;
+		cpudl_heapify_up(cp, new_idx);
+		free_cpus_clear(cp, cpu);
+	} else {
+		cp->elements[old_idx].dl = dl;
+		cpudl_heapify(cp, old_idx);
+	}
+
+	lock_release(&cp->lock);
+
+	return 0;
+}
+
+/*
+ * cpudl_maximum - return the CPU on top of the heap
+ * @s:		the cpudl max-heap context
+ */
+int cpudl_maximum(void *s)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+
+	return cp->elements[0].cpu;
+}
+
+/*
+ * cpudl_find_dl - find the best CPU in the system, idle CPUs
+ * first, and store its deadline (0 if it is idle) in dline;
+ * return -1 if there isn't any
+ * @s:			the cpudl max-heap context
+ * @dline:	where to store the deadline of the CPU found
+ *
+ * As in Linux this doesn't take cp->lock: a stale answer is
+ * checked again by the caller once the runqueue is locked.
+ */
+int cpudl_find_dl(void *s, __u64 *dline)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int best_cpu;
+
+	*dline = 0;
+	if (cp->free_cpus) {
+		best_cpu = free_cpus_first(cp);
+		if (best_cpu != -1)
+			return best_cpu;
+	}
+
+	if (cp->size <= 0)
+		return -1;
+
+	best_cpu = cpudl_maximum(cp);
+	*dline = cp->elements[0].dl;
+
+	return best_cpu;
+}
+
+int cpudl_find(void *s)
+{
+	__u64 dline;
+
+	return cpudl_find_dl(s, &dline);
+}
+
+int cpudl_check(void *s, int nproc)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int i, idx, flag = 1;
+
+	lock_acquire(&cp->lock);
+
+	for (i = 0; i < cp->size; i++) {
+		/* heap property */
+		if (left_child(i) < cp->size && cp->cmp_dl(cp->elements[i].dl,
+				cp->elements[left_child(i)].dl)) {
+			printf("Node %d (deadline %llu) is out of order with"
+				" its left child (deadline %llu)\n", i,
+				cp->elements[i].dl, cp->elements[left_child(i)].dl);
+			flag = 0;
+			goto out;
+		}
+		if (right_child(i) < cp->size && cp->cmp_dl(cp->elements[i].dl,
+				cp->elements[right_child(i)].dl)) {
+			printf("Node %d (deadline %llu) is out of order with"
+				" its right child (deadline %llu)\n", i,
+				cp->elements[i].dl, cp->elements[right_child(i)].dl);
+			flag = 0;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nproc; i++) {
+		idx = cp->elements[i].idx;
+		/* CPU to position mapping */
+		if (idx != IDX_INVALID && (idx >= cp->size ||
+				cp->elements[idx].cpu != i)) {
+			printf("CPU %d is wrongly registered at position %d!\n",
+				i, idx);
+			flag = 0;
+			goto out;
+		}
+		/* idle CPUs mask */
+		if (cp->free_cpus && free_cpus_test(cp, i) != (idx == IDX_INVALID)) {
+			printf("CPU %d free_cpus bit doesn't match its"
+				" position %d!\n", i, idx);
+			flag = 0;
+			goto out;
+		}
+	}
+
+out:
+	lock_release(&cp->lock);
+	if (!flag)
+		cpudl_print(s, nproc);
+
+	return flag;
+}
+
+int cpudl_check_cpu(void *s, int cpu, __u64 dline)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int idx, flag;
+
+	lock_acquire(&cp->lock);
+	idx = cp->elements[cpu].idx;
+	if (!dline)
+		flag = idx == IDX_INVALID;
+	else
+		flag = idx != IDX_INVALID && cp->elements[idx].dl == dline;
+	lock_release(&cp->lock);
+
+	return flag;
+}
+
+void cpudl_save(void *s, int nproc, FILE *f)
+{
+	cpudl_t *cp = (cpudl_t *)s;
+	int i;
+
+	lock_acquire(&cp->lock);
+	fprintf(f, "Heap (%d elements):\n", cp->size);
+	fprintf(f, "[ ");
+	for (i = 0; i < cp->size; i++)
+		fprintf(f, "(%d, %llu) ", cp->elements[i].cpu, cp->elements[i].dl);
+	fprintf(f, "] ");
+	fprintf(f, "Cpu_to_idx:");
+	for (i = 0; i < nproc; i++)
+		fprintf(f, " %d", cp->elements[i].idx);
+	if (cp->free_cpus) {
+		fprintf(f, " Free_cpus:");
+		for (i = 0; i < nproc; i++)
+			if (free_cpus_test(cp, i))
+				fprintf(f, " %d", i);
+	}
+	fprintf(f, "\n");
+	lock_release(&cp->lock);
+}
+
+void cpudl_print(void *s, int nproc)
+{
+	cpudl_save(s, nproc, stdout);
+}
+
+const struct data_struct_ops cpudl_ops = {
+	.data_init = cpudl_init,
+	.data_cleanup = cpudl_cleanup,
+	.data_preempt = cpudl_set,
+	.data_finish = cpudl_set,
+	.data_find = cpudl_find,
+	.data_find_dl = cpudl_find_dl,
+	.data_max = cpudl_maximum,
+	.data_save = cpudl_save,
+	.data_check = cpudl_check,
+	.data_print = cpudl_print,
+	.data_check_cpu = cpudl_check_cpu
+};
@@ -0,0 +1,382 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Delegation backend: a server thread owns the chosen backend, for
+ * both the push and the pull data structures, and nobody else ever
+ * touches it. A CPU posts its update in its own request line and
+ * polls its own response line, so the only lines moving between
+ * caches are those two; the backend stays in the server cache.
+ *
+ * The server sweeps the request lines, applies what it finds, then
+ * publishes the result of a find under a sequence counter and only
+ * after that answers the batch: finds read the snapshot without
+ * posting anything, and a CPU always finds its own last update in
+ * it. Checks and saves from the checker go through a control slot,
+ * so they run in the server too.
+ *
+ * Unlike flat combining, delegation gives up a CPU: the server is
+ * pinned to CPU nproc, the first one the simulation doesn't use.
+ */
+
+/* CPU_SET() feature test macro */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "delegation.h"
+#include "common_ops.h"
+#include "locks.h"
+#include "parameters.h"
+
+static struct deleg_server {
+	pthread_t thread;
+	int running;
+	int stop;
+	/* -1 if the simulation uses every CPU */
+	int cpu;
+	int ninstances;
+	deleg_t *instances[DELEG_MAX_INSTANCES];
+} server;
+
+/*
+ * deleg_set_leaf - select the wrapped backend, to be
+ * called before deleg_init
+ * @s:		the delegation data structure
+ * @ops:	operations of the backend
+ * @size:	size of an instance of the backend
+ */
+void deleg_set_leaf(void *s, const struct data_struct_ops *ops, size_t size)
+{
+	deleg_t *d = (deleg_t *)s;
+
+	d->ops = ops;
+	d->size = size;
+}
+
+/*
+ * deleg_wait - one step of a wait loop: pause for the first
+ * DELEG_SPIN_MAX steps, then yield, so that a server or a client
+ * sharing its CPU with the one it waits for lets it run
+ * @spins:	steps done so far, zeroed when the wait starts
+ */
+static inline void deleg_wait(int *spins)
+{
+	if (*spins < DELEG_SPIN_MAX) {
+		(*spins)++;
+		cpu_relax();
+	} else
+		sched_yield();
+}
+
+/* server side */
+static void deleg_publish(deleg_t *d)
+{
+	__u64 dline = 0;
+	int cpu;
+
+	if (d->ops->data_find_dl)
+		cpu = d->ops->data_find_dl(d->leaf, &dline);
+	else
+		cpu = d->ops->data_find(d->leaf);
+
+	__atomic_store_n(&d->snap.seq, d->snap.seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->snap.cpu, cpu, __ATOMIC_RELAXED);
+	__atomic_store_n(&d->snap.dline, dline, __ATOMIC_RELAXED);
+	__atomic_store_n(&d->snap.seq, d->snap.seq + 1, __ATOMIC_RELEASE);
+}
+
+static int deleg_serve_ctl(deleg_t *d)
+{
+	struct deleg_ctl *ctl = &d->ctl;
+	unsigned long seq;
+
+	seq = __atomic_load_n(&ctl->seq, __ATOMIC_ACQUIRE);
+	if (seq == ctl->done)
+		return 0;
+
+	switch (ctl->op) {
+		case DELEG_CHECK:
+			ctl->ret = d->ops->data_check(d->leaf, ctl->nproc);
+			break;
+		case DELEG_CHECK_CPU:
+			ctl->ret = d->ops->data_check_cpu(d->leaf, ctl->cpu, ctl->dline);
+			break;
+		case DELEG_SAVE:
+			d->ops->data_save(d->leaf, ctl->nproc, ctl->f);
+			ctl->ret = 0;
+			break;
+	}
+	__atomic_store_n(&ctl->done, seq, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/* one sweep of the request lines, returns the requests served */
+static int deleg_serve(deleg_t *d)
+{
+	struct deleg_req *req;
+	unsigned long seq;
+	int cpu, n = 0, i;
+
+	for (cpu = 0; cpu < d->nproc; cpu++) {
+		req = &d->req[cpu];
+		seq = __atomic_load_n(&req->seq, __ATOMIC_ACQUIRE);
+		if ((seq & 1) || seq == d->served[cpu])
+			continue;
+
+		d->ops->data_preempt(d->leaf, cpu, req->dline, req->is_valid);
+		d->served[cpu] = seq;
+		d->batch[n++] = cpu;
+	}
+
+	if (n) {
+		deleg_publish(d);
+		for (i = 0; i < n; i++)
+			__atomic_store_n(&d->resp[d->batch[i]].seq,
+					d->served[d->batch[i]], __ATOMIC_RELEASE);
+		d->requests += n;
+		d->batches++;
+	}
+
+	return n + deleg_serve_ctl(d);
+}
+
+static void *deleg_server(void *arg)
+{
+	cpu_set_t mask;
+	int i, n, served, spins = 0;
+
+	if (server.cpu >= 0) {
+		CPU_ZERO(&mask);
+		CPU_SET(server.cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask))
+			fprintf(stderr, "WARNING: cannot set delegation server affinity!\n");
+	}
+
+	while (!__atomic_load_n(&server.stop, __ATOMIC_ACQUIRE)) {
+		n = __atomic_load_n(&server.ninstances, __ATOMIC_ACQUIRE);
+		for (i = 0, served = 0; i < n; i++)
+			served += deleg_serve(server.instances[i]);
+		if (served)
+			spins = 0;
+		else
+			deleg_wait(&spins);
+	}
+
+	return NULL;
+}
+
+void deleg_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	deleg_t *d = (deleg_t *)s;
+
+	d->leaf = calloc(1, d->size);
+	if (!d->leaf) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+	d->ops->data_init(d->leaf, nproc, cmp_dl);
+	d->nproc = nproc;
+
+	if (posix_memalign((void **)&d->req, 64, nproc * sizeof(*d->req)) ||
+			posix_memalign((void **)&d->resp, 64, nproc * sizeof(*d->resp))) {
+		fprintf(stderr, "posix_memalign(): cannot allocate request slots\n");
+		exit(-1);
+	}
+	memset(d->req, 0, nproc * sizeof(*d->req));
+	memset(d->resp, 0, nproc * sizeof(*d->resp));
+	d->served = (unsigned long *)calloc(nproc, sizeof(*d->served));
+	d->batch = (int *)calloc(nproc, sizeof(*d->batch));
+	if (!d->served || !d->batch) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+	lock_init(&d->ctl.lock);
+	/* finds issued before the first request see the empty backend */
+	deleg_publish(d);
+
+	if (server.ninstances == DELEG_MAX_INSTANCES) {
+		fprintf(stderr, "deleg_init(): more than %d delegated data structures\n",
+				DELEG_MAX_INSTANCES);
+		exit(-1);
+	}
+	server.instances[server.ninstances] = d;
+	__atomic_store_n(&server.ninstances, server.ninstances + 1, __ATOMIC_RELEASE);
+
+	if (!server.running) {
+		server.cpu = nproc < sysconf(_SC_NPROCESSORS_ONLN) ? nproc : -1;
+		if (pthread_create(&server.thread, 0, deleg_server, 0)) {
+			fprintf(stderr, "pthread_create(): cannot start delegation server\n");
+			exit(-1);
+		}
+		server.running = 1;
+	}
+}
+
+/*
+ * the first cleanup stops the server, the simulated
+ * CPUs are gone so no request is pending anymore
+ */
+void deleg_cleanup(void *s)
+{
+	deleg_t *d = (deleg_t *)s;
+
+	if (server.running) {
+		__atomic_store_n(&server.stop, 1, __ATOMIC_RELEASE);
+		pthread_join(server.thread, 0);
+		server.running = 0;
+	}
+
+	if (d->batches)
+		printf("Delegation: %llu requests served in %llu batches (%.2f per batch)\n",
+				d->requests, d->batches, (double)d->requests / d->batches);
+
+	lock_destroy(&d->ctl.lock);
+	free(d->req);
+	free(d->resp);
+	free(d->served);
+	free(d->batch);
+	d->ops->data_cleanup(d->leaf);
+	free(d->leaf);
+}
+
+/* client side */
+int deleg_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	deleg_t *d = (deleg_t *)s;
+	struct deleg_req *req = &d->req[cpu];
+	unsigned long seq;
+	int spins = 0;
+
+	/*
+	 * the runqueue lock holder is normally the only one posting,
+	 * but a CPU leaving the simulation detaches its node without
+	 * the lock: claim the slot once the last request has been
+	 * answered, an odd seq tells the server it is being written
+	 */
+	for (;;) {
+		seq = __atomic_load_n(&req->seq, __ATOMIC_ACQUIRE);
+		if (!(seq & 1) &&
+				__atomic_load_n(&d->resp[cpu].seq, __ATOMIC_ACQUIRE) == seq &&
+				__atomic_compare_exchange_n(&req->seq, &seq, seq + 1, 0,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+		deleg_wait(&spins);
+	}
+	req->dline = dline;
+	req->is_valid = is_valid;
+	seq += 2;
+	__atomic_store_n(&req->seq, seq, __ATOMIC_RELEASE);
+
+	spins = 0;
+	while (__atomic_load_n(&d->resp[cpu].seq, __ATOMIC_ACQUIRE) != seq)
+		deleg_wait(&spins);
+
+	return 0;
+}
+
+int deleg_find_dl(void *s, __u64 *dline)
+{
+	deleg_t *d = (deleg_t *)s;
+	unsigned int seq;
+	int cpu;
+
+	do {
+		seq = __atomic_load_n(&d->snap.seq, __ATOMIC_ACQUIRE);
+		cpu = __atomic_load_n(&d->snap.cpu, __ATOMIC_RELAXED);
+		*dline = __atomic_load_n(&d->snap.dline, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&d->snap.seq, __ATOMIC_RELAXED));
+
+	return cpu;
+}
+
+int deleg_find(void *s)
+{
+	__u64 dline;
+
+	return deleg_find_dl(s, &dline);
+}
+
+static int deleg_control(deleg_t *d, deleg_ctl_op_t op, int nproc, int cpu,
+		__u64 dline, FILE *f)
+{
+	struct deleg_ctl *ctl = &d->ctl;
+	unsigned long seq;
+	int ret, spins = 0;
+
+	lock_acquire(&ctl->lock);
+	ctl->op = op;
+	ctl->nproc = nproc;
+	ctl->cpu = cpu;
+	ctl->dline = dline;
+	ctl->f = f;
+	seq = ctl->seq + 1;
+	__atomic_store_n(&ctl->seq, seq, __ATOMIC_RELEASE);
+
+	while (__atomic_load_n(&ctl->done, __ATOMIC_ACQUIRE) != seq)
+		deleg_wait(&spins);
+	ret = ctl->ret;
+	lock_release(&ctl->lock);
+
+	return ret;
+}
+
+void deleg_save(void *s, int nproc, FILE *f)
+{
+	deleg_control((deleg_t *)s, DELEG_SAVE, nproc, 0, 0, f);
+}
+
+void deleg_print(void *s, int nproc)
+{
+	deleg_save(s, nproc, stdout);
+}
+
+int deleg_check(void *s, int nproc)
+{
+	return deleg_control((deleg_t *)s, DELEG_CHECK, nproc, 0, 0, NULL);
+}
+
+int deleg_check_cpu(void *s, int cpu, __u64 dline)
+{
+	return deleg_control((deleg_t *)s, DELEG_CHECK_CPU, 0, cpu, dline, NULL);
+}
+
+const struct data_struct_ops deleg_ops = {
+	.data_init = deleg_init,
+	.data_cleanup = deleg_cleanup,
+	.data_preempt = deleg_set,
+	.data_finish = deleg_set,
+	.data_find = deleg_find,
+	.data_find_dl = deleg_find_dl,
+	.data_max = deleg_find,
+	.data_save = deleg_save,
+	.data_print = deleg_print,
+	.data_check = deleg_check,
+	.data_check_cpu = deleg_check_cpu
+};
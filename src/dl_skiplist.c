@@ -19,9 +19,9 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <linux/types.h>
-#include <time.h>
 #include <pthread.h>
 
 #include "common_ops.h"
@@ -32,22 +32,41 @@
  */
 #define	MAX_LEVEL           8
 
-/*! \brief Probabilità sorteggio livello superiore nella skiplist
+/*! \brief Un nodo ogni 2^LEVEL_SHIFT sale di un livello
  */
-#define LEVEL_PROB_VALUE    0.20
+#define LEVEL_SHIFT         2
 
-/*! \brief Nodo di una doubly-linked skiplist */
+/*! \brief Massimo numero di nodi attraversati da uno spostamento parziale
+ */
+#define MOVE_STEPS          8
+
+/*! \brief Dimensione di una linea di cache
+ */
+#define CACHE_LINE          64
+
+/*! \brief Puntatori di un nodo su un livello */
+struct dl_sl_link{
+	struct dl_sl_node *next;
+	struct dl_sl_node *prev;
+};
+
+/*! \brief Nodo di una doubly-linked skiplist
+ *
+ * La deadline e i puntatori del livello 0 stanno nella prima
+ * linea di cache del nodo, i puntatori dei livelli superiori
+ * sono allocati solo fino all'altezza del nodo.
+ */
 struct dl_sl_node{
 	/*! \brief deadline del task */
 	__u64 dline;
-	/*! \brief Livello del nodo */
+	/*! \brief Livello del nodo, -1 se il nodo è fuori dalla skiplist */
 	int level;
-	/*! \brief Puntatori ai nodi successivi nei vari livelli */
-	struct dl_sl_node *next[MAX_LEVEL];
-	/*! \brief Puntatori ai nodi precedenti nei vari livelli */
-	struct dl_sl_node *prev[MAX_LEVEL];
 	/*! \brief Indice della runqueue associata al nodo */
 	unsigned int rq_idx;
+	/*! \brief Altezza del nodo, fissata all'inizializzazione */
+	int height;
+	/*! \brief Puntatori ai nodi successivi e precedenti nei vari livelli */
+	struct dl_sl_link links[];
 };
 
 /************************************
@@ -87,9 +106,9 @@ static inline __u64 dl_sl_detach(struct dl_sl *list, struct dl_sl_node *p){
 
 	/* sgancio del task dalla skip list */
 	for(i = 0; i <= p->level; i++){
-		p->prev[i]->next[i] = p->next[i];
-		if(p->next[i])	/* il nodo non è l'ultimo della lista */
-			p->next[i]->prev[i] = p->prev[i];
+		p->links[i].prev->links[i].next = p->links[i].next;
+		if(p->links[i].next)	/* il nodo non è l'ultimo della lista */
+			p->links[i].next->links[i].prev = p->links[i].prev;
 	}
 
 	/* 
@@ -97,7 +116,7 @@ static inline __u64 dl_sl_detach(struct dl_sl *list, struct dl_sl_node *p){
 	 * occorre un ciclo perchè tutti gli altri nodi potrebbero
 	 * stare a livelli < p->level - 1
 	 */
-	while(!list->head->next[list->level] && list->level > 0)
+	while(!list->head->links[list->level].next && list->level > 0)
 		list->level--;
 
 	/* si marca il nodo come sganciato dalla skiplist */
@@ -129,24 +148,56 @@ static __u64 dl_sl_remove_idx(struct dl_sl *list, const unsigned int rq_idx){
 	return dl_sl_detach(list, p);
 }
 
-/*! \brief Sorteggio del livello
+/*! \brief Altezza del nodo di indice idx
+ *
+ * I nodi sono esattamente uno per runqueue, quindi le altezze si possono
+ * assegnare una volta per tutte: il nodo idx raggiunge il livello k se
+ * idx + 1 è multiplo di 2^(k * LEVEL_SHIFT). Ogni livello contiene così
+ * un quarto dei nodi del livello inferiore, senza code dovute al sorteggio.
+ * \param [in] idx indice della runqueue associata al nodo
+ * \return altezza del nodo, al massimo MAX_LEVEL - 1
+ */
+static inline int dl_sl_height(unsigned int idx){
+	int height = __builtin_ctz(idx + 1) / LEVEL_SHIFT;
+
+	return height > MAX_LEVEL - 1 ? MAX_LEVEL - 1 : height;
+}
+
+/*! \brief Dimensione di un nodo di altezza height, multipla della linea di cache
+ */
+static inline size_t dl_sl_node_size(int height){
+	size_t size = sizeof(struct dl_sl_node) + (height + 1) * sizeof(struct dl_sl_link);
+
+	return (size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+/*! \brief Aggancia un nodo alla skiplist
  *
- * Sorteggio di un livello per un nuovo nodo. Il valore sorteggiato apparterrà
- * all'intervallo [0, max] oppure [0, MAX_LEVEL - 1] se max >= MAX_LEVEL.
- * \param [in, out] seed puntatore allo stato del generatore pseudo-random
- * \param [in] max massimo valore ammesso per il livello sorteggiato
- * \return livello sorteggiato
+ * Il nodo viene agganciato alla sua altezza, dopo i predecessori update[i]
+ * trovati dalla ricerca su ogni livello.
+ * \param [in] list puntatore alla skiplist
+ * \param [in] new_node nodo da agganciare
+ * \param [in] update predecessori del nodo su ogni livello
  */
-static inline unsigned int dl_sl_rand_level(unsigned int *seed, unsigned int max){
-	unsigned int level = 0;
+static inline void dl_sl_link(struct dl_sl *list, struct dl_sl_node *new_node, struct dl_sl_node **update){
+	unsigned int i;
 
-	/* max è limitato superiormente a MAX_LEVEL */
-	max = max > MAX_LEVEL - 1 ? MAX_LEVEL - 1 : max;
+	/* il nodo mantiene la sua altezza */
+	new_node->level = new_node->height;
 
-	while(rand_r(seed) > ((1 - LEVEL_PROB_VALUE) * RAND_MAX) && level < max)
-		level++;
+	/* il nuovo nodo aggiunge dei livelli */
+	while(new_node->level > list->level)
+		update[++list->level] = list->head;
 
-	return level;
+	/* inserimento */
+	for(i = 0; i <= new_node->level; i++){
+		new_node->links[i].next = update[i]->links[i].next;
+		update[i]->links[i].next = new_node;
+		new_node->links[i].prev = update[i];
+		/* se il nodo non è l'ultimo della lista occorre settare il campo prev[i] del nodo successivo */
+		if(new_node->links[i].next)
+			new_node->links[i].next->links[i].prev = new_node;
+	}
 }
 
 /*! \brief Inserisce il task t, associato alla runqueue rq_idx, nella skiplist list
@@ -161,11 +212,10 @@ static inline unsigned int dl_sl_rand_level(unsigned int *seed, unsigned int max
  * \return 0 in caso di successo, -1 altrimenti
  */
 static int dl_sl_insert(struct dl_sl *list, const unsigned int rq_idx, __u64 dline, int (*cmp_dl)(__u64 a, __u64 b)){
-	struct dl_sl_node *p;
+	struct dl_sl_node *p, *next;
 	struct dl_sl_node *update[MAX_LEVEL];
 	struct dl_sl_node *new_node;
 	int cmp_res, level;
-	unsigned int i, rand_level;	
 
 	new_node = list->rq_to_node[rq_idx];
 
@@ -180,39 +230,90 @@ static int dl_sl_insert(struct dl_sl *list, const unsigned int rq_idx, __u64 dli
 		update[level] = p;
 
 		/* siamo in fondo alla lista, si scende un livello */
-		if(!p->next[level]){
+		next = p->links[level].next;
+		if(!next){
 			level--;
 			continue;
 		}
 		
 		/* abbiamo un elemento davanti, lo confrontiamo con l'elemento da inserire */
-		cmp_res = cmp_dl(p->next[level]->dline, new_node->dline);
+		cmp_res = cmp_dl(next->dline, new_node->dline);
 		
-		if(cmp_res > 0)		/* se l'elemento esaminato è minore del nuovo si prosegue in orizzontale */
-			p = p->next[level];
-		else				/* altrimenti si scende un livello */
+		if(cmp_res > 0){	/* se l'elemento esaminato è minore del nuovo si prosegue in orizzontale */
+			p = next;
+			/* il prossimo confronto legge il successivo, lo si porta in cache */
+			__builtin_prefetch(p->links[level].next);
+		}else				/* altrimenti si scende un livello */
 			level--;
 	}
 
-	/* sorteggio del livello del nuovo nodo */
-	rand_level = dl_sl_rand_level(&list->seed, list->level + 1);
-	new_node->level = rand_level;
+	dl_sl_link(list, new_node, update);
 
-	/* il nuovo nodo aggiunge un livello */
-	if(rand_level > list->level)
-		update[++list->level] = list->head;
+	return 0;
+}
 
-	/* inserimento */
-	for(i = 0; i <= rand_level; i++){
-		new_node->next[i] = update[i]->next[i];
-		update[i]->next[i] = new_node;
-		new_node->prev[i] = update[i];
-		/* se il nodo non è l'ultimo della lista occorre settare il campo prev[i] del nodo successivo */
-		if(new_node->next[i])
-			new_node->next[i]->prev[i] = new_node;
+/*! \brief Aggiorna la deadline di un nodo già inserito nella skiplist
+ *
+ * Il caso più frequente è una deadline che avanza di poco: se il nodo resta
+ * in ordine rispetto ai vicini al livello 0 la chiave viene riscritta sul posto,
+ * senza toccare alcun puntatore.
+ * Altrimenti il nodo viene sganciato e la nuova posizione viene cercata partendo
+ * da quella vecchia, in avanti o all'indietro, sul livello più alto del nodo;
+ * da lì si scende come in una ricerca normale. Se la nuova posizione è più
+ * lontana di MOVE_STEPS nodi si ripiega su una ricerca dalla testa.
+ * \param [in] list puntatore alla skiplist
+ * \param [in] node nodo da aggiornare, deve essere nella skiplist
+ * \param [in] dline nuova deadline
+ */
+static void dl_sl_update(struct dl_sl *list, struct dl_sl_node *node, __u64 dline, int (*cmp_dl)(__u64 a, __u64 b)){
+	struct dl_sl_node *p, *prev, *next;
+	struct dl_sl_node *update[MAX_LEVEL];
+	int i, steps = 0, top = node->level;
+
+	/* l'ordine con i vicini è preservato, aggiornamento sul posto */
+	prev = node->links[0].prev;
+	next = node->links[0].next;
+	if((prev == list->head || !cmp_dl(dline, prev->dline)) &&
+			(!next || !cmp_dl(next->dline, dline))){
+		node->dline = dline;
+		return;
 	}
 
-	return 0;
+	/* spostamento parziale a partire dal predecessore sul livello più alto */
+	p = node->links[top].prev;
+	dl_sl_detach(list, node);
+	node->dline = dline;
+
+	if(p != list->head && cmp_dl(dline, p->dline)){
+		/* la deadline è indietreggiata */
+		while(p != list->head && cmp_dl(dline, p->dline)){
+			if(++steps > MOVE_STEPS)
+				goto full_search;
+			p = p->links[top].prev;
+		}
+	}else{
+		/* la deadline è avanzata */
+		while(p->links[top].next && cmp_dl(p->links[top].next->dline, dline)){
+			if(++steps > MOVE_STEPS)
+				goto full_search;
+			p = p->links[top].next;
+		}
+	}
+	update[top] = p;
+
+	/* discesa verso il livello 0 come nella ricerca dalla testa */
+	for(i = top - 1; i >= 0; i--){
+		p = update[i + 1];
+		while(p->links[i].next && cmp_dl(p->links[i].next->dline, dline))
+			p = p->links[i].next;
+		update[i] = p;
+	}
+
+	dl_sl_link(list, node, update);
+	return;
+
+full_search:
+	dl_sl_insert(list, node->rq_idx, dline, cmp_dl);
 }
 
 void dl_sl_init_load(struct dl_sl *list, int (*cmp_dl)(__u64 a, __u64 b)){
@@ -245,24 +346,40 @@ void dl_sl_init_load(struct dl_sl *list, int (*cmp_dl)(__u64 a, __u64 b)){
 void dl_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b)){
 	dl_skiplist_t *p = (dl_skiplist_t *)s;
 	unsigned int i = 0;
+	size_t size = 0;
+	char *node;
+	int err;
 
-	/* creazione skiplist e nodo di testa */
+	/* creazione skiplist e nodo di testa, alto MAX_LEVEL livelli */
 	p->list = (struct dl_sl *)calloc(sizeof(struct dl_sl), 1);
 	p->cmp_dl = cmp_dl;
-	p->list->head = (struct dl_sl_node *)calloc(sizeof(struct dl_sl_node), 1);
+	p->list->head = (struct dl_sl_node *)calloc(dl_sl_node_size(MAX_LEVEL - 1), 1);
 	p->list->head->rq_idx = -1;
-
-	/* salvataggio seme generatore pseudo-random */
-	p->list->seed = time(NULL);
+	p->list->head->height = MAX_LEVEL - 1;
 
 	/* creazione array di mapping */
 	p->list->rq_to_node = (struct dl_sl_node **)calloc(sizeof(struct dl_sl_node *), nproc);
 
-	/* preallocazione di nproc nodi e inizializzazione array mapping */
-	for(i = 0; i < nproc; i++){
-		p->list->rq_to_node[i] = (struct dl_sl_node *)calloc(sizeof(struct dl_sl_node), 1);
+	/* 
+	 * preallocazione di nproc nodi contigui, ognuno
+	 * allineato alla linea di cache, e inizializzazione
+	 * array mapping
+	 */
+	for(i = 0; i < nproc; i++)
+		size += dl_sl_node_size(dl_sl_height(i));
+	err = posix_memalign((void **)&p->list->nodes, CACHE_LINE, size);
+	if(err){
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(p->list->nodes, 0, size);
+
+	for(i = 0, node = p->list->nodes; i < nproc; i++){
+		p->list->rq_to_node[i] = (struct dl_sl_node *)node;
 		p->list->rq_to_node[i]->level = -1;
 		p->list->rq_to_node[i]->rq_idx = i;
+		p->list->rq_to_node[i]->height = dl_sl_height(i);
+		node += dl_sl_node_size(dl_sl_height(i));
 	}
 
 	/* salvataggio dimensione skiplist */
@@ -279,11 +396,9 @@ void dl_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b)){
 
 void dl_sl_cleanup(void *s){
 	dl_skiplist_t *p = (dl_skiplist_t *)s;
-	unsigned int i;
 
 	/* distruzione nodi skiplist */
-	for(i = 0; i < p->list->rq_num; i++)
-		free(p->list->rq_to_node[i]);
+	free(p->list->nodes);
 
 	/* distruzione nodo testa */
 	free(p->list->head);
@@ -303,9 +418,13 @@ int dl_sl_preempt(void *s, int cpu, __u64 dline, int is_valid){
 
 	pthread_rwlock_wrlock(&p->list->lock);
 
-	dl_sl_remove_idx(p->list, cpu);
-	if(is_valid)
-		dl_sl_insert(p->list, cpu, dline, p->cmp_dl);
+	if(is_valid && p->list->rq_to_node[cpu]->level >= 0)
+		dl_sl_update(p->list, p->list->rq_to_node[cpu], dline, p->cmp_dl);
+	else{
+		dl_sl_remove_idx(p->list, cpu);
+		if(is_valid)
+			dl_sl_insert(p->list, cpu, dline, p->cmp_dl);
+	}
 
 	pthread_rwlock_unlock(&p->list->lock);
 
@@ -339,12 +458,12 @@ int dl_sl_find(void *s){
 
 	/*
 	 * we don't need to take a lock:
-	 * if p->list->head->next[0] is not
+	 * if p->list->head->links[0].next is not
 	 * NULL, then we can fetch a node
 	 * address, and that node will not
 	 * be freed until the simulation ends.
 	 */ 
-	n = p->list->head->next[0];
+	n = p->list->head->links[0].next;
 	if(n)
 		cpu = n->rq_idx;
 
@@ -368,7 +487,7 @@ void dl_sl_save(void *s, int nproc, FILE *f){
 	/* lista nodi */
 	for(i = p->list->level; i >= 0; i--){
 		fprintf(f, "%u:\t", i);
-		for(node = p->list->head->next[i]; node; node = node->next[i])
+		for(node = p->list->head->links[i].next; node; node = node->links[i].next)
 			fprintf(f, "%llu ", node->dline);
 		fprintf(f, "\n");
 	}
@@ -401,13 +520,13 @@ int dl_sl_check(void *s, int nproc){
 
 	/* check numero livelli della skiplist */
 	for(i = 0; i < MAX_LEVEL; i++)
-		if(p->list->head->next[i] != NULL)
+		if(p->list->head->links[i].next != NULL)
 			max_level = i;
 	if(max_level != p->list->level){
 		fprintf(stderr, "errore numero livelli skiplist");
 		fprintf(stderr, "list->level: %u max_level: %u\n", p->list->level, max_level);
 		for(i = 0; i < MAX_LEVEL; i++)
-			printf("level %u: %p\n", i, p->list->head->next[i]);
+			printf("level %u: %p\n", i, p->list->head->links[i].next);
 		flag = 0;	
 	}
 
@@ -415,7 +534,7 @@ int dl_sl_check(void *s, int nproc){
 #if 0
 	node = p->list->head;
 	for(i = 0; node && i < p->list->rq_num; i++)
-		node = node->next[0];
+		node = node->links[0].next;
 	if(i != p->list->rq_num){
 		fprintf(stderr, "errore numero elementi skiplist");
 		flag = 0;
@@ -431,11 +550,11 @@ int dl_sl_check(void *s, int nproc){
 	/* forward check */
 	for(i = 0; i < p->list->level; i++){
 		/* lista vuota o con un solo elemento */
-		if(!(node = p->list->head->next[i]))
+		if(!(node = p->list->head->links[i].next))
 			continue;
 		
 		/* check */
-		while((next_node = node->next[i])){
+		while((next_node = node->links[i].next)){
 			if(p->cmp_dl(node->dline, next_node->dline) < 0)
 				flag = 0;
 			node = next_node;
@@ -445,15 +564,15 @@ int dl_sl_check(void *s, int nproc){
 	/* backward check */
 	for(i = 0; i < p->list->level; i++){
 		/* lista vuota o con un solo elemento */
-		if(!(node = p->list->head->next[i]))
+		if(!(node = p->list->head->links[i].next))
 			continue;
 
 		/* raggiungo ultimo nodo */
-		while(node->next[i])
-			node = node->next[i];
+		while(node->links[i].next)
+			node = node->links[i].next;
 			
 		/* check */
-		while((prev_node = node->prev[i])){
+		while((prev_node = node->links[i].prev)){
 			if(p->cmp_dl(prev_node->dline, node->dline) < 0)
 				flag = 0;
 			node = prev_node;
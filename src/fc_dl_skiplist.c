@@ -26,12 +26,9 @@
 
 #include "common_ops.h"
 #include "parameters.h"
-#include "flat_combining.h"
+#include "bm_flat_combining.h"
 #include "fc_dl_skiplist.h"
 
-/* Numero massimo di publication record per CPU */
-#define P_RECORD_PER_CPU		10
-
 /*! \brief Numero massimo di livelli della skiplist
  */
 #define	MAX_LEVEL           8
@@ -399,61 +396,29 @@ int old_fc_dl_sl_check_cpu (void *s, int cpu, __u64 dline){
 	return flag;
 }
 
-static void fc_dl_sl_do_combiner(fc_dl_skiplist_t *p){
-	pub_record *i;
-	int cpu, is_valid;
-	__u64 dline;
-
-	/* scansione publication list */
-	for(i = dequeue_all_publication_record(p->p_list); i; i = i->next){
-		/* evasione richiesta */
-		switch(i->req){
-			case PREEMPT:
-				cpu = i->par.preempt_p.cpu;
-				dline = i->par.preempt_p.dline;
-				is_valid = i->par.preempt_p.is_valid;
-				i->res.preempt_r.res = old_fc_dl_sl_preempt((void *)p, cpu, dline, is_valid);
-				break;
-		}
-
-		SET_READY(i);
-		/* FIXME: ??? */
-		/* 
-		 * attenzione: il publication record deve rimanere ACTIVE finchè non è stata
-		 * letta la risposta. Poichè in questa simulazione le risposte vengono scartate
-		 * lo poniamo inattivo qui.
-		 */
-		DEACTIVATE(i);
-		__sync_synchronize();
-	}
-
-}
-
-static void fc_dl_sl_wait_response(fc_dl_skiplist_t *p/*, pub_record *r*/){
-	if(!pthread_spin_trylock(&p->lock)){
-		fc_dl_sl_do_combiner(p);
-		pthread_spin_unlock(&p->lock);
-	}
+/*
+ * handler dei record PREEMPT, eseguito dal combiner con il lock
+ * della struttura dati acquisito. La coalescenza dei record di una
+ * stessa CPU è fatta dalla libreria: qui arriva solo l'ultimo.
+ */
+static void fc_dl_sl_dispatcher(void *s, int cpu, __u64 dline, int is_valid){
+	old_fc_dl_sl_preempt(s, cpu, dline, is_valid);
 }
 
 /*
- * restituisce un puntatore ad un publication record preallocato
- * se tutti i P_RECORD_PER_CPU sono utilizzati si attende l'evasione di una
- * richiesta che liberi un publication record
+ * eseguita dal combiner al termine di ogni passata che ha applicato
+ * aggiornamenti: il risultato è la fotografia letta da fc_dl_sl_find()
  */
-static pub_record *get_pub_record(fc_dl_skiplist_t *p, int cpu){
-	pub_record **array = p->p_record_array[cpu];
-	int idx = p->p_record_idx[cpu];
-
-	while(1){
-		if(!IS_ACTIVE(array[idx])){
-			ACTIVATE(array[idx]);
-			p->p_record_idx[cpu] = (p->p_record_idx[cpu] + 1) % P_RECORD_PER_CPU;
-			return array[idx];
-		}
-		/* nessun publication record libero: tento di diventare un combiner */
-		fc_dl_sl_wait_response(p);
-	}
+static int fc_dl_sl_snapshot(void *s, __u64 *dline){
+	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
+	int cpu;
+
+	*dline = 0;
+	cpu = old_fc_dl_sl_find(s);
+	if(cpu >= 0)
+		*dline = p->list->rq_to_node[cpu]->dline;
+
+	return cpu;
 }
 
 /************************************
@@ -476,7 +441,7 @@ static pub_record *get_pub_record(fc_dl_skiplist_t *p, int cpu){
 void fc_dl_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b)){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 	p->cmp_dl = cmp_dl;
-	unsigned int i, j;
+	unsigned int i;
 
 	/* creazione skiplist e nodo di testa */
 	p->list = (struct fc_dl_sl *)calloc(1, sizeof(*p->list));
@@ -503,30 +468,24 @@ void fc_dl_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b)){
 	fc_dl_sl_init_load(p->list, p->cmp_dl);
 #endif
 
-	/* inizializzazione lock */
-	pthread_spin_init(&p->lock, PTHREAD_PROCESS_SHARED);
-
-	/* creazione publication_list */
-	p->p_list = create_publication_list();
-
-	/* creazione publication records */
-	p->p_record_array = (pub_record ***)calloc(nproc, sizeof(*p->p_record_array));
-	for(i = 0; i < nproc; i++){
-		p->p_record_array[i] = (pub_record **)calloc(P_RECORD_PER_CPU, sizeof(*p->p_record_array[i]));
-		for(j = 0; j < P_RECORD_PER_CPU; j++)
-			p->p_record_array[i][j] = create_publication_record();
-		p->p_record_idx = (int *)calloc(nproc, sizeof(*p->p_record_idx));
-	}
+	/* creazione struttura flat combining */
+	p->fc = fc_create(p, nproc);
+	/* le find leggono l'ultima fotografia del combiner senza attenderlo */
+	fc_set_find(p->fc, fc_dl_sl_snapshot, 1);
 }
 
 void fc_dl_sl_cleanup(void *s){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
-	unsigned int i, j;
+	unsigned int i;
 
 	/* evasione richieste pendenti */
-	pthread_spin_lock(&p->lock);
-	fc_dl_sl_do_combiner(p);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_lock(p->fc);
+	fc_combine(p->fc);
+	fc_data_structure_unlock(p->fc);
+
+	fc_print_stats(p->fc, p->cmp_dl == __dl_time_after ?
+		"Flat combining skiplist (latest first)" :
+		"Flat combining skiplist (earliest first)", stdout);
 
 	/* distruzione nodi skiplist */
 	for(i = 0; i < p->list->rq_num; i++)
@@ -538,119 +497,77 @@ void fc_dl_sl_cleanup(void *s){
 	/* distruzione array di mapping */
 	free(p->list->rq_to_node);
 
-	/* distruzione lock */
-	pthread_spin_destroy(&p->lock);
-
-	/* distruzione publication records */
-	for(i = 0; i < p->list->rq_num; i++){
-		for(j = 0; j < P_RECORD_PER_CPU; j++)
-			destroy_publication_record(p->p_record_array[i][j]);
-		free(p->p_record_array[i]);
-	}
-	free(p->p_record_array);
-
 	/* distruzione skiplist */
 	free(p->list);
 
-	/* distruzione publication_list */
-	destroy_publication_list(p->p_list);
+	/* distruzione struttura flat combining */
+	fc_destroy(p->fc);
 }
 
 int fc_dl_sl_preempt(void *s, int cpu, __u64 dline, int is_valid){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
-	int res;
+	struct pub_record *rec;
 
 	/* creazione publication record */
-	pub_record *r = get_pub_record(p, cpu);
-	r->req = PREEMPT;
-	r->par.preempt_p.cpu = cpu;
-	r->par.preempt_p.dline = dline;
-	r->par.preempt_p.is_valid = is_valid;
-	UNSET_READY(r);
+	rec = fc_get_record(p->fc, cpu);
+	rec->req = PREEMPT;
+	rec->par.preempt_p.cpu = cpu;
+	rec->par.preempt_p.dline = dline;
+	rec->par.preempt_p.is_valid = is_valid;
+	rec->h.preempt_h.function = fc_dl_sl_dispatcher;
 
 	/* pubblicazione publication record */
-	enqueue_publication_record(p->p_list, r);
+	fc_publish_record(p->fc, cpu);
 
-	/* FIXME: non serve un'attesa, è un'operazione di modifica */
-	/* attesa evasione richiesta */
 	/* nessuna attesa: si tenta di diventare combiner, se non si riesce si ritorna */
-	fc_dl_sl_wait_response(p/*, r*/);
-
-	/* lettura risultato */
-	res = r->res.preempt_r.res;
+	fc_try_combiner(p->fc);
 
-	return res;
+	return 0;
 }
 
+/*
+ * la migliore CPU è quella trovata dal combiner al termine
+ * della sua ultima passata (vedi fc_dl_sl_snapshot())
+ */
 int fc_dl_sl_find(void *s){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
-	pub_record *rec;
-	__u64 candidate_dline = 0;
-	__u64 data_struct_dline = 0;
-	int candidate_cpu = -1;
-	int data_struct_cpu = -1;
-	
-	/* previsione migliore cpu dalla scansione lista */
-	rec = p->p_list->head;		/* lettura atomica (vedi old_dl_sl_find) */
-	while(rec){
-		/* il combiner thread potrebbe, nel frattempo, apportare le modifiche */
-		if(!IS_READY(rec))
-			switch(rec->req){
-				case PREEMPT:
-						if(candidate_cpu == -1 || p->cmp_dl(rec->par.preempt_p.dline, candidate_dline)){
-							candidate_cpu = rec->par.preempt_p.cpu;
-							candidate_dline = rec->par.preempt_p.dline;
-						}
-					break;
-			}
-		rec = rec->next;
-	}
-
-	/* lettura migliore cpu dalla struttura dati */
-	data_struct_cpu = old_fc_dl_sl_find(s);
-	if(data_struct_cpu >= 0)
-		data_struct_dline = p->list->rq_to_node[data_struct_cpu]->dline;
+	__u64 dline;
 
-	/* confronto */
-	if(candidate_dline > 0 && data_struct_dline > 0)
-		return p->cmp_dl(candidate_dline, data_struct_dline) ? candidate_cpu : data_struct_cpu;
-	if(candidate_dline > 0)
-		return candidate_cpu;
-	else
-		return data_struct_cpu;
+	return fc_find(p->fc, &dline);
 }
 
 void fc_dl_sl_load(void *s, FILE *f){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 
-	pthread_spin_lock(&p->lock);
+	fc_data_structure_lock(p->fc);
 	old_fc_dl_sl_load(s, f);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_unlock(p->fc);
 }
 
 void fc_dl_sl_save(void *s, int nproc, FILE *f){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 	
-	pthread_spin_lock(&p->lock);
+	fc_data_structure_lock(p->fc);
 	old_fc_dl_sl_save(s, f);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_unlock(p->fc);
 }
 
 void fc_dl_sl_print(void *s, int nproc){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 	
-	pthread_spin_lock(&p->lock);
+	fc_data_structure_lock(p->fc);
 	old_fc_dl_sl_print(s, nproc);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_unlock(p->fc);
 }
 
 int fc_dl_sl_check(void *s, int nproc){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 	int res;
 	
-	pthread_spin_lock(&p->lock);
+	fc_data_structure_lock(p->fc);
+	fc_combine(p->fc);
 	res = old_fc_dl_sl_check(s, nproc);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_unlock(p->fc);
 
 	return res;
 }
@@ -659,9 +576,10 @@ int fc_dl_sl_check_cpu(void *s, int cpu, __u64 dline){
 	fc_dl_skiplist_t *p = (fc_dl_skiplist_t *)s;
 	int res;
 	
-	pthread_spin_lock(&p->lock);
+	fc_data_structure_lock(p->fc);
+	fc_combine(p->fc);
 	res = old_fc_dl_sl_check_cpu(s, cpu, dline);
-	pthread_spin_unlock(&p->lock);
+	fc_data_structure_unlock(p->fc);
 
 	return res;
 }
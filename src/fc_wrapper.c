@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flat combining wrapper: the chosen backend is driven through
+ * the flat combining library. A CPU publishes its update and
+ * whoever gets the combiner lock applies the pending ones, so
+ * the backend needs no synchronization of its own and its cache
+ * lines stay with the combiner. Finds are combined too, one call
+ * of the backend find serves all the finds pending in a pass, or
+ * with FC_READ_SNAPSHOT return what the last pass found.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/types.h>
+
+#include "fc_wrapper.h"
+#include "bm_flat_combining.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+/*
+ * fcw_set_leaf - select the wrapped backend, to be
+ * called before fcw_init
+ * @s:		the wrapper
+ * @ops:	operations of the backend
+ * @size:	size of an instance of the backend
+ */
+void fcw_set_leaf(void *s, const struct data_struct_ops *ops, size_t size)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	w->ops = ops;
+	w->size = size;
+}
+
+/* combiner side handlers, called with the combiner lock held */
+static void fcw_apply(void *s, int cpu, __u64 dline, int is_valid)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	w->ops->data_preempt(w->leaf, cpu, dline, is_valid);
+}
+
+static int fcw_leaf_find(void *s, __u64 *dline)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	*dline = 0;
+	if (w->ops->data_find_dl)
+		return w->ops->data_find_dl(w->leaf, dline);
+
+	return w->ops->data_find(w->leaf);
+}
+
+void fcw_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	fcw_t *w = (fcw_t *)s;
+	int snapshot = 0;
+
+	w->leaf = calloc(1, w->size);
+	if (!w->leaf) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+	w->ops->data_init(w->leaf, nproc, cmp_dl);
+
+#ifdef FC_READ_SNAPSHOT
+	snapshot = 1;
+#endif
+	w->fc = fc_create(w, nproc);
+	fc_set_find(w->fc, fcw_leaf_find, snapshot);
+}
+
+void fcw_cleanup(void *s)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	fc_print_stats(w->fc, "Flat combining wrapper", stdout);
+	fc_destroy(w->fc);
+	w->ops->data_cleanup(w->leaf);
+	free(w->leaf);
+}
+
+int fcw_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	fcw_t *w = (fcw_t *)s;
+	struct pub_record *rec;
+
+	rec = fc_get_record(w->fc, cpu);
+	rec->req = PREEMPT;
+	rec->par.preempt_p.cpu = cpu;
+	rec->par.preempt_p.dline = dline;
+	rec->par.preempt_p.is_valid = is_valid;
+	rec->h.preempt_h.function = fcw_apply;
+	fc_publish_record(w->fc, cpu);
+
+	fc_try_combiner(w->fc);
+
+	return 0;
+}
+
+int fcw_find_dl(void *s, __u64 *dline)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	return fc_find(w->fc, dline);
+}
+
+int fcw_find(void *s)
+{
+	__u64 dline;
+
+	return fcw_find_dl(s, &dline);
+}
+
+/*
+ * save and checks apply the pending updates first: the
+ * checker holds every runqueue lock, so nothing else can
+ * be published meanwhile
+ */
+void fcw_save(void *s, int nproc, FILE *f)
+{
+	fcw_t *w = (fcw_t *)s;
+
+	fc_data_structure_lock(w->fc);
+	fc_combine(w->fc);
+	w->ops->data_save(w->leaf, nproc, f);
+	fc_data_structure_unlock(w->fc);
+}
+
+void fcw_print(void *s, int nproc)
+{
+	fcw_save(s, nproc, stdout);
+}
+
+int fcw_check(void *s, int nproc)
+{
+	fcw_t *w = (fcw_t *)s;
+	int ret;
+
+	fc_data_structure_lock(w->fc);
+	fc_combine(w->fc);
+	ret = w->ops->data_check(w->leaf, nproc);
+	fc_data_structure_unlock(w->fc);
+
+	return ret;
+}
+
+int fcw_check_cpu(void *s, int cpu, __u64 dline)
+{
+	fcw_t *w = (fcw_t *)s;
+	int ret;
+
+	fc_data_structure_lock(w->fc);
+	fc_combine(w->fc);
+	ret = w->ops->data_check_cpu(w->leaf, cpu, dline);
+	fc_data_structure_unlock(w->fc);
+
+	return ret;
+}
+
+const struct data_struct_ops fcw_ops = {
+	.data_init = fcw_init,
+	.data_cleanup = fcw_cleanup,
+	.data_preempt = fcw_set,
+	.data_finish = fcw_set,
+	.data_find = fcw_find,
+	.data_find_dl = fcw_find_dl,
+	.data_max = fcw_find,
+	.data_save = fcw_save,
+	.data_print = fcw_print,
+	.data_check = fcw_check,
+	.data_check_cpu = fcw_check_cpu
+};
@@ -0,0 +1,291 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flat array backend: every CPU stores its key with a plain atomic
+ * store in its own slot, no lock and no retry. Find scans the whole
+ * array with an AVX-512 or AVX2 min reduction that carries the index
+ * of the winner along, selected at init time according to what the
+ * CPU supports; a scalar loop is the fallback.
+ *
+ * Deadlines are compared as plain unsigned numbers (no wraparound
+ * handling as in __dl_time_before), which holds for simulated ones.
+ * The key is dline, or ~dline when the latest deadline wins, with the
+ * sign bit flipped so that signed compares (all AVX2 has for 64 bit
+ * integers) give the unsigned order. Aligned 8 byte lanes are read
+ * atomically by vector loads, a scan sees every key either before or
+ * after a concurrent store.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <immintrin.h>
+#include <linux/types.h>
+
+#include "flat_array.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+#define FA_SIGN			(1ULL << 63)
+/* ~0 encoded, loses against every deadline */
+#define FA_EMPTY		((__s64)(~0ULL ^ FA_SIGN))
+
+static inline __s64 fa_encode(flat_array_t *a, __u64 dline)
+{
+	return (__s64)((a->latest ? ~dline : dline) ^ FA_SIGN);
+}
+
+static inline __u64 fa_decode(flat_array_t *a, __s64 key)
+{
+	__u64 dline = (__u64)key ^ FA_SIGN;
+
+	return a->latest ? ~dline : dline;
+}
+
+/*
+ * fa_scan_* - return the index of the smallest
+ * key, -1 if every slot is empty
+ * @keys:	the keys array, 64 byte aligned
+ * @len:	its length, a multiple of FA_STRIDE
+ */
+static int fa_scan_scalar(const __s64 *keys, int len)
+{
+	__s64 min = FA_EMPTY, key;
+	int i, idx = -1;
+
+	for (i = 0; i < len; i++) {
+		key = __atomic_load_n(&keys[i], __ATOMIC_RELAXED);
+		if (key < min) {
+			min = key;
+			idx = i;
+		}
+	}
+
+	return idx;
+}
+
+__attribute__((target("avx2")))
+static int fa_scan_avx2(const __s64 *keys, int len)
+{
+	__m256i vmin = _mm256_set1_epi64x(FA_EMPTY);
+	__m256i vidx = _mm256_set1_epi64x(-1);
+	__m256i cur = _mm256_set_epi64x(3, 2, 1, 0);
+	__m256i four = _mm256_set1_epi64x(4);
+	__m256i v, lt;
+	__s64 mins[4], idxs[4], min;
+	int i, idx;
+
+	for (i = 0; i < len; i += 4) {
+		v = _mm256_load_si256((const __m256i *)&keys[i]);
+		lt = _mm256_cmpgt_epi64(vmin, v);
+		vmin = _mm256_blendv_epi8(vmin, v, lt);
+		vidx = _mm256_blendv_epi8(vidx, cur, lt);
+		cur = _mm256_add_epi64(cur, four);
+	}
+
+	_mm256_storeu_si256((__m256i *)mins, vmin);
+	_mm256_storeu_si256((__m256i *)idxs, vidx);
+	min = mins[0];
+	idx = idxs[0];
+	for (i = 1; i < 4; i++)
+		if (mins[i] < min || (mins[i] == min && idxs[i] < idx)) {
+			min = mins[i];
+			idx = idxs[i];
+		}
+
+	return min == FA_EMPTY ? -1 : idx;
+}
+
+__attribute__((target("avx512f")))
+static int fa_scan_avx512(const __s64 *keys, int len)
+{
+	__m512i vmin = _mm512_set1_epi64(FA_EMPTY);
+	__m512i vidx = _mm512_set1_epi64(-1);
+	__m512i cur = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+	__m512i eight = _mm512_set1_epi64(8);
+	__m512i v;
+	__mmask8 lt;
+	__s64 min;
+	int i;
+
+	for (i = 0; i < len; i += 8) {
+		v = _mm512_load_si512((const void *)&keys[i]);
+		lt = _mm512_cmplt_epi64_mask(v, vmin);
+		vmin = _mm512_mask_blend_epi64(lt, vmin, v);
+		vidx = _mm512_mask_blend_epi64(lt, vidx, cur);
+		cur = _mm512_add_epi64(cur, eight);
+	}
+
+	min = _mm512_reduce_min_epi64(vmin);
+	if (min == FA_EMPTY)
+		return -1;
+
+	/* lowest index among the lanes holding the minimum */
+	lt = _mm512_cmpeq_epi64_mask(vmin, _mm512_set1_epi64(min));
+	vidx = _mm512_mask_blend_epi64(lt, _mm512_set1_epi64(0x7fffffffffffffffLL), vidx);
+
+	return (int)_mm512_reduce_min_epi64(vidx);
+}
+
+void flat_array_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	flat_array_t *a = (flat_array_t *)s;
+	int i, err;
+
+	a->nproc = nproc;
+	a->len = (nproc + FA_STRIDE - 1) / FA_STRIDE * FA_STRIDE;
+	a->cmp_dl = cmp_dl;
+	a->latest = cmp_dl(1, 0);
+
+	err = posix_memalign((void **)&a->keys, FA_STRIDE * sizeof(*a->keys),
+			a->len * sizeof(*a->keys));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	for (i = 0; i < a->len; i++)
+		a->keys[i] = FA_EMPTY;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		a->scan = fa_scan_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		a->scan = fa_scan_avx2;
+	else
+		a->scan = fa_scan_scalar;
+}
+
+void flat_array_cleanup(void *s)
+{
+	flat_array_t *a = (flat_array_t *)s;
+
+	free(a->keys);
+}
+
+int flat_array_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	flat_array_t *a = (flat_array_t *)s;
+
+	if (cpu < 0 || cpu >= a->nproc) {
+		fprintf(stderr, "WARNING: flat_array_set on CPU %d, only %d CPUs available\n",
+				cpu, a->nproc);
+		return -1;
+	}
+
+	__atomic_store_n(&a->keys[cpu], is_valid ? fa_encode(a, dline) : FA_EMPTY,
+			__ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int flat_array_find_dl(void *s, __u64 *dline)
+{
+	flat_array_t *a = (flat_array_t *)s;
+	int cpu;
+
+	cpu = a->scan(a->keys, a->len);
+	if (cpu == -1) {
+		*dline = 0;
+		return -1;
+	}
+
+	/* the slot may have changed since the scan, as with any find */
+	*dline = fa_decode(a, __atomic_load_n(&a->keys[cpu], __ATOMIC_RELAXED));
+
+	return cpu;
+}
+
+int flat_array_find(void *s)
+{
+	flat_array_t *a = (flat_array_t *)s;
+
+	return a->scan(a->keys, a->len);
+}
+
+void flat_array_save(void *s, int nproc, FILE *f)
+{
+	flat_array_t *a = (flat_array_t *)s;
+	__s64 key;
+	int i;
+
+	fprintf(f, "Flat array (%d slots):\n[ ", a->len);
+	for (i = 0; i < nproc; i++) {
+		key = __atomic_load_n(&a->keys[i], __ATOMIC_RELAXED);
+		if (key == FA_EMPTY)
+			fprintf(f, "(%d, -) ", i);
+		else
+			fprintf(f, "(%d, %llu) ", i, fa_decode(a, key));
+	}
+	fprintf(f, "]\n");
+}
+
+void flat_array_print(void *s, int nproc)
+{
+	flat_array_save(s, nproc, stdout);
+}
+
+/*
+ * flat_array_check - padding slots must stay empty and
+ * the vector scan must agree with the scalar one
+ */
+int flat_array_check(void *s, int nproc)
+{
+	flat_array_t *a = (flat_array_t *)s;
+	int i, cpu, expected;
+
+	for (i = a->nproc; i < a->len; i++)
+		if (a->keys[i] != FA_EMPTY) {
+			printf("Padding slot %d isn't empty!\n", i);
+			flat_array_print(s, nproc);
+			return 0;
+		}
+
+	cpu = a->scan(a->keys, a->len);
+	expected = fa_scan_scalar(a->keys, a->len);
+	if (cpu != expected) {
+		printf("Scan returned CPU %d, expected %d!\n", cpu, expected);
+		flat_array_print(s, nproc);
+		return 0;
+	}
+
+	return 1;
+}
+
+int flat_array_check_cpu(void *s, int cpu, __u64 dline)
+{
+	flat_array_t *a = (flat_array_t *)s;
+
+	return a->keys[cpu] == (dline ? fa_encode(a, dline) : FA_EMPTY);
+}
+
+const struct data_struct_ops flat_array_ops = {
+	.data_init = flat_array_init,
+	.data_cleanup = flat_array_cleanup,
+	.data_preempt = flat_array_set,
+	.data_finish = flat_array_set,
+	.data_find = flat_array_find,
+	.data_find_dl = flat_array_find_dl,
+	.data_max = flat_array_find,
+	.data_save = flat_array_save,
+	.data_print = flat_array_print,
+	.data_check = flat_array_check,
+	.data_check_cpu = flat_array_check_cpu
+};
@@ -18,6 +18,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <stdio.h>
 
@@ -25,18 +26,20 @@
 #include "common_ops.h"
 #include "parameters.h"
 
+/*
+ * hand-over-hand locking: locks are always taken
+ * from parents to children, i.e. in increasing
+ * index order, which rules out deadlocks
+ */
 #ifndef SEQUENTIAL 
 #define LOCK(h,x)                                                       \
     do {                                                                \
-        if (x < h->nproc) { pthread_mutex_lock(&h->array[x].m);         \
-            h->array[x].locked = 1;                                     \
-            h->array[x].id = (pthread_self() % 100);}                   \
+        if (x < h->nproc) pthread_spin_lock(&h->array[x].lock);         \
     } while(0)
 
 #define UNLOCK(h,x)                                                     \
     do {                                                                \
-        if (x < h->nproc) { h->array[x].locked = 0;                     \
-            pthread_mutex_unlock(&h->array[x].m); }                     \
+        if (x < h->nproc) pthread_spin_unlock(&h->array[x].lock);       \
     } while(0)
 #else
 #define LOCK(h,x)                                                       
@@ -50,53 +53,77 @@
 #define PRINT(x)
 #endif
 
-dline_t DLINE_MAX = {0, DL_MAX};
-dline_t DLINE_MIN = {0, DL_MIN};
+/*
+ * heap_key - encode a deadline, with no branches:
+ * see dline_t for the encoding
+ */
+static inline dline_t heap_key(heap_t *h, __u64 dl, int is_valid)
+{
+    u64 valid = -(u64)!!is_valid;
+
+    return ((dl ^ h->invert) & valid) | (~h->invert & ~valid);
+}
 
-int dl_time_before(dline_t a, dline_t b)
+static inline __u64 heap_dline(heap_t *h, dline_t key)
 {
-	if (a.special == DL_MIN) {
-		if (b.special == DL_MIN) return 0;
-		else return 1;
-	} else if (a.special == DL_MAX) {
-		return 0;
-	} else {
-		if (b.special == DL_MIN) return 0;
-		else if (b.special == DL_MAX) return 1;
-		else return ((s64)(a.value - b.value) < 0);
-	}
+    return key == ~h->invert ? 0 : key ^ h->invert;
 }
 
+/*
+ * node pointers are published with release stores: heap_find_dl()
+ * reads the root one without locks
+ */
 void heap_swap_nodes(heap_t *h, int n, int p)
 {
     node_t *tmp = h->array[n].node;
-    h->array[n].node = h->array[p].node;
-    h->array[p].node = tmp;
+    __atomic_store_n(&h->array[n].node, h->array[p].node, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->array[p].node, tmp, __ATOMIC_RELEASE);
     h->array[n].node->position = n;
     h->array[p].node->position = p;
 }
 
-int max_dline_proc(heap_t *h, int a, int b, int c) 
+/* among a node and its children, the one with the greatest key, n on ties */
+int max_dline_proc(heap_t *h, int n, int l, int r) 
 {
-    int proc = dl_time_before(DLINE(h, b), DLINE(h, a)) ? a : b;
-    return dl_time_before(DLINE(h, c), DLINE(h, proc)) ? proc : c;
+    int proc = n;
+    if (l < h->nproc && DLINE(h, l) > DLINE(h, proc)) proc = l;
+    if (r < h->nproc && DLINE(h, r) > DLINE(h, proc)) proc = r;
+    return proc;
 }
 
-void heap_init(void *s, int nproc)
+/*
+ * heap_init - cmp_dl is the one of array_heap: __dl_time_before
+ * keeps the latest deadline (and CPUs without one) on top,
+ * __dl_time_after the earliest deadline
+ */
+void heap_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
 {
-    int i;
+    int i, err;
     heap_t *h = (heap_t*) s;
-    h->array = (heap_node_t *)malloc(sizeof(heap_node_t)*nproc);
+    err = posix_memalign((void **)&h->array, sizeof(heap_node_t),
+                         sizeof(heap_node_t)*nproc);
+    if (err) {
+        fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+        exit(-1);
+    }
     h->nproc = nproc;
-    h->nodes = (node_t*)malloc(sizeof(node_t)*nproc);
+    h->cmp_dl = cmp_dl;
+    h->invert = cmp_dl(0, 1) ? 0 : ~0ULL;
+    for (h->depth = 1; (1 << h->depth) <= nproc; h->depth++)
+        ;
+    err = posix_memalign((void **)&h->nodes, sizeof(node_t),
+                         sizeof(node_t)*nproc);
+    if (err) {
+        fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+        exit(-1);
+    }
     for (i=0; i<nproc; i++) {
         h->nodes[i].proc_index = i;
-        h->nodes[i].deadline = DLINE_MAX;
+        h->nodes[i].deadline = ~h->invert;
         h->nodes[i].position = i;
 
         h->array[i].node = &h->nodes[i];
-        pthread_mutex_init(&(h->array[i].m), 0);
-        h->array[i].locked = 0;
+        pthread_spin_init(&(h->array[i].lock), 0);
     }    
 }
 
@@ -105,73 +132,48 @@ void heap_delete(void *s)
     int i;
     heap_t *h = (heap_t*) s;
     for (i=0; i<h->nproc; i++) 
-        pthread_mutex_destroy(&(h->array[i].m));
+        pthread_spin_destroy(&(h->array[i].lock));
     free(h->nodes);
     free(h->array);
 }
 
-int heap_preempt(void *s, int proc, __u64 newdl, int is_valid)
+/*
+ * heap_set_dline - update the deadline of a processor: a smaller
+ * key moves it towards the leaves, a greater one towards the root.
+ * Only the owner of proc (holding its runqueue lock) changes its
+ * key, so it can be read here without locks
+ */
+int heap_set_dline(void *s, int proc, __u64 dl, int is_valid)
 {
     heap_t *h = (heap_t*) s;
-    dline_t newdline;
-    newdline.value = newdl;
-    newdline.special = DL_NORMAL;
-    LOCK(h, 0);
-    /* check if still the same */
-    if (proc != h->array[0].node->proc_index) {
-        UNLOCK(h, 0);
-        return 0;
-    }
-    /* still the same, do the update */
-    h->array[0].node->deadline = newdline;
-    int n = 0;
-    int l = 1;
-    int r = 2;
-    /* see if we must go down */
-    while (n < h->nproc) {
-        LOCK(h, l);
-        LOCK(h, r);
-        int p = max_dline_proc(h,n,l,r);
-        if (p == n) {
-            UNLOCK(h, r);
-            UNLOCK(h, l);
-            UNLOCK(h, n);
-            return 1;
-        }
-        else if (p == r) UNLOCK(h, l);
-        else             UNLOCK(h, r);
+    dline_t key = heap_key(h, dl, is_valid);
 
-        /* p and n are still locked    */
-        /* now p and n must be swapped */
-        heap_swap_nodes(h, n, p);
-
-        UNLOCK(h, n);   /* p is still locked */
-
-        n = p;
-        l = heap_left(n);
-        r = heap_right(n);
-    }
-    printf("SHOULD NEVER GO OUT FROM HERE!\n");
-    exit(-1);
-    UNLOCK(h, n);
-    return 1;
+    if (key == h->nodes[proc].deadline)
+        return 1;
+    if (key < h->nodes[proc].deadline)
+        return heap_preempt_local(s, proc, dl, is_valid);
+    return heap_finish(s, proc, dl, is_valid);
 }
 
+/*
+ * heap_preempt_local - decrease the key of proc and
+ * sift it down
+ */
 int heap_preempt_local(void *s, int proc, __u64 newdl, int is_valid)
 {
     heap_t *h = (heap_t*) s;
-    dline_t newdline;
-    newdline.value = newdl;
-    newdline.special = DL_NORMAL;
-    int proc_pos = h->nodes[proc].position;
-    LOCK(h, proc_pos);
-    /* check if still the same */
-    if (proc != h->array[proc_pos].node->proc_index) {
+    dline_t newdline = heap_key(h, newdl, is_valid);
+    int proc_pos;
+    /* proc may be moved until we lock its position */
+    while (1) {
+        proc_pos = h->nodes[proc].position;
+        LOCK(h, proc_pos);
+        if (h->array[proc_pos].node == &h->nodes[proc])
+            break;
         UNLOCK(h, proc_pos);
-        return 0;
     }
     /* still the same, do the update */
-    h->array[proc_pos].node->deadline = newdline;
+    __atomic_store_n(&h->array[proc_pos].node->deadline, newdline, __ATOMIC_RELAXED);
     int n = proc_pos;
     int l = heap_left(n);
     int r = heap_right(n);
@@ -207,22 +209,19 @@ int heap_preempt_local(void *s, int proc, __u64 newdl, int is_valid)
 
 // the path is on the stack: now I should lock from top until proc
 // the problem is that proc could move up in the meanwhile!
-#define STACKSIZE  10   /* needs to be > log_2(nproc) */
 #define STACKBASE  0   
 
+/*
+ * heap_finish - increase the key of proc and sift it up:
+ * the path from the root to proc is locked, then proc is
+ * moved to the highest node on the path with a smaller key
+ */
 int heap_finish(void *s, int proc, __u64 dl, int is_valid)
 {
-    int path[STACKSIZE];                     
-    int top = STACKBASE, base = STACKBASE;              
     heap_t *h = (heap_t*) s;
-    dline_t deadline;
-    if (is_valid) {
-        deadline.value = dl;
-        deadline.special = DL_NORMAL;
-    } else {
-        deadline.value = 0;
-        deadline.special = DL_MAX;
-    }
+    int path[h->depth];
+    int top = STACKBASE, base = STACKBASE;              
+    dline_t deadline = heap_key(h, dl, is_valid);
     node_t *p_proc = &h->nodes[proc];
 
     int j = 0, k = 0;             /* node indexes       */
@@ -245,14 +244,14 @@ int heap_finish(void *s, int proc, __u64 dl, int is_valid)
     /* now, everything is locked from 0 to j included */
     /* assumption: dline > j->dline */
     /* we now check the assumption, otherwise abort */
-    if (dl_time_before(deadline, p_proc->deadline)) {
+    if (deadline < p_proc->deadline) {
         /* unlock everything and return */
         for (i=0; i<top; i++) UNLOCK(h, path[i]);
         return 0;
     }
     /* now the assumption holds */
     k = path[base];
-    while (dl_time_before(deadline, DLINE(h, k))) { 
+    while (deadline < DLINE(h, k)) { 
         UNLOCK(h, k);
         k = path[++base];          /* move to child on path */
     }
@@ -260,13 +259,12 @@ int heap_finish(void *s, int proc, __u64 dl, int is_valid)
     /* now, everything locked from k to j included */ 
     node_t *p = ARRAY_PNODE(h,j);
     node_t *q = 0;
-    ARRAY_PNODE(h,j)->deadline = deadline;
+    __atomic_store_n(&ARRAY_PNODE(h,j)->deadline, deadline, __ATOMIC_RELAXED);
     for (i = base; i<top; i++) {
         q = ARRAY_PNODE(h, path[i]);
-        ARRAY_PNODE(h, path[i]) = p;
+        __atomic_store_n(&ARRAY_PNODE(h, path[i]), p, __ATOMIC_RELEASE);
         p = q;
         ARRAY_PNODE(h, path[i])->position = path[i];
-        //UNLOCK(h,path[i]);
     }
 
     for (i = base; i<top; i++) {
@@ -275,22 +273,33 @@ int heap_finish(void *s, int proc, __u64 dl, int is_valid)
     return 1;
 }
 
+/*
+ * heap_find_dl - read the root without locks, a CPU without
+ * deadline is returned (with deadline 0) only if it is the
+ * best choice, i.e. when the latest deadline is on top
+ */
+int heap_find_dl(void *s, __u64 *dline)
+{
+    heap_t *h = (heap_t*) s;
+    node_t *root = __atomic_load_n(&h->array[0].node, __ATOMIC_ACQUIRE);
+    dline_t key = __atomic_load_n(&root->deadline, __ATOMIC_RELAXED);
+
+    *dline = heap_dline(h, key);
+    if (key == ~h->invert && h->invert)
+        return -1;
+    return root->proc_index;
+}
+
+int heap_find(void *s)
+{
+    __u64 dline;
+
+    return heap_find_dl(s, &dline);
+}
 
 void heap_print(void *s, int nproc)
 {
-    int i;
-    heap_t *h = (heap_t*) s;
-    printf("[\n");
-    for (i=0; i<h->nproc; i++) {
-        printf("  pos: %d = (pr %d, dl %llu (%d), lk %d", i, 
-               h->array[i].node->proc_index, 
-               h->array[i].node->deadline.value,
-               h->array[i].node->deadline.special,
-               h->array[i].locked);
-        if (h->array[i].locked) printf(" id %ld)\n", h->array[i].id);
-        else printf(")\n");
-    }
-    printf("]\n");
+    heap_save(s, nproc, stdout);
 }
 
 
@@ -312,17 +321,15 @@ int heap_check(void *s, int nproc)
             flag = 0; 
             break;
         } 
-        if (dl_time_before(DLINE(h,i), DLINE(h,heap_left(i)))) {
-            printf("Node %d has deadline %llu (%d) which is smaller than its left child (%d) deadline %llu (%d)\n", 
-                   i, DLINE(h,i).value, DLINE(h,i).special , 
-                   heap_left(i), DLINE(h,heap_left(i)).value, DLINE(h,heap_left(i)).special);
+        if (DLINE(h,i) < DLINE(h,heap_left(i))) {
+            printf("Node %d has key %llu which is smaller than its left child (%d) key %llu\n", 
+                   i, DLINE(h,i), heap_left(i), DLINE(h,heap_left(i)));
             flag = 0;
             break;
         }
-        if (dl_time_before(DLINE(h,i), DLINE(h,heap_right(i)))) {
-            printf("Node %d has deadline %llu (%d) which is smaller than its right child (%d) deadline %llu (%d)\n", 
-                   i, DLINE(h,i).value, DLINE(h,i).special, heap_right(i), 
-                   DLINE(h,heap_right(i)).value, DLINE(h,heap_right(i)).special);
+        if (DLINE(h,i) < DLINE(h,heap_right(i))) {
+            printf("Node %d has key %llu which is smaller than its right child (%d) key %llu\n", 
+                   i, DLINE(h,i), heap_right(i), DLINE(h,heap_right(i)));
             flag = 0;
             break;
         }
@@ -333,13 +340,22 @@ int heap_check(void *s, int nproc)
         flag = 0;
     }
 
-    if (flag == 1) 
-	for (i=0; i<h->nproc; i++) 
-            UNLOCK(h, i);
+    for (i=0; i<h->nproc; i++) 
+        UNLOCK(h, i);
+
+    if (flag == 0)
+        heap_print(s, nproc);
 
     return flag;
 }
 
+int heap_check_cpu(void *s, int proc, __u64 dline)
+{
+    heap_t *h = (heap_t*) s;
+
+    return h->nodes[proc].deadline == heap_key(h, dline, dline != 0);
+}
+
 void heap_save(void *s, int nproc, FILE *f)
 {
     int i;
@@ -347,10 +363,10 @@ void heap_save(void *s, int nproc, FILE *f)
     fprintf(f, "N_Nodes: %d\n", h->nproc);
     
     for (i=0; i<h->nproc; i++) {
-        fprintf(f, "index %d\tdeadline %llu type %d\n", 
+        fprintf(f, "index %d\tdeadline %llu valid %d\n", 
                 h->array[i].node->proc_index, 
-                h->array[i].node->deadline.value,
-                h->array[i].node->deadline.special
+                heap_dline(h, h->array[i].node->deadline),
+                h->array[i].node->deadline != ~h->invert
             );
     }
 }
@@ -360,18 +376,17 @@ void heap_load(void *s, FILE *f)
     char str[100];
     int n, i;
     int k;
-    dline_t d;
-    int x;
+    __u64 dl;
+    int valid;
     heap_t *h = (heap_t*) s;
     fscanf(f, "%s %d\n", str, &n);
 
-    heap_init(h, n);
+    heap_init(h, n, h->cmp_dl);
     
     for (i=0; i<h->nproc; i++) {
         fscanf(f, "%s %d", str, &k);
-        fscanf(f, "%s %llu %d", str, &d.value, &x);
-        d.special = x;
-        h->nodes[k].deadline = d;
+        fscanf(f, "%s %llu %s %d", str, &dl, str, &valid);
+        h->nodes[k].deadline = heap_key(h, dl, valid);
         h->nodes[k].position = i;
         h->array[i].node = &h->nodes[k];
     }
@@ -380,12 +395,14 @@ void heap_load(void *s, FILE *f)
 const struct data_struct_ops heap_ops = {
 	.data_init = heap_init,
 	.data_cleanup = heap_delete,
-	.data_preempt = heap_preempt_local,
-	.data_finish = heap_finish,
-	//.data_find = array_heap_find,
-	//.data_max = heap_maximum,
+	.data_preempt = heap_set_dline,
+	.data_finish = heap_set_dline,
+	.data_find = heap_find,
+	.data_find_dl = heap_find_dl,
+	.data_max = heap_find,
 	.data_load = heap_load,
 	.data_save = heap_save,
 	.data_check = heap_check,
 	.data_print = heap_print,
+	.data_check_cpu = heap_check_cpu
 };
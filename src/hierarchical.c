@@ -0,0 +1,358 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hierarchical data structure: CPUs are split in groups after the
+ * machine topology, every group has its own instance of the chosen
+ * backend and a top level instance, indexed by group, holds the best
+ * CPU of every group. An update only touches the group of the CPU,
+ * and the top level only if the group's best CPU or deadline changed,
+ * so most cache lines written stay within a LLC (or NUMA node).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "hierarchical.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+#ifdef HIER_GROUP_BY_PACKAGE
+#define HIER_TOPOLOGY_FILE	"/sys/devices/system/cpu/cpu%d/topology/physical_package_id"
+#else
+/* the first CPU of the list identifies the group */
+#define HIER_TOPOLOGY_FILE	"/sys/devices/system/cpu/cpu%d/cache/index3/shared_cpu_list"
+#endif
+
+static void *hier_alloc(size_t size)
+{
+	void *p = calloc(1, size);
+
+	if (!p) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	return p;
+}
+
+/*
+ * hier_topology_id - read the id of the group of a
+ * CPU from sysfs, -1 if not available
+ */
+static int hier_topology_id(int cpu)
+{
+	char path[128];
+	FILE *f;
+	int id;
+
+	snprintf(path, sizeof(path), HIER_TOPOLOGY_FILE, cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &id) != 1)
+		id = -1;
+	fclose(f);
+
+	return id;
+}
+
+/*
+ * hier_groups - fill cpu_to_group with dense group
+ * indexes and return the number of groups
+ */
+static int hier_groups(hier_t *h)
+{
+	int *ids, cpu, i, ngroups = 0;
+
+	ids = (int *)hier_alloc(h->nproc * sizeof(*ids));
+	for (cpu = 0; cpu < h->nproc; cpu++) {
+		ids[cpu] = hier_topology_id(cpu);
+		if (ids[cpu] < 0)
+			break;
+	}
+
+	if (cpu < h->nproc) {
+		/* simulating more CPUs than we have, or no sysfs */
+		for (cpu = 0; cpu < h->nproc; cpu++)
+			h->cpu_to_group[cpu] = cpu / HIER_GROUP_SIZE;
+		free(ids);
+
+		return (h->nproc + HIER_GROUP_SIZE - 1) / HIER_GROUP_SIZE;
+	}
+
+	for (cpu = 0; cpu < h->nproc; cpu++) {
+		for (i = 0; i < cpu; i++)
+			if (ids[i] == ids[cpu])
+				break;
+		h->cpu_to_group[cpu] = i < cpu ? h->cpu_to_group[i] : ngroups++;
+	}
+	free(ids);
+
+	return ngroups;
+}
+
+/*
+ * hier_set_leaf - select the backend used for both levels,
+ * to be called before hier_init
+ * @s:		the hierarchical data structure
+ * @ops:	operations of the backend
+ * @size:	size of an instance of the backend
+ */
+void hier_set_leaf(void *s, const struct data_struct_ops *ops, size_t size)
+{
+	hier_t *h = (hier_t *)s;
+
+	h->ops = ops;
+	h->size = size;
+}
+
+/*
+ * hier_init - split CPUs in groups and initialize every
+ * level, cmp_dl is the one the chosen backend expects
+ */
+void hier_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	hier_t *h = (hier_t *)s;
+	struct hier_group *g;
+	int cpu, i, err;
+
+	h->nproc = nproc;
+	h->cpu_to_group = (int *)hier_alloc(nproc * sizeof(*h->cpu_to_group));
+	h->cpu_to_local = (int *)hier_alloc(nproc * sizeof(*h->cpu_to_local));
+	h->dline = (__u64 *)hier_alloc(nproc * sizeof(*h->dline));
+	h->ngroups = hier_groups(h);
+
+	err = posix_memalign((void **)&h->groups, sizeof(*h->groups),
+			h->ngroups * sizeof(*h->groups));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(h->groups, 0, h->ngroups * sizeof(*h->groups));
+
+	for (cpu = 0; cpu < nproc; cpu++)
+		h->cpu_to_local[cpu] = h->groups[h->cpu_to_group[cpu]].size++;
+
+	for (i = 0; i < h->ngroups; i++) {
+		g = &h->groups[i];
+		lock_init(&g->lock);
+		g->cpus = (int *)hier_alloc(g->size * sizeof(*g->cpus));
+		g->leaf = hier_alloc(h->size);
+		h->ops->data_init(g->leaf, g->size, cmp_dl);
+		g->best_cpu = -1;
+		g->best_dl = 0;
+	}
+	for (cpu = 0; cpu < nproc; cpu++)
+		h->groups[h->cpu_to_group[cpu]].cpus[h->cpu_to_local[cpu]] = cpu;
+
+	h->top = hier_alloc(h->size);
+	h->ops->data_init(h->top, h->ngroups, cmp_dl);
+}
+
+void hier_cleanup(void *s)
+{
+	hier_t *h = (hier_t *)s;
+	int i;
+
+	h->ops->data_cleanup(h->top);
+	free(h->top);
+	for (i = 0; i < h->ngroups; i++) {
+		h->ops->data_cleanup(h->groups[i].leaf);
+		free(h->groups[i].leaf);
+		free(h->groups[i].cpus);
+		lock_destroy(&h->groups[i].lock);
+	}
+	free(h->groups);
+	free(h->dline);
+	free(h->cpu_to_local);
+	free(h->cpu_to_group);
+}
+
+/*
+ * hier_set - update a CPU in its group and, if the best
+ * CPU of the group changed, the group in the top level
+ * @s:				the hierarchical data structure
+ * @cpu:			the CPU to update
+ * @dline:		its new deadline
+ * @is_valid:	0 if the CPU leaves the data structure
+ */
+int hier_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	hier_t *h = (hier_t *)s;
+	struct hier_group *g;
+	int group, local, best_cpu;
+	__u64 best_dl;
+
+	if (cpu < 0 || cpu >= h->nproc) {
+		fprintf(stderr, "WARNING: hier_set on CPU %d, only %d CPUs available\n",
+				cpu, h->nproc);
+		return -1;
+	}
+
+	group = h->cpu_to_group[cpu];
+	g = &h->groups[group];
+
+	lock_acquire(&g->lock);
+
+	h->ops->data_preempt(g->leaf, h->cpu_to_local[cpu], dline, is_valid);
+	__atomic_store_n(&h->dline[cpu], is_valid ? dline : 0, __ATOMIC_RELEASE);
+
+	local = h->ops->data_find(g->leaf);
+	best_cpu = local == -1 ? -1 : g->cpus[local];
+	best_dl = best_cpu == -1 ? 0 : h->dline[best_cpu];
+	if (best_cpu != g->best_cpu || best_dl != g->best_dl) {
+		g->best_cpu = best_cpu;
+		g->best_dl = best_dl;
+		/*
+		 * an idle best CPU (cpudl) leaves the group out of the
+		 * top level, which then reports the group as idle
+		 */
+		h->ops->data_preempt(h->top, group, best_dl, best_dl != 0);
+	}
+
+	lock_release(&g->lock);
+
+	return 0;
+}
+
+/*
+ * hier_find_dl - pick the best group from the top level,
+ * then the best CPU inside it, -1 if there isn't any
+ * @s:			the hierarchical data structure
+ * @dline:	where to store the deadline of the CPU found
+ */
+int hier_find_dl(void *s, __u64 *dline)
+{
+	hier_t *h = (hier_t *)s;
+	int group, local, cpu;
+
+	*dline = 0;
+	group = h->ops->data_find(h->top);
+	if (group == -1)
+		return -1;
+
+	/* the group may have been emptied meanwhile */
+	local = h->ops->data_find(h->groups[group].leaf);
+	if (local == -1)
+		return -1;
+
+	cpu = h->groups[group].cpus[local];
+	*dline = __atomic_load_n(&h->dline[cpu], __ATOMIC_ACQUIRE);
+
+	return cpu;
+}
+
+int hier_find(void *s)
+{
+	__u64 dline;
+
+	return hier_find_dl(s, &dline);
+}
+
+void hier_save(void *s, int nproc, FILE *f)
+{
+	hier_t *h = (hier_t *)s;
+	int i, j;
+
+	fprintf(f, "\n----Hierarchical (%d groups)----\n", h->ngroups);
+	fprintf(f, "Top level:\n");
+	h->ops->data_save(h->top, h->ngroups, f);
+	for (i = 0; i < h->ngroups; i++) {
+		fprintf(f, "Group %d, CPUs", i);
+		for (j = 0; j < h->groups[i].size; j++)
+			fprintf(f, " %d", h->groups[i].cpus[j]);
+		fprintf(f, ", best %d (%llu):\n", h->groups[i].best_cpu,
+				h->groups[i].best_dl);
+		h->ops->data_save(h->groups[i].leaf, h->groups[i].size, f);
+	}
+	fprintf(f, "----End Hierarchical----\n\n");
+}
+
+void hier_print(void *s, int nproc)
+{
+	hier_save(s, nproc, stdout);
+}
+
+/*
+ * hier_check - check every level and that the top level
+ * agrees with what every group found as its best CPU
+ */
+int hier_check(void *s, int nproc)
+{
+	hier_t *h = (hier_t *)s;
+	struct hier_group *g;
+	int i, local, flag = 1;
+
+	if (!h->ops->data_check(h->top, h->ngroups)) {
+		printf("Top level check failed!\n");
+		flag = 0;
+	}
+
+	for (i = 0; i < h->ngroups && flag; i++) {
+		g = &h->groups[i];
+		if (!h->ops->data_check(g->leaf, g->size)) {
+			printf("Group %d check failed!\n", i);
+			flag = 0;
+		} else if (!h->ops->data_check_cpu(h->top, i, g->best_dl)) {
+			printf("Group %d best deadline %llu not in the top level!\n",
+					i, g->best_dl);
+			flag = 0;
+		} else {
+			local = h->ops->data_find(g->leaf);
+			if ((local == -1 ? -1 : g->cpus[local]) != g->best_cpu) {
+				printf("Group %d best CPU is %d, top level has %d!\n",
+						i, local == -1 ? -1 : g->cpus[local], g->best_cpu);
+				flag = 0;
+			}
+		}
+	}
+
+	if (!flag)
+		hier_print(s, nproc);
+
+	return flag;
+}
+
+int hier_check_cpu(void *s, int cpu, __u64 dline)
+{
+	hier_t *h = (hier_t *)s;
+	struct hier_group *g = &h->groups[h->cpu_to_group[cpu]];
+
+	return h->dline[cpu] == dline &&
+		h->ops->data_check_cpu(g->leaf, h->cpu_to_local[cpu], dline);
+}
+
+const struct data_struct_ops hier_ops = {
+	.data_init = hier_init,
+	.data_cleanup = hier_cleanup,
+	.data_preempt = hier_set,
+	.data_finish = hier_set,
+	.data_find = hier_find,
+	.data_find_dl = hier_find_dl,
+	.data_max = hier_find,
+	.data_save = hier_save,
+	.data_print = hier_print,
+	.data_check = hier_check,
+	.data_check_cpu = hier_check_cpu
+};
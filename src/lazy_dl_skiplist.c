@@ -0,0 +1,393 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lazy skiplist (Herlihy, Lev, Luchangco, Shavit): searches take
+ * no lock, an update locks only the predecessors of the node on
+ * every level, validates them and then links or unlinks it, so
+ * that updates on distant parts of the list run in parallel.
+ * A node is removed by marking it under its own lock (the
+ * linearization point) and then unlinking it top-down.
+ *
+ * Every CPU owns a single node, removed and inserted again when
+ * its deadline changes. A search may then walk over a node that
+ * has moved meanwhile, so the validation also checks that a
+ * predecessor is fully linked, high enough and still in front of
+ * the key: a live node never changes key, a moved one fails.
+ * Locks are taken with trylock, backing off on failure; the only
+ * blocking lock is the one of the owner on its own node, taken
+ * while holding nothing else, hence no deadlock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <linux/types.h>
+
+#include "lazy_dl_skiplist.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+/* probability of a node to reach the next level */
+#define LAZY_SL_LEVEL_PROB		0.20
+
+#define LOAD(x)				__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v)			__atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+
+/*
+ * lazy_sl_before - return 1 if node n comes before the key
+ * (dline, cpu): CPUs break ties among equal deadlines, so
+ * that every key in the list is unique
+ */
+static inline int lazy_sl_before(lazy_dl_skiplist_t *p, struct lazy_sl_node *n,
+		__u64 dline, int cpu)
+{
+	__u64 n_dline = LOAD(n->dline);
+
+	if (n_dline != dline)
+		return p->cmp_dl(n_dline, dline);
+
+	return LOAD(n->cpu) < cpu;
+}
+
+/*
+ * lazy_sl_search - fill preds and succs with the nodes surrounding
+ * the key (dline, cpu) on every level, without taking locks.
+ * The walk is bounded since a moved node may lead anywhere.
+ */
+static void lazy_sl_search(lazy_dl_skiplist_t *p, __u64 dline, int cpu,
+		struct lazy_sl_node **preds, struct lazy_sl_node **succs)
+{
+	struct lazy_sl_node *x, *y;
+	int i, steps;
+
+retry:
+	x = &p->head;
+	for (i = LAZY_SL_MAX_LEVEL - 1; i >= 0; i--) {
+		steps = 0;
+		for (y = LOAD(x->next[i]); y && lazy_sl_before(p, y, dline, cpu);
+				y = LOAD(x->next[i])) {
+			if (++steps > p->nproc)
+				goto retry;
+			x = y;
+		}
+		preds[i] = x;
+		succs[i] = y;
+	}
+}
+
+/*
+ * lazy_sl_valid_pred - to be called with pred locked: pred
+ * is in the list at level i, in front of the key and
+ * followed by succ
+ */
+static inline int lazy_sl_valid_pred(lazy_dl_skiplist_t *p, struct lazy_sl_node *pred,
+		struct lazy_sl_node *succ, int i, __u64 dline, int cpu)
+{
+	if (pred != &p->head && (LOAD(pred->marked) || !LOAD(pred->fully_linked) ||
+			pred->level < i || !lazy_sl_before(p, pred, dline, cpu)))
+		return 0;
+
+	return LOAD(pred->next[i]) == succ;
+}
+
+/*
+ * lazy_sl_lock_preds - lock and validate the predecessors from
+ * level 0 to top, the same node is locked only once; return 1
+ * if all of them are valid, *locked is the number of levels
+ * whose predecessor is locked
+ */
+static int lazy_sl_lock_preds(lazy_dl_skiplist_t *p, struct lazy_sl_node **preds,
+		struct lazy_sl_node **succs, int top, __u64 dline, int cpu, int insert,
+		int *locked)
+{
+	int i;
+
+	for (i = 0; i <= top; i++) {
+		*locked = i;
+		if ((!i || preds[i] != preds[i - 1]) && pthread_spin_trylock(&preds[i]->lock))
+			return 0;
+		*locked = i + 1;
+		if (!lazy_sl_valid_pred(p, preds[i], succs[i], i, dline, cpu))
+			return 0;
+		/* an insertion must land in front of a live successor */
+		if (insert && succs[i] && (LOAD(succs[i]->marked) ||
+				lazy_sl_before(p, succs[i], dline, cpu)))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void lazy_sl_unlock_preds(struct lazy_sl_node **preds, int locked)
+{
+	int i;
+
+	for (i = 0; i < locked; i++)
+		if (!i || preds[i] != preds[i - 1])
+			pthread_spin_unlock(&preds[i]->lock);
+}
+
+static void lazy_sl_insert(lazy_dl_skiplist_t *p, struct lazy_sl_node *n)
+{
+	struct lazy_sl_node *preds[LAZY_SL_MAX_LEVEL], *succs[LAZY_SL_MAX_LEVEL];
+	int i, locked;
+
+	while (1) {
+		lazy_sl_search(p, n->dline, n->cpu, preds, succs);
+		if (lazy_sl_lock_preds(p, preds, succs, n->level,
+				n->dline, n->cpu, 1, &locked))
+			break;
+		lazy_sl_unlock_preds(preds, locked);
+	}
+
+	for (i = 0; i <= n->level; i++)
+		STORE(n->next[i], succs[i]);
+	STORE(n->marked, 0);
+	for (i = 0; i <= n->level; i++)
+		STORE(preds[i]->next[i], n);
+	STORE(n->fully_linked, 1);
+
+	lazy_sl_unlock_preds(preds, locked);
+}
+
+static void lazy_sl_remove(lazy_dl_skiplist_t *p, struct lazy_sl_node *n)
+{
+	struct lazy_sl_node *preds[LAZY_SL_MAX_LEVEL], *succs[LAZY_SL_MAX_LEVEL];
+	int i, locked;
+
+	/* whoever uses n as a predecessor holds its lock */
+	pthread_spin_lock(&n->lock);
+	STORE(n->marked, 1);
+
+	while (1) {
+		lazy_sl_search(p, n->dline, n->cpu, preds, succs);
+		/* n must follow its predecessors on every level */
+		for (i = 0; i <= n->level; i++)
+			succs[i] = n;
+		if (lazy_sl_lock_preds(p, preds, succs, n->level,
+				n->dline, n->cpu, 0, &locked))
+			break;
+		lazy_sl_unlock_preds(preds, locked);
+	}
+
+	for (i = n->level; i >= 0; i--)
+		STORE(preds[i]->next[i], LOAD(n->next[i]));
+	STORE(n->fully_linked, 0);
+
+	lazy_sl_unlock_preds(preds, locked);
+	pthread_spin_unlock(&n->lock);
+}
+
+void lazy_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	unsigned int seed = 1;
+	struct lazy_sl_node *n;
+	int i, err;
+
+	memset(&p->head, 0, sizeof(p->head));
+	p->head.cpu = -1;
+	p->head.level = LAZY_SL_MAX_LEVEL - 1;
+	p->head.fully_linked = 1;
+	pthread_spin_init(&p->head.lock, 0);
+	p->nproc = nproc;
+	p->cmp_dl = cmp_dl;
+
+	err = posix_memalign((void **)&p->nodes, sizeof(struct lazy_sl_node),
+			nproc * sizeof(struct lazy_sl_node));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(p->nodes, 0, nproc * sizeof(struct lazy_sl_node));
+
+	/* a node keeps the same height across reuses */
+	for (i = 0; i < nproc; i++) {
+		n = &p->nodes[i];
+		n->cpu = i;
+		n->marked = 1;
+		pthread_spin_init(&n->lock, 0);
+		for (n->level = 0; n->level < LAZY_SL_MAX_LEVEL - 1 &&
+				rand_r(&seed) < LAZY_SL_LEVEL_PROB * RAND_MAX; n->level++)
+			;
+	}
+}
+
+void lazy_sl_cleanup(void *s)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	int i;
+
+	for (i = 0; i < p->nproc; i++)
+		pthread_spin_destroy(&p->nodes[i].lock);
+	pthread_spin_destroy(&p->head.lock);
+	free(p->nodes);
+}
+
+/*
+ * lazy_sl_preempt - move a CPU to its new position,
+ * updates on a CPU are serialized by its runqueue lock
+ * @s:				the skiplist
+ * @cpu:			the CPU to update
+ * @dline:		its new deadline
+ * @is_valid:	0 if the CPU leaves the list
+ */
+int lazy_sl_preempt(void *s, int cpu, __u64 dline, int is_valid)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	struct lazy_sl_node *n;
+
+	if (cpu < 0 || cpu >= p->nproc) {
+		fprintf(stderr, "WARNING: lazy_sl_preempt on CPU %d, only %d CPUs available\n",
+				cpu, p->nproc);
+		return -1;
+	}
+
+	n = &p->nodes[cpu];
+	if (n->in_list && is_valid && n->dline == dline)
+		return 0;
+
+	if (n->in_list)
+		lazy_sl_remove(p, n);
+	n->in_list = is_valid;
+	if (is_valid) {
+		STORE(n->dline, dline);
+		lazy_sl_insert(p, n);
+	}
+
+	return 0;
+}
+
+/*
+ * lazy_sl_find - a single read of the first node: it may be
+ * about to leave, the caller checks again under the
+ * runqueue lock
+ */
+int lazy_sl_find(void *s)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	struct lazy_sl_node *n = LOAD(p->head.next[0]);
+
+	return n ? n->cpu : -1;
+}
+
+void lazy_sl_save(void *s, int nproc, FILE *f)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	struct lazy_sl_node *n;
+	int i;
+
+	fprintf(f, "\n----Lazy skiplist----\n");
+
+	for (i = LAZY_SL_MAX_LEVEL - 1; i >= 0; i--) {
+		fprintf(f, "%d:\t", i);
+		for (n = LOAD(p->head.next[i]); n; n = LOAD(n->next[i]))
+			fprintf(f, "(%d, %llu)%s ", n->cpu, n->dline,
+					LOAD(n->marked) ? "*" : "");
+		fprintf(f, "\n");
+	}
+
+	for (i = 0; i < nproc; i++)
+		if (!p->nodes[i].in_list)
+			fprintf(f, "[%d]:\tout of list\n", i);
+		else
+			fprintf(f, "[%d]:\t%llu\n", i, p->nodes[i].dline);
+
+	fprintf(f, "----End Lazy skiplist----\n\n");
+}
+
+void lazy_sl_print(void *s, int nproc)
+{
+	lazy_sl_save(s, nproc, stdout);
+}
+
+/*
+ * lazy_sl_check - to be called while no update is in
+ * progress: every level must be sorted and hold only
+ * fully linked, unmarked nodes of CPUs in the list
+ */
+int lazy_sl_check(void *s, int nproc)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	struct lazy_sl_node *n, *prev;
+	int i, count, expected = 0, flag = 1;
+
+	for (i = 0; i < nproc; i++)
+		if (p->nodes[i].in_list)
+			expected++;
+
+	for (i = 0; i < LAZY_SL_MAX_LEVEL && flag; i++) {
+		prev = NULL;
+		count = 0;
+		for (n = p->head.next[i]; n; n = n->next[i]) {
+			if (n->marked || !n->fully_linked || !n->in_list || n->level < i) {
+				printf("Stale node of CPU %d linked at level %d!\n",
+					n->cpu, i);
+				flag = 0;
+				break;
+			}
+			if (prev && !lazy_sl_before(p, prev, n->dline, n->cpu)) {
+				printf("CPU %d (deadline %llu) and CPU %d (deadline %llu)"
+					" are out of order at level %d!\n", prev->cpu,
+					prev->dline, n->cpu, n->dline, i);
+				flag = 0;
+				break;
+			}
+			if (++count > expected)
+				break;
+			prev = n;
+		}
+		if (flag && !i && count != expected) {
+			printf("%d nodes in the list, %d expected!\n", count, expected);
+			flag = 0;
+		}
+	}
+
+	if (!flag)
+		lazy_sl_print(s, nproc);
+
+	return flag;
+}
+
+int lazy_sl_check_cpu(void *s, int cpu, __u64 dline)
+{
+	lazy_dl_skiplist_t *p = (lazy_dl_skiplist_t *)s;
+	struct lazy_sl_node *n = &p->nodes[cpu];
+
+	if (!dline)
+		return !n->in_list;
+
+	return n->in_list && n->dline == dline;
+}
+
+const struct data_struct_ops lazy_dl_skiplist_ops = {
+	.data_init = lazy_sl_init,
+	.data_cleanup = lazy_sl_cleanup,
+	.data_preempt = lazy_sl_preempt,
+	.data_finish = lazy_sl_preempt,
+	.data_find = lazy_sl_find,
+	.data_max = lazy_sl_find,
+	.data_save = lazy_sl_save,
+	.data_print = lazy_sl_print,
+	.data_check = lazy_sl_check,
+	.data_check_cpu = lazy_sl_check_cpu
+};
@@ -0,0 +1,480 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lock-free skiplist in the style of Fraser and Herlihy-Shavit:
+ * a node is removed by marking its links top-down, the mark on
+ * level 0 being the linearization point, and then unlinked by a
+ * search, which snips every marked node it walks over.
+ *
+ * Nodes are never freed: every CPU owns LF_SL_NODES_PER_CPU of
+ * them and, since a new deadline means a new position, it links a
+ * fresh node and unlinks the old one on every update. An unlinked
+ * node is reused only after two epochs, i.e. once every thread
+ * that could still hold a reference to it is gone (epoch based
+ * reclamation). Updates on a CPU are serialized by its runqueue
+ * lock, so a node is never inserted and removed concurrently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <linux/types.h>
+
+#include "lf_dl_skiplist.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+/* probability of a node to reach the next level */
+#define LF_SL_LEVEL_PROB		0.20
+
+#define LF_SL_IN_USE			(~0UL)
+
+#define IS_MARKED(w)			((w) & 1)
+#define MARKED(w)			((w) | 1)
+#define PTR(w)				((struct lf_sl_node *)((w) & ~(uintptr_t)1))
+
+static __thread int lf_sl_tid = -1;
+static int lf_sl_nthreads;
+
+static inline uintptr_t lf_sl_load(uintptr_t *w)
+{
+	return __atomic_load_n(w, __ATOMIC_ACQUIRE);
+}
+
+static inline int lf_sl_cas(uintptr_t *w, uintptr_t old, uintptr_t new)
+{
+	return __atomic_compare_exchange_n(w, &old, new, 0,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * lf_sl_before - return 1 if node n comes before the key
+ * (dline, cpu): CPUs break ties among equal deadlines, so
+ * that every key in the list is unique
+ */
+static inline int lf_sl_before(lf_dl_skiplist_t *p, struct lf_sl_node *n,
+		__u64 dline, int cpu)
+{
+	if (n->dline != dline)
+		return p->cmp_dl(n->dline, dline);
+
+	return n->cpu < cpu;
+}
+
+/*
+ * epoch based reclamation
+ */
+
+static inline struct lf_sl_slot *lf_sl_slot(lf_dl_skiplist_t *p)
+{
+	if (lf_sl_tid < 0) {
+		lf_sl_tid = __sync_fetch_and_add(&lf_sl_nthreads, 1);
+		if (lf_sl_tid >= LF_SL_MAX_THREADS) {
+			fprintf(stderr, "lock-free skiplist supports at most %d threads\n",
+					LF_SL_MAX_THREADS);
+			exit(-1);
+		}
+	}
+
+	return &p->slots[lf_sl_tid];
+}
+
+static inline void lf_sl_enter(lf_dl_skiplist_t *p)
+{
+	struct lf_sl_slot *slot = lf_sl_slot(p);
+	unsigned long epoch;
+
+	do {
+		epoch = __atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&slot->epoch, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST) != epoch);
+}
+
+static inline void lf_sl_exit(lf_dl_skiplist_t *p)
+{
+	__atomic_store_n(&lf_sl_slot(p)->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * lf_sl_try_advance - move the global epoch on
+ * if every active thread has seen the current one
+ */
+static void lf_sl_try_advance(lf_dl_skiplist_t *p)
+{
+	unsigned long epoch, slot;
+	int i, nthreads;
+
+	epoch = __atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST);
+	nthreads = __atomic_load_n(&lf_sl_nthreads, __ATOMIC_ACQUIRE);
+	if (nthreads > LF_SL_MAX_THREADS)
+		nthreads = LF_SL_MAX_THREADS;
+
+	for (i = 0; i < nthreads; i++) {
+		slot = __atomic_load_n(&p->slots[i].epoch, __ATOMIC_SEQ_CST);
+		if ((slot & 1) && (slot >> 1) != epoch)
+			return;
+	}
+
+	__atomic_compare_exchange_n(&p->epoch, &epoch, epoch + 1, 0,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * lf_sl_node_alloc - pick a node of the CPU pool whose
+ * grace period is over, to be called out of any epoch
+ */
+static struct lf_sl_node *lf_sl_node_alloc(lf_dl_skiplist_t *p, int cpu)
+{
+	struct lf_sl_node *n;
+	unsigned long epoch;
+	int i;
+
+	while (1) {
+		epoch = __atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST);
+		for (i = 0; i < LF_SL_NODES_PER_CPU; i++) {
+			n = &p->nodes[cpu * LF_SL_NODES_PER_CPU + i];
+			if (n->retired != LF_SL_IN_USE && n->retired + 2 <= epoch)
+				return n;
+		}
+		lf_sl_try_advance(p);
+		__builtin_ia32_pause();
+	}
+}
+
+/*
+ * skiplist operations, to be called inside an epoch
+ */
+
+/*
+ * lf_sl_search - fill preds and succs with the nodes
+ * surrounding the key (dline, cpu) on every level,
+ * unlinking marked nodes found on the way
+ */
+static void lf_sl_search(lf_dl_skiplist_t *p, __u64 dline, int cpu,
+		struct lf_sl_node **preds, struct lf_sl_node **succs)
+{
+	struct lf_sl_node *x, *y;
+	uintptr_t x_next, y_next;
+	int i;
+
+retry:
+	x = &p->head;
+	for (i = LF_SL_MAX_LEVEL - 1; i >= 0; i--) {
+		x_next = lf_sl_load(&x->next[i]);
+		/* x is being removed, we can't trust its links */
+		if (IS_MARKED(x_next))
+			goto retry;
+
+		for (y = PTR(x_next); y; y = PTR(y_next)) {
+			y_next = lf_sl_load(&y->next[i]);
+			/* skip the chain of logically deleted nodes */
+			while (y && IS_MARKED(y_next)) {
+				y = PTR(y_next);
+				if (y)
+					y_next = lf_sl_load(&y->next[i]);
+			}
+			if (!y || !lf_sl_before(p, y, dline, cpu))
+				break;
+			x = y;
+			x_next = y_next;
+		}
+
+		/* snip the marked nodes between x and y */
+		if (x_next != (uintptr_t)y && !lf_sl_cas(&x->next[i], x_next, (uintptr_t)y))
+			goto retry;
+
+		preds[i] = x;
+		succs[i] = y;
+	}
+}
+
+static void lf_sl_insert(lf_dl_skiplist_t *p, struct lf_sl_node *n)
+{
+	struct lf_sl_node *preds[LF_SL_MAX_LEVEL], *succs[LF_SL_MAX_LEVEL];
+	int i;
+
+	do {
+		lf_sl_search(p, n->dline, n->cpu, preds, succs);
+		__atomic_store_n(&n->next[0], (uintptr_t)succs[0], __ATOMIC_RELEASE);
+	} while (!lf_sl_cas(&preds[0]->next[0], (uintptr_t)succs[0], (uintptr_t)n));
+
+	/* the node is in, now build the index levels */
+	for (i = 1; i <= n->level; i++)
+		while (1) {
+			__atomic_store_n(&n->next[i], (uintptr_t)succs[i], __ATOMIC_RELEASE);
+			if (lf_sl_cas(&preds[i]->next[i], (uintptr_t)succs[i], (uintptr_t)n))
+				break;
+			lf_sl_search(p, n->dline, n->cpu, preds, succs);
+		}
+}
+
+static void lf_sl_remove(lf_dl_skiplist_t *p, struct lf_sl_node *n)
+{
+	struct lf_sl_node *preds[LF_SL_MAX_LEVEL], *succs[LF_SL_MAX_LEVEL];
+	int i;
+
+	/* only the owner marks, no CAS loop needed */
+	for (i = n->level; i >= 0; i--)
+		__atomic_fetch_or(&n->next[i], 1, __ATOMIC_SEQ_CST);
+
+	/*
+	 * once the search returns n is unreachable at every
+	 * level: nothing can link it again, an insertion in
+	 * front of it would need an unmarked link to it
+	 */
+	lf_sl_search(p, n->dline, n->cpu, preds, succs);
+}
+
+void lf_sl_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	unsigned int seed = 1;
+	struct lf_sl_node *n;
+	int i, err;
+
+	memset(&p->head, 0, sizeof(p->head));
+	p->head.cpu = -1;
+	p->head.level = LF_SL_MAX_LEVEL - 1;
+	p->nproc = nproc;
+	p->cmp_dl = cmp_dl;
+	/* fresh nodes must look retired long ago */
+	p->epoch = 2;
+	memset(p->slots, 0, sizeof(p->slots));
+
+	err = posix_memalign((void **)&p->nodes, sizeof(struct lf_sl_node),
+			nproc * LF_SL_NODES_PER_CPU * sizeof(struct lf_sl_node));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(p->nodes, 0, nproc * LF_SL_NODES_PER_CPU * sizeof(struct lf_sl_node));
+
+	p->rq_to_node = (struct lf_sl_node **)calloc(nproc, sizeof(*p->rq_to_node));
+	if (!p->rq_to_node) {
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	/* a node keeps the same height across reuses */
+	for (i = 0; i < nproc * LF_SL_NODES_PER_CPU; i++) {
+		n = &p->nodes[i];
+		n->cpu = i / LF_SL_NODES_PER_CPU;
+		n->retired = 0;
+		for (n->level = 0; n->level < LF_SL_MAX_LEVEL - 1 &&
+				rand_r(&seed) < LF_SL_LEVEL_PROB * RAND_MAX; n->level++)
+			;
+	}
+}
+
+void lf_sl_cleanup(void *s)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+
+	free(p->rq_to_node);
+	free(p->nodes);
+}
+
+/*
+ * lf_sl_set - update the position of a CPU, the new node
+ * is linked before the old one is removed, so that the
+ * CPU never disappears from the list while it has a deadline
+ * @s:				the skiplist
+ * @cpu:			the CPU to update
+ * @dline:		its new deadline
+ * @is_valid:	0 if the CPU leaves the list
+ */
+int lf_sl_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	struct lf_sl_node *old, *n = NULL;
+
+	if (cpu < 0 || cpu >= p->nproc) {
+		fprintf(stderr, "WARNING: lf_sl_set on CPU %d, only %d CPUs available\n",
+				cpu, p->nproc);
+		return -1;
+	}
+
+	old = p->rq_to_node[cpu];
+	if (old && is_valid && old->dline == dline)
+		return 0;
+	if (!old && !is_valid)
+		return 0;
+
+	if (is_valid) {
+		n = lf_sl_node_alloc(p, cpu);
+		n->dline = dline;
+		n->retired = LF_SL_IN_USE;
+	}
+
+	lf_sl_enter(p);
+	if (n)
+		lf_sl_insert(p, n);
+	if (old) {
+		lf_sl_remove(p, old);
+		old->retired = __atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST);
+	}
+	lf_sl_exit(p);
+
+	p->rq_to_node[cpu] = n;
+
+	return 0;
+}
+
+/*
+ * lf_sl_find - return the CPU of the first node
+ * not logically deleted, -1 if the list is empty
+ *
+ * No epoch is entered: nodes are never freed and never
+ * change CPU, at worst we return a CPU that has just moved,
+ * which the caller checks again under the runqueue lock.
+ * The walk is bounded since a recycled node may lead anywhere.
+ */
+int lf_sl_find(void *s)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	struct lf_sl_node *n;
+	uintptr_t next;
+	int i;
+
+	n = PTR(lf_sl_load(&p->head.next[0]));
+	for (i = 0; n && i < p->nproc * LF_SL_NODES_PER_CPU; i++) {
+		next = lf_sl_load(&n->next[0]);
+		if (!IS_MARKED(next))
+			break;
+		n = PTR(next);
+	}
+
+	return n ? n->cpu : -1;
+}
+
+void lf_sl_save(void *s, int nproc, FILE *f)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	struct lf_sl_node *n;
+	uintptr_t next;
+	int i;
+
+	fprintf(f, "\n----Lock-free skiplist----\n");
+
+	for (i = LF_SL_MAX_LEVEL - 1; i >= 0; i--) {
+		fprintf(f, "%d:\t", i);
+		for (next = lf_sl_load(&p->head.next[i]); PTR(next); next = lf_sl_load(&n->next[i])) {
+			n = PTR(next);
+			fprintf(f, "(%d, %llu)%s ", n->cpu, n->dline,
+					IS_MARKED(lf_sl_load(&n->next[i])) ? "*" : "");
+		}
+		fprintf(f, "\n");
+	}
+
+	for (i = 0; i < nproc; i++)
+		if (!p->rq_to_node[i])
+			fprintf(f, "[%d]:\tout of list\n", i);
+		else
+			fprintf(f, "[%d]:\t%llu\n", i, p->rq_to_node[i]->dline);
+
+	fprintf(f, "----End Lock-free skiplist----\n\n");
+}
+
+void lf_sl_print(void *s, int nproc)
+{
+	lf_sl_save(s, nproc, stdout);
+}
+
+/*
+ * lf_sl_check - to be called while no update is in
+ * progress: every level must be sorted, hold no marked
+ * node and only the nodes currently owned by CPUs
+ */
+int lf_sl_check(void *s, int nproc)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	struct lf_sl_node *n, *prev;
+	uintptr_t next;
+	int i, count, expected = 0, flag = 1;
+
+	for (i = 0; i < nproc; i++)
+		if (p->rq_to_node[i])
+			expected++;
+
+	for (i = 0; i < LF_SL_MAX_LEVEL && flag; i++) {
+		prev = NULL;
+		count = 0;
+		for (n = PTR(lf_sl_load(&p->head.next[i])); n; n = PTR(next)) {
+			next = lf_sl_load(&n->next[i]);
+			if (IS_MARKED(next)) {
+				printf("Marked node of CPU %d still linked at level %d!\n",
+					n->cpu, i);
+				flag = 0;
+				break;
+			}
+			if (p->rq_to_node[n->cpu] != n || n->level < i) {
+				printf("Stale node of CPU %d linked at level %d!\n",
+					n->cpu, i);
+				flag = 0;
+				break;
+			}
+			if (prev && !lf_sl_before(p, prev, n->dline, n->cpu)) {
+				printf("CPU %d (deadline %llu) and CPU %d (deadline %llu)"
+					" are out of order at level %d!\n", prev->cpu,
+					prev->dline, n->cpu, n->dline, i);
+				flag = 0;
+				break;
+			}
+			if (++count > expected)
+				break;
+			prev = n;
+		}
+		if (flag && !i && count != expected) {
+			printf("%d nodes in the list, %d expected!\n", count, expected);
+			flag = 0;
+		}
+	}
+
+	if (!flag)
+		lf_sl_print(s, nproc);
+
+	return flag;
+}
+
+int lf_sl_check_cpu(void *s, int cpu, __u64 dline)
+{
+	lf_dl_skiplist_t *p = (lf_dl_skiplist_t *)s;
+	struct lf_sl_node *n = p->rq_to_node[cpu];
+
+	if (!dline)
+		return n == NULL;
+
+	return n && n->dline == dline;
+}
+
+const struct data_struct_ops lf_dl_skiplist_ops = {
+	.data_init = lf_sl_init,
+	.data_cleanup = lf_sl_cleanup,
+	.data_preempt = lf_sl_set,
+	.data_finish = lf_sl_set,
+	.data_find = lf_sl_find,
+	.data_max = lf_sl_find,
+	.data_save = lf_sl_save,
+	.data_print = lf_sl_print,
+	.data_check = lf_sl_check,
+	.data_check_cpu = lf_sl_check_cpu
+};
@@ -0,0 +1,437 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lock implementations selectable at startup, so that the same
+ * binary measures how much of a backend's scaling is due to the
+ * lock rather than to the algorithm.
+ *
+ * MCS and CLH need a queue node per held lock: nodes come from a
+ * thread local free list, grown a chunk at a time and never given
+ * back, since a thread may hold many locks at once (the checker
+ * holds all the runqueue locks). The holder remembers its nodes in
+ * the lock itself, nobody else reads them.
+ */
+
+/* sched_getcpu() feature test macro */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "locks.h"
+#include "parameters.h"
+
+#define QNODE_CHUNK			32
+
+static lock_type_t lock_type = LOCK_SPIN;
+
+static const char *lock_names[] = {
+	[LOCK_SPIN] = "spin",
+	[LOCK_TAS] = "tas",
+	[LOCK_TTAS] = "ttas",
+	[LOCK_TICKET] = "ticket",
+	[LOCK_MCS] = "mcs",
+	[LOCK_CLH] = "clh",
+	[LOCK_COHORT] = "cohort"
+};
+
+static int lock_clusters = 1;
+
+static __thread struct lock_qnode *qnode_free;
+static __thread int lock_cluster = -1;
+
+int lock_select(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(lock_names) / sizeof(lock_names[0]); i++)
+		if (!strcmp(name, lock_names[i])) {
+			lock_type = (lock_type_t)i;
+			lock_clusters = (sysconf(_SC_NPROCESSORS_CONF) +
+					LOCK_COHORT_SIZE - 1) / LOCK_COHORT_SIZE;
+			if (lock_clusters < 1)
+				lock_clusters = 1;
+			return 0;
+		}
+
+	return -1;
+}
+
+const char *lock_name(void)
+{
+	return lock_names[lock_type];
+}
+
+static struct lock_qnode *qnode_get(void)
+{
+	struct lock_qnode *n;
+	int i, err;
+
+	if (!qnode_free) {
+		err = posix_memalign((void **)&n, sizeof(*n),
+				QNODE_CHUNK * sizeof(*n));
+		if (err) {
+			fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+			exit(-1);
+		}
+		memset(n, 0, QNODE_CHUNK * sizeof(*n));
+		for (i = 0; i < QNODE_CHUNK; i++) {
+			n[i].pool_next = qnode_free;
+			qnode_free = &n[i];
+		}
+	}
+
+	n = qnode_free;
+	qnode_free = n->pool_next;
+
+	return n;
+}
+
+static void qnode_put(struct lock_qnode *n)
+{
+	n->pool_next = qnode_free;
+	qnode_free = n;
+}
+
+/* cluster of the calling thread, threads are bound to a CPU */
+static inline int cohort_cluster(void)
+{
+	int cpu;
+
+	if (lock_cluster == -1) {
+		cpu = sched_getcpu();
+		lock_cluster = cpu < 0 ? 0 : (cpu / LOCK_COHORT_SIZE) % lock_clusters;
+	}
+
+	return lock_cluster;
+}
+
+/* ticket lock helpers, shared by the ticket and cohort locks */
+static inline void ticket_acquire(union lock_ticket *t)
+{
+	uint32_t me;
+
+	me = __atomic_fetch_add(&t->t.next, 1, __ATOMIC_RELAXED);
+	while (__atomic_load_n(&t->t.owner, __ATOMIC_ACQUIRE) != me)
+		cpu_relax();
+}
+
+static inline int ticket_tryacquire(union lock_ticket *t)
+{
+	union lock_ticket old, new;
+
+	old.v = __atomic_load_n(&t->v, __ATOMIC_RELAXED);
+	if (old.t.owner != old.t.next)
+		return -1;
+	new = old;
+	new.t.next++;
+
+	return __atomic_compare_exchange_n(&t->v, &old.v, new.v, 0,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ? 0 : -1;
+}
+
+static inline void ticket_release(union lock_ticket *t)
+{
+	__atomic_store_n(&t->t.owner, t->t.owner + 1, __ATOMIC_RELEASE);
+}
+
+static inline int ticket_waiters(union lock_ticket *t)
+{
+	return __atomic_load_n(&t->t.next, __ATOMIC_RELAXED) - t->t.owner > 1;
+}
+
+void lock_init(lock_t *l)
+{
+	int err;
+
+	memset(l, 0, sizeof(*l));
+
+	switch (lock_type) {
+		case LOCK_SPIN:
+			pthread_spin_init(&l->u.spin, 0);
+			break;
+		case LOCK_CLH:
+			/* the queue starts with a released node */
+			l->u.queue.tail = qnode_get();
+			l->u.queue.tail->locked = 0;
+			break;
+		case LOCK_COHORT:
+			err = posix_memalign((void **)&l->u.cohort.local,
+					sizeof(*l->u.cohort.local),
+					lock_clusters * sizeof(*l->u.cohort.local));
+			if (err) {
+				fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+				exit(-1);
+			}
+			memset(l->u.cohort.local, 0,
+					lock_clusters * sizeof(*l->u.cohort.local));
+			break;
+		default:
+			break;
+	}
+}
+
+void lock_destroy(lock_t *l)
+{
+	switch (lock_type) {
+		case LOCK_SPIN:
+			pthread_spin_destroy(&l->u.spin);
+			break;
+		case LOCK_COHORT:
+			free(l->u.cohort.local);
+			break;
+		default:
+			/* CLH nodes stay in the thread pools */
+			break;
+	}
+}
+
+static void mcs_acquire(lock_t *l)
+{
+	struct lock_qnode *n, *pred;
+
+	n = qnode_get();
+	n->next = NULL;
+	n->locked = 1;
+	pred = __atomic_exchange_n(&l->u.queue.tail, n, __ATOMIC_ACQ_REL);
+	if (pred) {
+		__atomic_store_n(&pred->next, n, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&n->locked, __ATOMIC_ACQUIRE))
+			cpu_relax();
+	}
+	l->u.queue.holder = n;
+}
+
+static void mcs_release(lock_t *l)
+{
+	struct lock_qnode *n = l->u.queue.holder, *next, *expected = n;
+
+	next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE);
+	if (!next) {
+		if (__atomic_compare_exchange_n(&l->u.queue.tail, &expected, NULL,
+					0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			qnode_put(n);
+			return;
+		}
+		/* a successor is linking itself */
+		while (!(next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)))
+			cpu_relax();
+	}
+	__atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+	qnode_put(n);
+}
+
+static int mcs_tryacquire(lock_t *l)
+{
+	struct lock_qnode *n, *expected = NULL;
+
+	n = qnode_get();
+	n->next = NULL;
+	n->locked = 0;
+	if (!__atomic_compare_exchange_n(&l->u.queue.tail, &expected, n, 0,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		qnode_put(n);
+		return -1;
+	}
+	l->u.queue.holder = n;
+
+	return 0;
+}
+
+static void clh_acquire(lock_t *l)
+{
+	struct lock_qnode *n, *pred;
+
+	n = qnode_get();
+	n->locked = 1;
+	pred = __atomic_exchange_n(&l->u.queue.tail, n, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE))
+		cpu_relax();
+	l->u.queue.holder = n;
+	l->u.queue.holder_pred = pred;
+}
+
+static void clh_release(lock_t *l)
+{
+	struct lock_qnode *n = l->u.queue.holder, *pred = l->u.queue.holder_pred;
+
+	__atomic_store_n(&n->locked, 0, __ATOMIC_RELEASE);
+	/* our node now belongs to the successor, we take the predecessor's */
+	qnode_put(pred);
+}
+
+static int clh_tryacquire(lock_t *l)
+{
+	struct lock_qnode *n, *pred;
+
+	pred = __atomic_load_n(&l->u.queue.tail, __ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE))
+		return -1;
+
+	n = qnode_get();
+	n->locked = 1;
+	if (!__atomic_compare_exchange_n(&l->u.queue.tail, &pred, n, 0,
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+		qnode_put(n);
+		return -1;
+	}
+	/* pred may have been recycled and taken again meanwhile */
+	while (__atomic_load_n(&pred->locked, __ATOMIC_ACQUIRE))
+		cpu_relax();
+	l->u.queue.holder = n;
+	l->u.queue.holder_pred = pred;
+
+	return 0;
+}
+
+/*
+ * cohort lock: the first thread of a cluster takes the global
+ * lock, on release it is handed to the next waiter of the same
+ * cluster, if any, up to LOCK_COHORT_PASSES times in a row
+ */
+static void cohort_acquire(lock_t *l)
+{
+	int c = cohort_cluster();
+	struct lock_cohort_local *local = &l->u.cohort.local[c];
+
+	ticket_acquire(&local->ticket);
+	if (!local->global_owned)
+		ticket_acquire(&l->u.cohort.global);
+	l->u.cohort.holder_cluster = c;
+}
+
+static int cohort_tryacquire(lock_t *l)
+{
+	int c = cohort_cluster();
+	struct lock_cohort_local *local = &l->u.cohort.local[c];
+
+	if (ticket_tryacquire(&local->ticket))
+		return -1;
+	if (!local->global_owned && ticket_tryacquire(&l->u.cohort.global)) {
+		ticket_release(&local->ticket);
+		return -1;
+	}
+	l->u.cohort.holder_cluster = c;
+
+	return 0;
+}
+
+static void cohort_release(lock_t *l)
+{
+	struct lock_cohort_local *local = &l->u.cohort.local[l->u.cohort.holder_cluster];
+
+	if (ticket_waiters(&local->ticket) && local->passes < LOCK_COHORT_PASSES) {
+		local->passes++;
+		local->global_owned = 1;
+	} else {
+		local->passes = 0;
+		local->global_owned = 0;
+		ticket_release(&l->u.cohort.global);
+	}
+	ticket_release(&local->ticket);
+}
+
+void lock_acquire(lock_t *l)
+{
+	int backoff, i;
+
+	switch (lock_type) {
+		case LOCK_SPIN:
+			pthread_spin_lock(&l->u.spin);
+			break;
+		case LOCK_TAS:
+			while (__atomic_exchange_n(&l->u.tas, 1, __ATOMIC_ACQUIRE))
+				cpu_relax();
+			break;
+		case LOCK_TTAS:
+			backoff = LOCK_BACKOFF_MIN;
+			while (__atomic_load_n(&l->u.tas, __ATOMIC_RELAXED) ||
+					__atomic_exchange_n(&l->u.tas, 1, __ATOMIC_ACQUIRE)) {
+				for (i = 0; i < backoff; i++)
+					cpu_relax();
+				if (backoff < LOCK_BACKOFF_MAX)
+					backoff <<= 1;
+			}
+			break;
+		case LOCK_TICKET:
+			ticket_acquire(&l->u.ticket);
+			break;
+		case LOCK_MCS:
+			mcs_acquire(l);
+			break;
+		case LOCK_CLH:
+			clh_acquire(l);
+			break;
+		case LOCK_COHORT:
+			cohort_acquire(l);
+			break;
+	}
+}
+
+int lock_tryacquire(lock_t *l)
+{
+	switch (lock_type) {
+		case LOCK_SPIN:
+			return pthread_spin_trylock(&l->u.spin) ? -1 : 0;
+		case LOCK_TAS:
+		case LOCK_TTAS:
+			if (__atomic_load_n(&l->u.tas, __ATOMIC_RELAXED))
+				return -1;
+			return __atomic_exchange_n(&l->u.tas, 1, __ATOMIC_ACQUIRE) ? -1 : 0;
+		case LOCK_TICKET:
+			return ticket_tryacquire(&l->u.ticket);
+		case LOCK_MCS:
+			return mcs_tryacquire(l);
+		case LOCK_CLH:
+			return clh_tryacquire(l);
+		case LOCK_COHORT:
+			return cohort_tryacquire(l);
+	}
+
+	return -1;
+}
+
+void lock_release(lock_t *l)
+{
+	switch (lock_type) {
+		case LOCK_SPIN:
+			pthread_spin_unlock(&l->u.spin);
+			break;
+		case LOCK_TAS:
+		case LOCK_TTAS:
+			__atomic_store_n(&l->u.tas, 0, __ATOMIC_RELEASE);
+			break;
+		case LOCK_TICKET:
+			ticket_release(&l->u.ticket);
+			break;
+		case LOCK_MCS:
+			mcs_release(l);
+			break;
+		case LOCK_CLH:
+			clh_release(l);
+			break;
+		case LOCK_COHORT:
+			cohort_release(l);
+			break;
+	}
+}
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 
 #include "measure.h"
 #include "parameters.h"
@@ -99,6 +100,9 @@
 /* tsc_cost global variables */
 TICKS_TYPE tsc_cost[NR_CPUS];
 
+/* cycles simulated by each CPU, 0 means NCYCLES */
+SAMPLES_TYPE simulated_cycles[NR_CPUS];
+
 /*
  * alloc_samples_array - alloc memory for
  * samples array
@@ -287,9 +291,9 @@ void measure_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *elapse
 	long long unsigned i;
 
 	//fprintf(out, "[%d]: %s results\n", cpu, variable_name);
-	//fprintf(out, "total number:\t%lu\n", n_all[cpu]);
+	//fprintf(out, "total number:\t%llu\n", n_all[cpu]);
 	for(i = 0; i < n_all[cpu] && i < SAMPLES_MAX; i++)
-		fprintf(out, "%7lu\n", elapsed[cpu][i]);
+		fprintf(out, "%7llu\n", elapsed[cpu][i]);
 }
 
 /*
@@ -303,8 +307,8 @@ void measure_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *elapse
 void outcome_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *n_success, SAMPLES_TYPE *n_fail)
 {
 	fprintf(out, "[%d]: %s outcome\n", cpu, variable_name);
-	fprintf(out, "%s successful:\t%lu\n", variable_name, n_success[cpu]);
-	fprintf(out, "%s failed:\t%lu\n", variable_name, n_fail[cpu]);
+	fprintf(out, "%s successful:\t%llu\n", variable_name, n_success[cpu]);
+	fprintf(out, "%s failed:\t%llu\n", variable_name, n_fail[cpu]);
 }
 
 /*
@@ -317,7 +321,65 @@ void outcome_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *n_succ
 void account_print(FILE *out, char *variable_name, int cpu, SAMPLES_TYPE *n_all)
 {
 	double cycle_period_secs = (double)CYCLE_LEN / 1000000;
+	SAMPLES_TYPE cycles = simulated_cycles[cpu] ? simulated_cycles[cpu] : NCYCLES;
+
+	fprintf(out, "[%d]: %s occurences: %llu\n", cpu, variable_name, n_all[cpu]);
+	fprintf(out, "[%d]: %s rate: %.0lf event/s\n", cpu, variable_name, n_all[cpu] / (cycles * cycle_period_secs));
+}
+
+static int samples_compare(const void *a, const void *b)
+{
+	SAMPLES_TYPE first = *(SAMPLES_TYPE *)a;
+	SAMPLES_TYPE second = *(SAMPLES_TYPE *)b;
+
+	return (first > second) - (first < second);
+}
+
+/*
+ * measure_converged - return 1 if the steady state
+ * EARLY_STOP_PERCENTILE of samples is known with a
+ * relative confidence interval narrower than
+ * EARLY_STOP_CI_WIDTH, 0 otherwise.
+ * The interval comes from the order statistics
+ * bounding the percentile rank
+ * @samples:			samples, in recording order
+ * @n_all:				number of samples
+ */
+int measure_converged(SAMPLES_TYPE *samples, SAMPLES_TYPE n_all)
+{
+	SAMPLES_TYPE start, n;
+	SAMPLES_TYPE *sorted;
+	double p = EARLY_STOP_PERCENTILE, rank, spread;
+	long long low, high;
+	int converged;
+
+	if(n_all > SAMPLES_MAX)
+		n_all = SAMPLES_MAX;
+
+	start = steady_state_start(samples, n_all);
+	n = n_all - start;
+	if(!n)
+		return 0;
+
+	rank = n * p;
+	spread = EARLY_STOP_Z * sqrt(n * p * (1 - p));
+	low = (long long)floor(rank - spread);
+	high = (long long)ceil(rank + spread);
+	/* not enough samples to bound the percentile yet */
+	if(low < 0 || high >= (long long)n)
+		return 0;
+
+	sorted = (SAMPLES_TYPE *)malloc(n * sizeof(*sorted));
+	if(!sorted){
+		fprintf(stderr, "malloc(): %s\n", strerror(errno));
+		exit(1);
+	}
+	memcpy(sorted, &samples[start], n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), samples_compare);
+
+	converged = (sorted[high] - sorted[low]) <= EARLY_STOP_CI_WIDTH * sorted[(SAMPLES_TYPE)rank];
+
+	free(sorted);
 
-	fprintf(out, "[%d]: %s occurences: %lu\n", cpu, variable_name, n_all[cpu]);
-	fprintf(out, "[%d]: %s rate: %.0lf event/s\n", cpu, variable_name, n_all[cpu] / (NCYCLES * cycle_period_secs));
+	return converged;
 }
@@ -0,0 +1,265 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MultiQueue: CPUs are split over MQ_CPUS_PER_QUEUE sized array
+ * heaps, a CPU always updates its home heap and find returns the
+ * better root of two heaps picked at random. The answer is only
+ * approximately the best CPU, find_lock_later_rq() and pull()
+ * check it again under the runqueue lock anyway.
+ *
+ * Every MQ_QUALITY_PERIOD finds the answer is compared with the
+ * exact one (best root of all heaps): the share of exact answers
+ * and the mean deadline gap are printed at cleanup. The comparison
+ * scans every heap, so it is left out when finds are measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/types.h>
+
+#include "multiqueue.h"
+#include "array_heap.h"
+#include "common_ops.h"
+#include "parameters.h"
+#include "measure.h"
+
+#if MQ_QUALITY_PERIOD > 0 && \
+	!defined(MEASURE_PUSH_FIND) && !defined(MEASURE_PULL_FIND)
+#define MQ_ACCOUNT
+#endif
+
+static __thread unsigned int mq_seed;
+#ifdef MQ_ACCOUNT
+static __thread unsigned int mq_finds;
+#endif
+
+static inline int mq_queue_of(int cpu)
+{
+	return cpu / MQ_CPUS_PER_QUEUE;
+}
+
+static inline int mq_local_of(int cpu)
+{
+	return cpu % MQ_CPUS_PER_QUEUE;
+}
+
+/*
+ * mq_queue_find - best CPU of a queue and its deadline,
+ * -1 if the queue is empty
+ */
+static inline int mq_queue_find(mq_t *m, int q, __u64 *dline)
+{
+	int local;
+
+	local = array_heap_find_dl(&m->queues[q].heap, dline);
+	if (local == -1)
+		return -1;
+
+	return q * MQ_CPUS_PER_QUEUE + local;
+}
+
+/*
+ * mq_better - return 1 if the deadline b is a better
+ * answer than a, with heaps' convention: the root r is
+ * the one for which cmp_dl(other, r) holds
+ */
+static inline int mq_better(mq_t *m, __u64 a, __u64 b)
+{
+	return m->cmp_dl(a, b);
+}
+
+#ifdef MQ_ACCOUNT
+static void mq_account(mq_t *m, int cpu, __u64 dline)
+{
+	__u64 best_dl = 0, dl;
+	int q, best = -1, c;
+
+	for (q = 0; q < m->nqueues; q++) {
+		c = mq_queue_find(m, q, &dl);
+		if (c != -1 && (best == -1 || mq_better(m, best_dl, dl))) {
+			best = c;
+			best_dl = dl;
+		}
+	}
+
+	__atomic_fetch_add(&m->sampled, 1, __ATOMIC_RELAXED);
+	if (cpu == best || (cpu != -1 && dline == best_dl))
+		__atomic_fetch_add(&m->exact, 1, __ATOMIC_RELAXED);
+	else if (cpu != -1 && best != -1)
+		__atomic_fetch_add(&m->gap, dline > best_dl ? dline - best_dl :
+				best_dl - dline, __ATOMIC_RELAXED);
+}
+#endif
+
+void mq_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	mq_t *m = (mq_t *)s;
+	int q, err;
+
+	m->nproc = nproc;
+	m->cmp_dl = cmp_dl;
+	m->nqueues = (nproc + MQ_CPUS_PER_QUEUE - 1) / MQ_CPUS_PER_QUEUE;
+	m->sampled = m->exact = m->gap = 0;
+
+	err = posix_memalign((void **)&m->queues, sizeof(*m->queues),
+			m->nqueues * sizeof(*m->queues));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+
+	for (q = 0; q < m->nqueues; q++)
+		array_heap_init(&m->queues[q].heap, MQ_CPUS_PER_QUEUE, cmp_dl);
+}
+
+void mq_cleanup(void *s)
+{
+	mq_t *m = (mq_t *)s;
+	int q;
+
+	if (m->sampled)
+		printf("MultiQueue (%s first): %llu finds sampled, %.2f%% exact,"
+			" mean deadline gap %.2f\n",
+			m->cmp_dl == __dl_time_before ? "latest" : "earliest",
+			m->sampled, 100.0 * m->exact / m->sampled,
+			(double)m->gap / m->sampled);
+
+	for (q = 0; q < m->nqueues; q++)
+		array_heap_cleanup(&m->queues[q].heap);
+	free(m->queues);
+}
+
+int mq_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	mq_t *m = (mq_t *)s;
+
+	if (cpu < 0 || cpu >= m->nproc) {
+		fprintf(stderr, "WARNING: mq_set on CPU %d, only %d CPUs available\n",
+				cpu, m->nproc);
+		return -1;
+	}
+
+	return heap_set(&m->queues[mq_queue_of(cpu)].heap, mq_local_of(cpu),
+			dline, is_valid);
+}
+
+/*
+ * mq_find_dl - return the better of the best CPUs of
+ * two random queues, -1 if both are empty
+ * @s:			the MultiQueue
+ * @dline:	where to store the deadline of the CPU found
+ */
+int mq_find_dl(void *s, __u64 *dline)
+{
+	mq_t *m = (mq_t *)s;
+	int a, b, cpu_a, cpu_b, cpu;
+	__u64 dl_a, dl_b;
+
+	if (!mq_seed)
+		mq_seed = time(NULL) ^ (unsigned long)&mq_seed;
+
+	a = rand_r(&mq_seed) % m->nqueues;
+	cpu_a = mq_queue_find(m, a, &dl_a);
+	if (m->nqueues > 1) {
+		b = rand_r(&mq_seed) % (m->nqueues - 1);
+		if (b >= a)
+			b++;
+		cpu_b = mq_queue_find(m, b, &dl_b);
+		if (cpu_a == -1 || (cpu_b != -1 && mq_better(m, dl_a, dl_b))) {
+			cpu_a = cpu_b;
+			dl_a = dl_b;
+		}
+	}
+
+	cpu = cpu_a;
+	*dline = cpu == -1 ? 0 : dl_a;
+
+#ifdef MQ_ACCOUNT
+	if (++mq_finds % MQ_QUALITY_PERIOD == 0)
+		mq_account(m, cpu, *dline);
+#endif
+
+	return cpu;
+}
+
+int mq_find(void *s)
+{
+	__u64 dline;
+
+	return mq_find_dl(s, &dline);
+}
+
+void mq_save(void *s, int nproc, FILE *f)
+{
+	mq_t *m = (mq_t *)s;
+	int q;
+
+	fprintf(f, "MultiQueue (%d queues):\n", m->nqueues);
+	for (q = 0; q < m->nqueues; q++) {
+		fprintf(f, "Queue %d, CPUs %d-%d: ", q, q * MQ_CPUS_PER_QUEUE,
+				q * MQ_CPUS_PER_QUEUE + MQ_CPUS_PER_QUEUE - 1);
+		array_heap_save(&m->queues[q].heap, MQ_CPUS_PER_QUEUE, f);
+	}
+}
+
+void mq_print(void *s, int nproc)
+{
+	mq_save(s, nproc, stdout);
+}
+
+int mq_check(void *s, int nproc)
+{
+	mq_t *m = (mq_t *)s;
+	int q;
+
+	for (q = 0; q < m->nqueues; q++)
+		if (!array_heap_check(&m->queues[q].heap, MQ_CPUS_PER_QUEUE)) {
+			printf("Queue %d check failed!\n", q);
+			mq_print(s, nproc);
+			return 0;
+		}
+
+	return 1;
+}
+
+int mq_check_cpu(void *s, int cpu, __u64 dline)
+{
+	mq_t *m = (mq_t *)s;
+
+	return array_heap_check_cpu(&m->queues[mq_queue_of(cpu)].heap,
+			mq_local_of(cpu), dline);
+}
+
+const struct data_struct_ops mq_ops = {
+	.data_init = mq_init,
+	.data_cleanup = mq_cleanup,
+	.data_preempt = mq_set,
+	.data_finish = mq_set,
+	.data_find = mq_find,
+	.data_find_dl = mq_find_dl,
+	.data_max = mq_find,
+	.data_save = mq_save,
+	.data_print = mq_print,
+	.data_check = mq_check,
+	.data_check_cpu = mq_check_cpu
+};
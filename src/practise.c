@@ -34,13 +34,25 @@
 
 #include "heap.h"
 #include "array_heap.h"
+#include "cpudl.h"
+#include "tournament_tree.h"
+#include "flat_array.h"
+#include "hierarchical.h"
+#include "fc_wrapper.h"
+#include "adaptive.h"
+#include "delegation.h"
+#include "locks.h"
+#include "multiqueue.h"
+#include "calendar.h"
+#include "lazy_dl_skiplist.h"
 #include "dl_skiplist.h"
 #include "fc_dl_skiplist.h"
+#include "lf_dl_skiplist.h"
 #include "bm_fc_skiplist.h" 
 #include "common_ops.h"
 #include "kernel_data_struct.h"
 #include "cpupri.h"
-#include "rq_heap.h"
+#include "rq_queue.h"
 #include "measure.h"
 #include "parameters.h"
 
@@ -56,9 +68,42 @@ heap_t pull_heap;
 array_heap_t push_array_heap;
 array_heap_t pull_array_heap;
 
+cpudl_t push_cpudl;
+cpudl_t pull_cpudl;
+
+tournament_tree_t push_tournament_tree;
+tournament_tree_t pull_tournament_tree;
+
+flat_array_t push_flat_array;
+flat_array_t pull_flat_array;
+
+hier_t push_hier;
+hier_t pull_hier;
+
+fcw_t push_fcw;
+fcw_t pull_fcw;
+
+adapt_t push_adapt;
+adapt_t pull_adapt;
+
+deleg_t push_deleg;
+deleg_t pull_deleg;
+
+mq_t push_mq;
+mq_t pull_mq;
+
+cal_t push_calendar;
+cal_t pull_calendar;
+
+lazy_dl_skiplist_t push_lazy_skiplist;
+lazy_dl_skiplist_t pull_lazy_skiplist;
+
 dl_skiplist_t push_dl_skiplist;
 dl_skiplist_t pull_dl_skiplist;
 
+lf_dl_skiplist_t push_lf_skiplist;
+lf_dl_skiplist_t pull_lf_skiplist;
+
 fc_dl_skiplist_t push_fc_skiplist;
 fc_dl_skiplist_t pull_fc_skiplist;
 
@@ -71,6 +116,10 @@ unsigned int barrier_count;
 int simulation_start, simulation_end;
 int last_pid = 0; /* operations on this MUST be ATOMIC */
 int online_cpus;
+#ifdef EARLY_STOP
+/* set by the main thread, read by the simulated CPUs */
+int simulation_converged;
+#endif
 
 /*
  * global data structures for push
@@ -81,18 +130,42 @@ struct data_struct_ops *dso;
 void *push_data_struct, *pull_data_struct;
 
 extern struct data_struct_ops array_heap_ops;
+extern struct data_struct_ops cpudl_ops;
+extern struct data_struct_ops tournament_tree_ops;
+extern struct data_struct_ops flat_array_ops;
+extern struct data_struct_ops hier_ops;
+extern struct data_struct_ops fcw_ops;
+extern struct data_struct_ops adapt_ops;
+extern struct data_struct_ops deleg_ops;
+extern struct data_struct_ops mq_ops;
+extern struct data_struct_ops calendar_ops;
+extern struct data_struct_ops lazy_dl_skiplist_ops;
+
+/*
+ * backend wrapped by the hierarchical, flat combining, adaptive
+ * or delegation data structure and comparison functions it expects
+ */
+struct data_struct_ops *leaf_dso;
+int (*leaf_push_cmp)(__u64 a, __u64 b);
+int (*leaf_pull_cmp)(__u64 a, __u64 b);
 extern struct data_struct_ops heap_ops;
 extern struct data_struct_ops dl_skiplist_ops;
+extern struct data_struct_ops lf_dl_skiplist_ops;
 extern struct data_struct_ops fc_dl_skiplist_ops;
 extern struct data_struct_ops bm_fc_skiplist_ops;
 
 struct rq *cpu_to_rq[NR_CPUS];
 
+#ifdef SCHED_DEADLINE
+/* the only runqueue in global EDF mode */
+struct global_rq grq;
+#endif
+
 #ifdef SCHED_RT
 	struct root_domain rd;
 #endif
 
-typedef enum {HEAP=0, ARRAY_HEAP=1, SKIPLIST=2, FC_SKIPLIST=3, BM_FC_SKIPLIST=4} data_struct_t;
+typedef enum {HEAP=0, ARRAY_HEAP=1, SKIPLIST=2, FC_SKIPLIST=3, BM_FC_SKIPLIST=4, CPUDL=5, TOURNAMENT_TREE=6, LF_SKIPLIST=7, FLAT_ARRAY=8, HIERARCHICAL=9, MULTIQUEUE=10, CALENDAR=11, LAZY_SKIPLIST=12, FC_WRAPPER=13, ADAPTIVE=14, DELEGATION=15, GLOBAL_EDF=16} data_struct_t;
 typedef enum {ARRIVAL=0, FINISH=1, NOTHING=2} operation_t;
 /*
  * 20% probability of new arrival
@@ -210,10 +283,13 @@ void signal_handler(int sig)
 	int i;
 	printf("\nEXITING!\n");
 
-	printf("----Push Data Structure----\n");
-	dso->data_print(push_data_struct, online_cpus);
-	printf("----Pull Data Structure----\n");
-	dso->data_print(pull_data_struct, online_cpus);
+	/* no push and pull data structures in global EDF mode */
+	if (dso) {
+		printf("----Push Data Structure----\n");
+		dso->data_print(push_data_struct, online_cpus);
+		printf("----Pull Data Structure----\n");
+		dso->data_print(pull_data_struct, online_cpus);
+	}
 	for (i = 0; i < online_cpus; i++) 
 		printf("Index %d, ID %ld\n", i, (threads[i] % 100));
 	exit(-1);
@@ -228,7 +304,6 @@ void *processor(void *arg)
 	int index = *((int*)arg);
 	int i, is_valid = 0, res;
 	struct rq rq;
-	struct rq_heap_node *min, *node;
 	struct task_struct *min_tsk, *new_tsk;
 	operation_t op;
 	struct timespec t_sleep, t_period;
@@ -304,7 +379,12 @@ void *processor(void *arg)
 	clock_gettime(CLOCK_MONOTONIC, &t_sleep);
 
 	/* simulation cycles */
+#ifdef EARLY_STOP
+	for (i = 0; i < NCYCLES &&
+			!__atomic_load_n(&simulation_converged, __ATOMIC_RELAXED); i++) {
+#else
 	for (i = 0; i < NCYCLES; i++) {
+#endif
 #ifdef MEASURE_CYCLE
 	MEASURE_START(cycle, index)
 #endif
@@ -320,9 +400,8 @@ void *processor(void *arg)
 		 * peek for the earliest deadline 
 		 * (or highest priority) task 
 		 */
-		min = rq_peek(&rq);
-		if (min != NULL) {
-			min_tsk = rq_heap_node_value(min);
+		min_tsk = rq_peek(&rq);
+		if (min_tsk != NULL) {
 #ifdef SCHED_DEADLINE
 			min_dl = min_tsk->deadline;
 #endif
@@ -333,19 +412,17 @@ void *processor(void *arg)
 
 #ifdef SCHED_DEADLINE
 		/* if min_dl is earlier than curr_clock we have a finish */
-		if (min != NULL && __dl_time_before(min_dl, curr_clock)) {
+		if (min_tsk != NULL && __dl_time_before(min_dl, curr_clock)) {
 #endif
 #ifdef SCHED_RT
 		/* if runtime is 0 we have a finish */
-		if (min != NULL && !curr_runtime) {
+		if (min_tsk != NULL && !curr_runtime) {
 #endif
 			/*
 			 * remove task from rq
 			 * task finish
 			 */
-			node = rq_take(&rq);
-			free((struct task *)rq_heap_node_value(node));
-			free(node);
+			free(rq_take(&rq));
 
 #ifdef SCHED_DEADLINE
 			min_dl = 0;
@@ -354,9 +431,8 @@ void *processor(void *arg)
 			highest_prio = CPUPRI_INVALID;
 #endif
 			is_valid = 0;
-			min = rq_peek(&rq);
-			if (min != NULL) {
-				min_tsk = rq_heap_node_value(min);
+			min_tsk = rq_peek(&rq);
+			if (min_tsk != NULL) {
 #ifdef SCHED_DEADLINE
 				min_dl = min_tsk->deadline;
 #endif
@@ -448,8 +524,8 @@ void *processor(void *arg)
 			}
 		} else if (op == FINISH) {
 			/* we have a finish */
-			min = rq_peek(&rq);
-			if (min != NULL) {
+			min_tsk = rq_peek(&rq);
+			if (min_tsk != NULL) {
 				/*
 				 * if rq is not empty take the first
 				 * task
@@ -458,9 +534,7 @@ void *processor(void *arg)
 				printf("[%d]: task finishes early\n", index);
 #endif
 				num_early_finish[index]++;
-				node = rq_take(&rq);
-				free((struct task_struct *)rq_heap_node_value(node));
-				free(node);
+				free(rq_take(&rq));
 
 				/*
 				 * than see if the next task is to be scheduled
@@ -473,9 +547,8 @@ void *processor(void *arg)
 				highest_prio = CPUPRI_INVALID;
 #endif
 				is_valid = 0;
-				min = rq_peek(&rq);
-				if (min != NULL) {					
-					min_tsk = rq_heap_node_value(min);
+				min_tsk = rq_peek(&rq);
+				if (min_tsk != NULL) {					
 #ifdef SCHED_DEADLINE
 					min_dl = min_tsk->deadline;
 #endif
@@ -519,9 +592,8 @@ void *processor(void *arg)
 		 * we have to decrement task runtime 
 		 * before releasing the lock 
 		 */
-		min = rq_peek(&rq);
-		if (min != NULL) {					
-			min_tsk = rq_heap_node_value(min);
+		min_tsk = rq_peek(&rq);
+		if (min_tsk != NULL) {					
 			min_tsk->runtime = min_tsk->runtime > 0 ? min_tsk->runtime-- : 0;
 		}
 #endif
@@ -544,6 +616,10 @@ void *processor(void *arg)
 #endif
 	}
 
+#ifdef MEASURE
+	simulated_cycles[index] = i;
+#endif
+
 #ifdef SCHED_DEADLINE
 	/* 
 	 * this cpu has finished simulation
@@ -582,6 +658,152 @@ void *processor(void *arg)
 	return 0;
 }
 
+#ifdef SCHED_DEADLINE
+/*
+ * global_processor - thread body for threads simulating CPUs
+ * that share a single global runqueue (global EDF): same
+ * workload as processor(), but no push and no pull, a new
+ * task goes straight to the CPU it has to run on
+ * @arg: a pointer to a thread argument structure
+ */
+void *global_processor(void *arg)
+{
+	int index = *((int*)arg);
+	int i, res, preempted, cpu;
+	struct task_struct *curr, *new_tsk;
+	operation_t op;
+	struct timespec t_sleep, t_period;
+	cpu_set_t mask;
+	__u64 new_dl, curr_clock = 0;
+
+	CPU_ZERO(&mask);
+	CPU_SET(index, &mask);
+	res = sched_setaffinity(0, sizeof(mask), &mask);
+	if (res != 0) {
+		fprintf(stderr, "WARNING: cannot set processor %d affinity!\n", index);
+		exit(-1);
+	}
+
+#ifdef MEASURE
+	set_tsc_cost(index);
+#endif
+
+	t_period = usec_to_timespec(CYCLE_LEN);
+
+	/* simulation start barrier */
+	__sync_fetch_and_add(&barrier_count, 1);
+
+	if(barrier_count == online_cpus)
+		sem_post(&start_barrier_sem);
+
+	sem_wait(&start_barrier_sem);
+	sem_post(&start_barrier_sem);
+
+	/* set simulation_start flag to signal checker */
+	__sync_fetch_and_add(&simulation_start, 1);
+
+	/* get current time */
+	clock_gettime(CLOCK_MONOTONIC, &t_sleep);
+
+	/* simulation cycles */
+#ifdef EARLY_STOP
+	for (i = 0; i < NCYCLES &&
+			!__atomic_load_n(&simulation_converged, __ATOMIC_RELAXED); i++) {
+#else
+	for (i = 0; i < NCYCLES; i++) {
+#endif
+#ifdef MEASURE_CYCLE
+	MEASURE_START(cycle, index)
+#endif
+		curr_clock++;
+
+		/* lock the global runqueue */
+		grq_lock(&grq);
+
+		/* the task running here reached its deadline */
+		curr = grq_curr(&grq, index);
+		if (curr != NULL && __dl_time_before(curr->deadline, curr_clock)) {
+			if (grq_finish(&grq, index))
+				num_pull[index]++;
+			else
+				num_empty[index]++;
+			num_finish[index]++;
+		}
+
+		/* select an operation at random */
+		op = select_operation();
+
+		if (op == ARRIVAL) {
+			num_arrivals[index]++;
+			new_dl = arrival_process(curr_clock);
+			PRINT_OP(index, "arrival", new_dl);
+			new_tsk = (struct task_struct *)malloc(sizeof(*new_tsk));
+			if(!new_tsk){
+				fprintf(stderr, "out of memory!\n");
+				fflush(stderr);
+				exit(1);
+			}
+			task_init(new_tsk, new_dl, __sync_fetch_and_add( &last_pid, 1 ));
+
+			/*
+			 * the task runs where it preempts, or on an idle
+			 * CPU: a CPU other than this one counts as a push
+			 */
+			cpu = grq_add_task(&grq, index, new_tsk, &preempted);
+			if (preempted)
+				num_preemptions[index]++;
+			if (cpu != -1 && cpu != index)
+				num_push[index]++;
+		} else if (op == FINISH) {
+			/* the task running here finishes early */
+			if (grq_curr(&grq, index) != NULL) {
+				num_early_finish[index]++;
+				if (grq_finish(&grq, index))
+					num_pull[index]++;
+				else
+					num_empty[index]++;
+			}
+		}
+
+		/* global runqueue lock release */
+		grq_unlock(&grq);
+
+		/* sleep for remaining time in t_period */
+		t_sleep = timespec_add(&t_sleep, &t_period);
+#ifdef MEASURE_SLEEP
+		MEASURE_START(sleep, index)
+#endif
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t_sleep, NULL);
+#ifdef MEASURE_SLEEP
+		MEASURE_END(sleep, index)
+#endif
+
+#ifdef MEASURE_CYCLE
+		MEASURE_END(cycle, index)
+#endif
+	}
+
+#ifdef MEASURE
+	simulated_cycles[index] = i;
+#endif
+
+	/* simulation end barrier */
+	__sync_fetch_and_sub(&barrier_count, 1);
+
+	__sync_synchronize();
+	if(barrier_count == 0)
+		sem_post(&end_barrier_sem);
+
+	sem_wait(&end_barrier_sem);
+	sem_post(&end_barrier_sem);
+
+	/* set simulation_end flag to signal checker */
+	__sync_fetch_and_add(&simulation_end, 1);
+
+	return 0;
+}
+#endif /* SCHED_DEADLINE */
+
 /* 
  * checker - thread body of thread that check all data
  * structures integrity
@@ -747,6 +969,177 @@ void *checker(void *arg)
 	return NULL;
 }
 
+#ifdef SCHED_DEADLINE
+/*
+ * global_checker - thread body of the thread that checks
+ * the global runqueue integrity
+ * @arg:		a pointer to a thread argument structure
+ */
+void *global_checker(void *arg)
+{
+	int count = 0;
+	FILE *error_log;
+	int error = 0;
+
+	error_log = fopen("error_log.txt", "w");
+	if(!error_log){
+		perror("error while opening error log file");
+		exit(1);
+	}
+
+	while(1) {
+		/* simulation terminated? */
+		if(simulation_end)
+			break;
+
+		/* checker wait interval */
+		usleep(50000);
+
+		/* simulation started? */
+		if(!simulation_start)
+			continue;
+
+		/* printf checking pass number */
+		fprintf(stderr, "%d) Checker: OK!\r", ++count);
+
+		grq_lock(&grq);
+		if(!grq_check(&grq)){
+			fprintf(error_log, "\n***** grq_check found errors on global runqueue *****\n\n");
+			grq_print(&grq, error_log);
+			error = 1;
+		}
+		grq_unlock(&grq);
+
+		if(error){
+#ifdef EXIT_ON_ERRORS
+			break;
+#else
+			fprintf(stderr, "\nchecker found errors, see error_log.txt for details...\n");
+			error = 0;
+#endif
+		}
+	}
+
+	fclose(error_log);
+	if(error){
+		fprintf(stderr, "\nchecker found errors, see error_log.txt for details...\n");
+		exit(1);
+	}
+
+	return NULL;
+}
+#endif /* SCHED_DEADLINE */
+
+#ifdef EARLY_STOP
+/*
+ * early_stop_watch - judge, every EARLY_STOP_INTERVAL cycles,
+ * whether the CPUs have reached a steady state, and stop the
+ * simulation when all of them have. It runs in the main thread
+ * so that MSER and the percentile sort never take time from a
+ * simulated CPU; it returns once the CPUs stop, for whatever
+ * reason
+ */
+static void early_stop_watch(void)
+{
+	int converged[NR_CPUS] = { 0 };
+	int i, n = 0;
+	struct timespec t_interval;
+
+	t_interval = usec_to_timespec(EARLY_STOP_INTERVAL * CYCLE_LEN);
+
+	while (n < online_cpus &&
+			!__atomic_load_n(&simulation_end, __ATOMIC_RELAXED)) {
+		nanosleep(&t_interval, NULL);
+		for (i = 0; i < online_cpus; i++)
+			if (!converged[i] && MEASURE_CONVERGED(EARLY_STOP_PROBE, i)) {
+				converged[i] = 1;
+				n++;
+			}
+	}
+
+	if (n == online_cpus)
+		__atomic_store_n(&simulation_converged, 1, __ATOMIC_RELAXED);
+}
+#endif
+
+/*
+ * leaf_data_struct - map the option letter of a backend to its
+ * operations and to the comparison functions its push and pull
+ * instances expect, return the size of an instance; used by the
+ * data structures built on top of another one
+ * @c:				option letter
+ * @ops:			where to store the backend operations
+ * @push_cmp:	where to store the push comparison function
+ * @pull_cmp:	where to store the pull comparison function
+ */
+size_t leaf_data_struct(char c, struct data_struct_ops **ops,
+		int (**push_cmp)(__u64 a, __u64 b), int (**pull_cmp)(__u64 a, __u64 b))
+{
+	size_t size;
+
+	/* heaps want the root to be the latest deadline for push */
+	*push_cmp = __dl_time_before;
+	*pull_cmp = __dl_time_after;
+
+	switch (c) {
+		case 'h':
+			*ops = &heap_ops;
+			size = sizeof(heap_t);
+			break;
+		case 'a':
+			*ops = &array_heap_ops;
+			size = sizeof(array_heap_t);
+			break;
+		case 'c':
+			*ops = &cpudl_ops;
+			size = sizeof(cpudl_t);
+			break;
+		case 's':
+			*ops = &dl_skiplist_ops;
+			size = sizeof(dl_skiplist_t);
+			break;
+		case 'f':
+			*ops = &fc_dl_skiplist_ops;
+			size = sizeof(fc_dl_skiplist_t);
+			break;
+		case 'b':
+			*ops = &bm_fc_skiplist_ops;
+			size = sizeof(fc_sl_t);
+			break;
+		case 't':
+			*ops = &tournament_tree_ops;
+			size = sizeof(tournament_tree_t);
+			break;
+		case 'l':
+			*ops = &lf_dl_skiplist_ops;
+			size = sizeof(lf_dl_skiplist_t);
+			break;
+		case 'v':
+			*ops = &flat_array_ops;
+			size = sizeof(flat_array_t);
+			break;
+		case 'w':
+			*ops = &calendar_ops;
+			size = sizeof(cal_t);
+			break;
+		case 'z':
+			*ops = &lazy_dl_skiplist_ops;
+			size = sizeof(lazy_dl_skiplist_t);
+			break;
+		default:
+			printf("%c can't be used as leaf data structure!\n", c);
+			exit(-1);
+	}
+
+	/* lists keep the best CPU first */
+	if (*ops != &heap_ops && *ops != &array_heap_ops && *ops != &cpudl_ops) {
+		*push_cmp = __dl_time_after;
+		*pull_cmp = __dl_time_before;
+	}
+
+	return size;
+}
+
 /*
  * parse_user_options - parse command line arguments
  * @argc: arguments count
@@ -755,19 +1148,37 @@ void *checker(void *arg)
 data_struct_t parse_user_options(int argc, char **argv)
 {
 	data_struct_t data_type = HEAP;
+	size_t leaf_size;
 	int c;
 
 	if (argc < 2) {
 		printf("usage: %s OPTION\n"
 			"\n\tOPTION:\n"
 			"\t  -a array_heap\n"
+			"\t  -c cpudl (Linux cpudeadline)\n"
 			"\t  -h heap\n"
 			"\t  -s skiplist\n"
+			"\t  -l lock_free_skiplist\n"
+			"\t  -z lazy_skiplist (per-node locks)\n"
 			"\t  -f flat_combining_skiplist\n"
-			"\t  -b bitmap_flat_combining_skiplist\n\n", argv[0]);
+			"\t  -b bitmap_flat_combining_skiplist\n"
+			"\t  -t tournament_tree\n"
+			"\t  -v flat_array (SIMD scan)\n"
+			"\t  -m multiqueue (approximate find)\n"
+			"\t  -w calendar (timing wheel)\n"
+			"\t  -G single global runqueue (global EDF), no push and pull\n"
+			"\t  -g <leaf> hierarchical, per LLC groups of <leaf>,\n"
+			"\t  -C <leaf> flat combining wrapper around <leaf>\n"
+			"\t  -A <leaf> <leaf> switching between lock and flat combining\n"
+			"\t  -D <leaf> <leaf> owned by a server thread on the last CPU\n"
+			"\t           <leaf> is one of h, a, c, s, f, b, t, l, v, w, z\n"
+			"\t  -L <lock> lock of runqueues and global data structures,\n"
+			"\t           one of spin (default), tas, ttas, ticket, mcs, clh, cohort\n"
+			"\t  -q <queue> queue of the runqueues,\n"
+			"\t           one of binomial (default), pairing, dary\n\n", argv[0]);
 		exit(-1);
 	}
-	while ((c = getopt(argc, argv, "hasfb")) != -1)
+	while ((c = getopt(argc, argv, "hasfbctlvmwzGg:C:A:D:L:q:")) != -1)
 		switch (c) {
 			case 'h':
 				data_type = HEAP;
@@ -781,12 +1192,24 @@ data_struct_t parse_user_options(int argc, char **argv)
 				push_data_struct = &push_array_heap;
 				pull_data_struct = &pull_array_heap;
 				break;
+			case 'c':
+				data_type = CPUDL;
+				dso = &cpudl_ops;
+				push_data_struct = &push_cpudl;
+				pull_data_struct = &pull_cpudl;
+				break;
 			case 's':
 				data_type = SKIPLIST;
 				dso = &dl_skiplist_ops;
 				push_data_struct = &push_dl_skiplist;
 				pull_data_struct = &pull_dl_skiplist;
 				break;
+			case 'l':
+				data_type = LF_SKIPLIST;
+				dso = &lf_dl_skiplist_ops;
+				push_data_struct = &push_lf_skiplist;
+				pull_data_struct = &pull_lf_skiplist;
+				break;
 			case 'f':
 				data_type = FC_SKIPLIST;
 				dso = &fc_dl_skiplist_ops;
@@ -799,6 +1222,96 @@ data_struct_t parse_user_options(int argc, char **argv)
 				push_data_struct = &push_bm_fc_skiplist;
 				pull_data_struct = &pull_bm_fc_skiplist;
 				break;
+			case 't':
+				data_type = TOURNAMENT_TREE;
+				dso = &tournament_tree_ops;
+				push_data_struct = &push_tournament_tree;
+				pull_data_struct = &pull_tournament_tree;
+				break;
+			case 'v':
+				data_type = FLAT_ARRAY;
+				dso = &flat_array_ops;
+				push_data_struct = &push_flat_array;
+				pull_data_struct = &pull_flat_array;
+				break;
+			case 'm':
+				data_type = MULTIQUEUE;
+				dso = &mq_ops;
+				push_data_struct = &push_mq;
+				pull_data_struct = &pull_mq;
+				break;
+			case 'w':
+				data_type = CALENDAR;
+				dso = &calendar_ops;
+				push_data_struct = &push_calendar;
+				pull_data_struct = &pull_calendar;
+				break;
+			case 'z':
+				data_type = LAZY_SKIPLIST;
+				dso = &lazy_dl_skiplist_ops;
+				push_data_struct = &push_lazy_skiplist;
+				pull_data_struct = &pull_lazy_skiplist;
+				break;
+			case 'G':
+#ifdef SCHED_DEADLINE
+				data_type = GLOBAL_EDF;
+#else
+				printf("global runqueue is available only with SCHED_DEADLINE!\n");
+				exit(-1);
+#endif
+				break;
+			case 'g':
+				data_type = HIERARCHICAL;
+				leaf_size = leaf_data_struct(optarg[0], &leaf_dso,
+						&leaf_push_cmp, &leaf_pull_cmp);
+				dso = &hier_ops;
+				push_data_struct = &push_hier;
+				pull_data_struct = &pull_hier;
+				hier_set_leaf(push_data_struct, leaf_dso, leaf_size);
+				hier_set_leaf(pull_data_struct, leaf_dso, leaf_size);
+				break;
+			case 'C':
+				data_type = FC_WRAPPER;
+				leaf_size = leaf_data_struct(optarg[0], &leaf_dso,
+						&leaf_push_cmp, &leaf_pull_cmp);
+				dso = &fcw_ops;
+				push_data_struct = &push_fcw;
+				pull_data_struct = &pull_fcw;
+				fcw_set_leaf(push_data_struct, leaf_dso, leaf_size);
+				fcw_set_leaf(pull_data_struct, leaf_dso, leaf_size);
+				break;
+			case 'A':
+				data_type = ADAPTIVE;
+				leaf_size = leaf_data_struct(optarg[0], &leaf_dso,
+						&leaf_push_cmp, &leaf_pull_cmp);
+				dso = &adapt_ops;
+				push_data_struct = &push_adapt;
+				pull_data_struct = &pull_adapt;
+				adapt_set_leaf(push_data_struct, leaf_dso, leaf_size);
+				adapt_set_leaf(pull_data_struct, leaf_dso, leaf_size);
+				break;
+			case 'D':
+				data_type = DELEGATION;
+				leaf_size = leaf_data_struct(optarg[0], &leaf_dso,
+						&leaf_push_cmp, &leaf_pull_cmp);
+				dso = &deleg_ops;
+				push_data_struct = &push_deleg;
+				pull_data_struct = &pull_deleg;
+				deleg_set_leaf(push_data_struct, leaf_dso, leaf_size);
+				deleg_set_leaf(pull_data_struct, leaf_dso, leaf_size);
+				break;
+			case 'L':
+				if (lock_select(optarg)) {
+					printf("%s isn't a valid lock!\n", optarg);
+					exit(-1);
+				}
+				break;
+			case 'q':
+				if (rq_queue_select(optarg)) {
+					printf("%s isn't a valid queue!\n", optarg);
+					exit(-1);
+				}
+				break;
 			default:
 				printf("data_type is not valid!\n");
 				exit(-1);
@@ -811,8 +1324,10 @@ int main(int argc, char **argv)
 {
 #ifndef MEASURE
     pthread_t check;
+    void *(*checker_body)(void *) = checker;
 #endif
     data_struct_t data_type;
+    void *(*cpu_body)(void *) = processor;
     int ind[NR_CPUS];
     int i;
 
@@ -869,9 +1384,13 @@ int main(int argc, char **argv)
     srand(time(NULL));
 
     data_type = parse_user_options(argc, argv);
+    printf("Using %s locks\n", lock_name());
+    printf("Using %s runqueues\n", rq_queue_name());
 
     switch (data_type) {
 	    case HEAP:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_before);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_after);
     		printf("Initializing the heap\n");
 				break;
 	    case ARRAY_HEAP:
@@ -879,21 +1398,89 @@ int main(int argc, char **argv)
 				dso->data_init(pull_data_struct, online_cpus, __dl_time_after);
     		printf("Initializing the array_heap\n");
 				break;
+	    case CPUDL:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_before);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_after);
+				printf("Initializing the cpudl\n");
+				break;
 	    case SKIPLIST:
 				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
 				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
 				printf("Initializing the skiplist\n");
 				break;
+	    case LF_SKIPLIST:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
+				printf("Initializing the lock_free_skiplist\n");
+				break;
 	    case FC_SKIPLIST:
 				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
 				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
 				printf("Initializing the flat_combining_skiplist\n");
 				break;
 			case BM_FC_SKIPLIST:
-				dso->data_init(push_data_struct, NR_CPUS, __dl_time_after);
-				dso->data_init(pull_data_struct, NR_CPUS, __dl_time_before);
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
 				printf("Initializing the bitmap_flat_combining_skiplist\n");
 				break;
+			case TOURNAMENT_TREE:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
+				printf("Initializing the tournament_tree\n");
+				break;
+			case FLAT_ARRAY:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
+				printf("Initializing the flat_array\n");
+				break;
+			case MULTIQUEUE:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_before);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_after);
+				printf("Initializing the multiqueue\n");
+				break;
+			case CALENDAR:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
+				printf("Initializing the calendar\n");
+				break;
+			case LAZY_SKIPLIST:
+				dso->data_init(push_data_struct, online_cpus, __dl_time_after);
+				dso->data_init(pull_data_struct, online_cpus, __dl_time_before);
+				printf("Initializing the lazy_skiplist\n");
+				break;
+			case HIERARCHICAL:
+				dso->data_init(push_data_struct, online_cpus, leaf_push_cmp);
+				dso->data_init(pull_data_struct, online_cpus, leaf_pull_cmp);
+				printf("Initializing the hierarchical data structure\n");
+				break;
+			case FC_WRAPPER:
+				dso->data_init(push_data_struct, online_cpus, leaf_push_cmp);
+				dso->data_init(pull_data_struct, online_cpus, leaf_pull_cmp);
+				printf("Initializing the flat combining wrapper\n");
+				break;
+			case ADAPTIVE:
+				dso->data_init(push_data_struct, online_cpus, leaf_push_cmp);
+				dso->data_init(pull_data_struct, online_cpus, leaf_pull_cmp);
+				printf("Initializing the adaptive data structure\n");
+				break;
+			case DELEGATION:
+				/* the server takes the last CPU, the simulation the others */
+				if (online_cpus > 1)
+					online_cpus--;
+				dso->data_init(push_data_struct, online_cpus, leaf_push_cmp);
+				dso->data_init(pull_data_struct, online_cpus, leaf_pull_cmp);
+				printf("Initializing the delegation data structure\n");
+				break;
+#ifdef SCHED_DEADLINE
+			case GLOBAL_EDF:
+				grq_init(&grq, online_cpus);
+				cpu_body = global_processor;
+#ifndef MEASURE
+				checker_body = global_checker;
+#endif
+				printf("Initializing the global runqueue\n");
+				break;
+#endif
 	    default:
 				exit(-1);
     }
@@ -909,7 +1496,7 @@ int main(int argc, char **argv)
 #ifndef MEASURE
     printf("Creating Checker\n");
 
-    pthread_create(&check, 0, checker, 0);
+    pthread_create(&check, 0, checker_body, 0);
 #endif
 
     printf("Creating processors\n");
@@ -920,11 +1507,15 @@ int main(int argc, char **argv)
 
     for (i = 0; i < online_cpus; i++) {
         ind[i] = i;
-        pthread_create(&threads[i], 0, processor, &ind[i]);
+        pthread_create(&threads[i], 0, cpu_body, &ind[i]);
     }
 
     printf("Waiting for the end\n");
 
+#ifdef EARLY_STOP
+    early_stop_watch();
+#endif
+
     for (i = 0; i < online_cpus; i++) {
         pthread_join(threads[i], 0);
 				printf("+++++++++++++++++++++++++++++++++\n");
@@ -935,11 +1526,20 @@ int main(int argc, char **argv)
         printf("Num Queue Empty events  [%d]: %d\n", i, num_empty[i]);
 				printf("Num Push from runqueue [%d]: %d\n", i, num_push[i]);
 				printf("Num Pull to runqueue [%d]: %d\n", i, num_pull[i]);
+#ifdef EARLY_STOP
+				printf("Num Cycles [%d]: %llu\n", i, simulated_cycles[i]);
+#endif
     }
     printf("--------------EVERYTHING OK!---------------------\n");
     
-		dso->data_cleanup(push_data_struct);
-		dso->data_cleanup(pull_data_struct);
+		if (data_type == GLOBAL_EDF) {
+#ifdef SCHED_DEADLINE
+			grq_destroy(&grq);
+#endif
+		} else {
+			dso->data_cleanup(push_data_struct);
+			dso->data_cleanup(pull_data_struct);
+		}
 
 		sem_destroy(&start_barrier_sem);
 		sem_destroy(&end_barrier_sem);
@@ -0,0 +1,534 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runqueue queues selectable at startup. Runqueues are short,
+ * a handful of tasks, so pointer chasing and the allocation of
+ * the binomial heap nodes may cost more than the algorithm
+ * saves: the pairing heap links the tasks themselves, the
+ * d-ary heap keeps them in an array, RQ_DARY_ARITY children
+ * per node so that a sift down touches few cache lines.
+ *
+ * The second earliest task, that push and pull look at all the
+ * time, is a child of the root in both: peek_next scans those.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rq_queue.h"
+#include "common_ops.h"
+#include "kernel_data_struct.h"
+#include "parameters.h"
+
+#define DARY_MIN_CAPACITY		8
+
+static rq_queue_type_t rq_queue_type = RQ_QUEUE_BINOMIAL;
+
+static const char *rq_queue_names[] = {
+	[RQ_QUEUE_BINOMIAL] = "binomial",
+	[RQ_QUEUE_PAIRING] = "pairing",
+	[RQ_QUEUE_DARY] = "dary"
+};
+
+int rq_queue_select(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(rq_queue_names) / sizeof(rq_queue_names[0]); i++)
+		if (!strcmp(name, rq_queue_names[i])) {
+			rq_queue_type = (rq_queue_type_t)i;
+			return 0;
+		}
+
+	return -1;
+}
+
+const char *rq_queue_name(void)
+{
+	return rq_queue_names[rq_queue_type];
+}
+
+/* return > 0 if the task of a has to run before the one of b */
+static inline int node_before(struct rq_queue_node *a, struct rq_queue_node *b)
+{
+#ifdef SCHED_DEADLINE
+	return __dl_time_before(a->task->deadline, b->task->deadline);
+#endif
+#ifdef SCHED_RT
+	return __prio_higher(a->task->prio, b->task->prio);
+#endif
+}
+
+/* binomial heap */
+static int binomial_before(struct rq_heap_node *a, struct rq_heap_node *b)
+{
+	return node_before((struct rq_queue_node *)rq_heap_node_value(a),
+			(struct rq_queue_node *)rq_heap_node_value(b));
+}
+
+static inline struct task_struct *binomial_task(struct rq_heap_node *hn)
+{
+	return hn ? ((struct rq_queue_node *)rq_heap_node_value(hn))->task : NULL;
+}
+
+static struct task_struct *binomial_release(struct rq_heap_node *hn)
+{
+	struct rq_queue_node *node;
+
+	if (!hn)
+		return NULL;
+
+	node = (struct rq_queue_node *)rq_heap_node_value(hn);
+	node->u.binomial = NULL;
+	free(hn);
+
+	return node->task;
+}
+
+static void binomial_insert(struct rq_heap *heap, struct rq_queue_node *node)
+{
+	node->u.binomial = calloc(1, sizeof(*node->u.binomial));
+	if (!node->u.binomial) {
+		fprintf(stderr, "out of memory\n");
+		fflush(stderr);
+		exit(-1);
+	}
+
+	rq_heap_node_init_ref(&node->u.binomial, node);
+	rq_heap_insert(binomial_before, heap, node->u.binomial);
+}
+
+static void binomial_print(struct rq_heap_node *hn,
+		void (*fn)(struct task_struct *task, FILE *out), FILE *out)
+{
+	if (!hn)
+		return;
+
+	fn(binomial_task(hn), out);
+	binomial_print(hn->child, fn, out);
+	binomial_print(hn->next, fn, out);
+}
+
+/* pairing heap */
+static struct rq_queue_node *pairing_meld(struct rq_queue_node *a,
+		struct rq_queue_node *b)
+{
+	struct rq_queue_node *tmp;
+
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+
+	if (node_before(b, a)) {
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* b becomes the leftmost child of a */
+	b->u.pairing.prev = a;
+	b->u.pairing.sibling = a->u.pairing.child;
+	if (a->u.pairing.child)
+		a->u.pairing.child->u.pairing.prev = b;
+	a->u.pairing.child = b;
+
+	return a;
+}
+
+/* two pass merge of a list of siblings, returns the new root */
+static struct rq_queue_node *pairing_merge_pairs(struct rq_queue_node *first)
+{
+	struct rq_queue_node *a, *b, *next, *stack = NULL, *root = NULL;
+
+	/* left to right, meld pairs and stack the results */
+	while (first) {
+		a = first;
+		b = a->u.pairing.sibling;
+		next = b ? b->u.pairing.sibling : NULL;
+
+		a->u.pairing.sibling = a->u.pairing.prev = NULL;
+		if (b)
+			b->u.pairing.sibling = b->u.pairing.prev = NULL;
+
+		a = pairing_meld(a, b);
+		a->u.pairing.sibling = stack;
+		stack = a;
+		first = next;
+	}
+
+	/* right to left, meld everything into the last one */
+	while (stack) {
+		next = stack->u.pairing.sibling;
+		stack->u.pairing.sibling = NULL;
+		root = pairing_meld(root, stack);
+		stack = next;
+	}
+
+	return root;
+}
+
+static void pairing_insert(struct rq_queue *q, struct rq_queue_node *node)
+{
+	node->u.pairing.child = NULL;
+	node->u.pairing.sibling = NULL;
+	node->u.pairing.prev = NULL;
+
+	q->u.pairing = pairing_meld(q->u.pairing, node);
+}
+
+static struct rq_queue_node *pairing_peek_next(struct rq_queue *q)
+{
+	struct rq_queue_node *pos, *best = NULL;
+
+	if (!q->u.pairing)
+		return NULL;
+
+	for (pos = q->u.pairing->u.pairing.child; pos; pos = pos->u.pairing.sibling)
+		if (!best || node_before(pos, best))
+			best = pos;
+
+	return best;
+}
+
+static void pairing_remove(struct rq_queue *q, struct rq_queue_node *node)
+{
+	struct rq_queue_node *prev = node->u.pairing.prev;
+	struct rq_queue_node *sub;
+
+	if (node == q->u.pairing) {
+		q->u.pairing = pairing_merge_pairs(node->u.pairing.child);
+		node->u.pairing.child = NULL;
+		return;
+	}
+
+	/* cut the subtree rooted in node */
+	if (prev->u.pairing.child == node)
+		prev->u.pairing.child = node->u.pairing.sibling;
+	else
+		prev->u.pairing.sibling = node->u.pairing.sibling;
+	if (node->u.pairing.sibling)
+		node->u.pairing.sibling->u.pairing.prev = prev;
+	node->u.pairing.sibling = node->u.pairing.prev = NULL;
+
+	sub = pairing_merge_pairs(node->u.pairing.child);
+	node->u.pairing.child = NULL;
+	q->u.pairing = pairing_meld(q->u.pairing, sub);
+}
+
+static void pairing_print(struct rq_queue_node *node,
+		void (*fn)(struct task_struct *task, FILE *out), FILE *out)
+{
+	for (; node; node = node->u.pairing.sibling) {
+		fn(node->task, out);
+		pairing_print(node->u.pairing.child, fn, out);
+	}
+}
+
+/* d-ary heap */
+static inline void dary_set(struct rq_queue *q, int i, struct rq_queue_node *node)
+{
+	q->u.dary.heap[i] = node;
+	node->u.index = i;
+}
+
+static void dary_sift_up(struct rq_queue *q, int i)
+{
+	struct rq_queue_node *node = q->u.dary.heap[i];
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / RQ_DARY_ARITY;
+		if (!node_before(node, q->u.dary.heap[parent]))
+			break;
+		dary_set(q, i, q->u.dary.heap[parent]);
+		i = parent;
+	}
+	dary_set(q, i, node);
+}
+
+static void dary_sift_down(struct rq_queue *q, int i)
+{
+	struct rq_queue_node *node = q->u.dary.heap[i];
+	int child, last, best;
+
+	for (;;) {
+		child = i * RQ_DARY_ARITY + 1;
+		if (child >= q->u.dary.size)
+			break;
+		last = child + RQ_DARY_ARITY;
+		if (last > q->u.dary.size)
+			last = q->u.dary.size;
+
+		for (best = child++; child < last; child++)
+			if (node_before(q->u.dary.heap[child], q->u.dary.heap[best]))
+				best = child;
+
+		if (!node_before(q->u.dary.heap[best], node))
+			break;
+		dary_set(q, i, q->u.dary.heap[best]);
+		i = best;
+	}
+	dary_set(q, i, node);
+}
+
+static void dary_insert(struct rq_queue *q, struct rq_queue_node *node)
+{
+	struct rq_queue_node **heap;
+	int capacity;
+
+	if (q->u.dary.size == q->u.dary.capacity) {
+		capacity = q->u.dary.capacity ? 2 * q->u.dary.capacity : DARY_MIN_CAPACITY;
+		heap = realloc(q->u.dary.heap, capacity * sizeof(*heap));
+		if (!heap) {
+			fprintf(stderr, "out of memory\n");
+			fflush(stderr);
+			exit(-1);
+		}
+		q->u.dary.heap = heap;
+		q->u.dary.capacity = capacity;
+	}
+
+	dary_set(q, q->u.dary.size++, node);
+	dary_sift_up(q, node->u.index);
+}
+
+static int dary_peek_next(struct rq_queue *q)
+{
+	int child, last, best = -1;
+
+	last = RQ_DARY_ARITY + 1;
+	if (last > q->u.dary.size)
+		last = q->u.dary.size;
+
+	for (child = 1; child < last; child++)
+		if (best == -1 || node_before(q->u.dary.heap[child], q->u.dary.heap[best]))
+			best = child;
+
+	return best;
+}
+
+static struct task_struct *dary_remove(struct rq_queue *q, int i)
+{
+	struct rq_queue_node *node, *last;
+
+	if (i < 0 || i >= q->u.dary.size)
+		return NULL;
+
+	node = q->u.dary.heap[i];
+	last = q->u.dary.heap[--q->u.dary.size];
+	if (i < q->u.dary.size) {
+		dary_set(q, i, last);
+		dary_sift_down(q, i);
+		dary_sift_up(q, last->u.index);
+	}
+	node->u.index = -1;
+
+	return node->task;
+}
+
+/* interface */
+void rq_queue_init(struct rq_queue *q)
+{
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		rq_heap_init(&q->u.binomial);
+		break;
+	case RQ_QUEUE_PAIRING:
+		q->u.pairing = NULL;
+		break;
+	case RQ_QUEUE_DARY:
+		q->u.dary.heap = NULL;
+		q->u.dary.size = 0;
+		q->u.dary.capacity = 0;
+		break;
+	}
+}
+
+/* the tasks still queued are left alone */
+void rq_queue_destroy(struct rq_queue *q)
+{
+	if (rq_queue_type == RQ_QUEUE_DARY) {
+		free(q->u.dary.heap);
+		q->u.dary.heap = NULL;
+		q->u.dary.size = q->u.dary.capacity = 0;
+	}
+}
+
+int rq_queue_empty(struct rq_queue *q)
+{
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		return rq_heap_empty(&q->u.binomial);
+	case RQ_QUEUE_PAIRING:
+		return q->u.pairing == NULL;
+	case RQ_QUEUE_DARY:
+		return q->u.dary.size == 0;
+	}
+
+	return 1;
+}
+
+/*
+ * rq_queue_insert - enqueue a task
+ * @q:			the queue
+ * @node:		linkage of the task, node->task must be set
+ */
+void rq_queue_insert(struct rq_queue *q, struct rq_queue_node *node)
+{
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		binomial_insert(&q->u.binomial, node);
+		break;
+	case RQ_QUEUE_PAIRING:
+		pairing_insert(q, node);
+		break;
+	case RQ_QUEUE_DARY:
+		dary_insert(q, node);
+		break;
+	}
+}
+
+/*
+ * rq_queue_remove - dequeue a task wherever it is
+ * @q:			the queue
+ * @node:		linkage of the task
+ */
+void rq_queue_remove(struct rq_queue *q, struct rq_queue_node *node)
+{
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		rq_heap_delete(binomial_before, &q->u.binomial, node->u.binomial);
+		binomial_release(node->u.binomial);
+		break;
+	case RQ_QUEUE_PAIRING:
+		pairing_remove(q, node);
+		break;
+	case RQ_QUEUE_DARY:
+		dary_remove(q, node->u.index);
+		break;
+	}
+}
+
+/* rq_queue_peek - return the earliest task, NULL if empty */
+struct task_struct *rq_queue_peek(struct rq_queue *q)
+{
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		return binomial_task(rq_heap_peek(binomial_before, &q->u.binomial));
+	case RQ_QUEUE_PAIRING:
+		return q->u.pairing ? q->u.pairing->task : NULL;
+	case RQ_QUEUE_DARY:
+		return q->u.dary.size ? q->u.dary.heap[0]->task : NULL;
+	}
+
+	return NULL;
+}
+
+/* rq_queue_peek_next - return the second earliest task, NULL if none */
+struct task_struct *rq_queue_peek_next(struct rq_queue *q)
+{
+	struct rq_queue_node *node;
+	int i;
+
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		return binomial_task(rq_heap_peek_next(binomial_before, &q->u.binomial));
+	case RQ_QUEUE_PAIRING:
+		node = pairing_peek_next(q);
+		return node ? node->task : NULL;
+	case RQ_QUEUE_DARY:
+		i = dary_peek_next(q);
+		return i != -1 ? q->u.dary.heap[i]->task : NULL;
+	}
+
+	return NULL;
+}
+
+/* rq_queue_take - dequeue the earliest task, NULL if empty */
+struct task_struct *rq_queue_take(struct rq_queue *q)
+{
+	struct rq_queue_node *node;
+
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		return binomial_release(rq_heap_take(binomial_before, &q->u.binomial));
+	case RQ_QUEUE_PAIRING:
+		node = q->u.pairing;
+		if (!node)
+			return NULL;
+		pairing_remove(q, node);
+		return node->task;
+	case RQ_QUEUE_DARY:
+		return dary_remove(q, 0);
+	}
+
+	return NULL;
+}
+
+/* rq_queue_take_next - dequeue the second earliest task, NULL if none */
+struct task_struct *rq_queue_take_next(struct rq_queue *q)
+{
+	struct rq_queue_node *node;
+
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		return binomial_release(rq_heap_take_next(binomial_before, &q->u.binomial));
+	case RQ_QUEUE_PAIRING:
+		node = pairing_peek_next(q);
+		if (!node)
+			return NULL;
+		pairing_remove(q, node);
+		return node->task;
+	case RQ_QUEUE_DARY:
+		return dary_remove(q, dary_peek_next(q));
+	}
+
+	return NULL;
+}
+
+/*
+ * rq_queue_for_each - call fn on every queued task, in no
+ * particular order, debugging only
+ */
+void rq_queue_for_each(struct rq_queue *q,
+		void (*fn)(struct task_struct *task, FILE *out), FILE *out)
+{
+	int i;
+
+	switch (rq_queue_type) {
+	case RQ_QUEUE_BINOMIAL:
+		/* min and next are cached out of the heap */
+		if (q->u.binomial.min)
+			fn(binomial_task(q->u.binomial.min), out);
+		if (q->u.binomial.next)
+			fn(binomial_task(q->u.binomial.next), out);
+		binomial_print(q->u.binomial.head, fn, out);
+		break;
+	case RQ_QUEUE_PAIRING:
+		pairing_print(q->u.pairing, fn, out);
+		break;
+	case RQ_QUEUE_DARY:
+		for (i = 0; i < q->u.dary.size; i++)
+			fn(q->u.dary.heap[i]->task, out);
+		break;
+	}
+}
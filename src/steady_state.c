@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include "steady_state.h"
+
+/*
+ * steady_state_start - return the index of the first
+ * steady state sample, that is the number of warm-up
+ * samples to drop, according to MSER-5
+ * @samples:				samples, in the order they were recorded
+ * @total_number:		number of samples
+ */
+long long unsigned steady_state_start(long long unsigned *samples, const long long unsigned total_number)
+{
+	long long unsigned batches, d, i, best_d;
+	double *means;
+	double sum, sum_sq, stat, best_stat;
+	long long unsigned m;
+
+	batches = total_number / MSER_BATCH_SIZE;
+	if(batches < 2)
+		return 0;
+
+	means = (double *)calloc(batches, sizeof(*means));
+	if(!means){
+		fprintf(stderr, "calloc(): %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	for(d = 0; d < batches; d++){
+		for(i = 0; i < MSER_BATCH_SIZE; i++)
+			means[d] += samples[d * MSER_BATCH_SIZE + i];
+		means[d] /= MSER_BATCH_SIZE;
+	}
+
+	/*
+	 * walk the batches backward keeping the sums of
+	 * the means (and of their squares) from d to the end,
+	 * the truncation point is searched only in the first
+	 * half of the run
+	 */
+	sum = sum_sq = 0;
+	best_stat = -1;
+	best_d = 0;
+	for(d = batches; d-- > 0;){
+		sum += means[d];
+		sum_sq += means[d] * means[d];
+		if(d > batches / 2)
+			continue;
+
+		m = batches - d;
+		stat = (sum_sq - sum * sum / m) / ((double)m * m);
+		if(best_stat < 0 || stat <= best_stat){
+			best_stat = stat;
+			best_d = d;
+		}
+	}
+
+	free(means);
+
+	return best_d * MSER_BATCH_SIZE;
+}
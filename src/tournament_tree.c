@@ -0,0 +1,257 @@
+/*
+ * Copyright © 2012  Fabio Falzoi, Juri Lelli, Giuseppe Lipari
+ *
+ * This file is part of PRAcTISE.
+ *
+ * PRAcTISE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * PRAcTISE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with PRAcTISE.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/types.h>
+
+#include "tournament_tree.h"
+#include "common_ops.h"
+#include "parameters.h"
+
+/*
+ * tt_winner - return the best of two packed nodes,
+ * an empty one always loses
+ * @t:	the tournament tree
+ * @a:	first contender
+ * @b:	second contender
+ */
+static inline __u64 tt_winner(tournament_tree_t *t, __u64 a, __u64 b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+
+	return t->cmp_dl(TT_DL(b), TT_DL(a)) ? b : a;
+}
+
+static inline __u64 tt_load(tournament_tree_t *t, int i)
+{
+	return __atomic_load_n(&t->nodes[i].w, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * tt_refresh - recompute node i out of its children
+ * and try to install the result with a CAS, return 1
+ * on success; the resulting value is stored in @new
+ * @t:		the tournament tree
+ * @i:		the node to refresh
+ * @old:	where to store the value replaced
+ * @new:	where to store the value computed
+ */
+static inline int tt_refresh(tournament_tree_t *t, int i, __u64 *old, __u64 *new)
+{
+	*old = tt_load(t, i);
+	*new = tt_winner(t, tt_load(t, 2 * i), tt_load(t, 2 * i + 1));
+
+	return __atomic_compare_exchange_n(&t->nodes[i].w, old, *new, 0,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void tt_init(void *s, int nproc, int (*cmp_dl)(__u64 a, __u64 b))
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+	int err;
+
+	if (nproc > TT_CPU_MASK - 1) {
+		fprintf(stderr, "tournament tree supports at most %llu CPUs\n",
+				TT_CPU_MASK - 1);
+		exit(-1);
+	}
+
+	t->nproc = nproc;
+	t->cmp_dl = cmp_dl;
+	for (t->leaves = 1; t->leaves < nproc; t->leaves <<= 1)
+		;
+
+	err = posix_memalign((void **)&t->nodes, sizeof(tt_node_t),
+			2 * t->leaves * sizeof(tt_node_t));
+	if (err) {
+		fprintf(stderr, "posix_memalign(): %s\n", strerror(err));
+		exit(-1);
+	}
+	memset(t->nodes, 0, 2 * t->leaves * sizeof(tt_node_t));
+}
+
+void tt_cleanup(void *s)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+
+	free(t->nodes);
+}
+
+/*
+ * tt_set - update the leaf of a CPU and propagate
+ * the change towards the root
+ * @s:				the tournament tree
+ * @cpu:			the CPU to update
+ * @dline:		its new deadline
+ * @is_valid:	0 if the CPU leaves the tree
+ *
+ * No lock is taken: every ancestor is refreshed
+ * with a CAS, twice if the first one fails. If both
+ * fail, somebody else installed a value computed after
+ * our first attempt began, hence after our child was
+ * written. The walk stops as soon as a refresh
+ * succeeds without changing the node, the ancestors
+ * are then already up to date (or about to be, by
+ * whoever changed the node last).
+ */
+int tt_set(void *s, int cpu, __u64 dline, int is_valid)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+	__u64 old, new;
+	int i;
+
+	if (cpu < 0 || cpu >= t->nproc) {
+		fprintf(stderr, "WARNING: tt_set on CPU %d, only %d CPUs available\n",
+				cpu, t->nproc);
+		return -1;
+	}
+	if (is_valid && dline > TT_DL_MAX) {
+		fprintf(stderr, "deadline %llu doesn't fit in %d bits\n",
+				dline, TT_DL_BITS);
+		exit(-1);
+	}
+
+	i = t->leaves + cpu;
+	__atomic_store_n(&t->nodes[i].w, is_valid ? TT_PACK(dline, cpu) : 0,
+			__ATOMIC_RELEASE);
+
+	for (i >>= 1; i > 0; i >>= 1) {
+		if (tt_refresh(t, i, &old, &new)) {
+			if (old == new)
+				break;
+		} else {
+			tt_refresh(t, i, &old, &new);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * tt_find_dl - read the root, return the winner CPU
+ * and its deadline, -1 if the tree is empty
+ * @s:			the tournament tree
+ * @dline:	where to store the deadline
+ */
+int tt_find_dl(void *s, __u64 *dline)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+	__u64 w;
+
+	w = tt_load(t, 1);
+	if (!w) {
+		*dline = 0;
+		return -1;
+	}
+
+	*dline = TT_DL(w);
+
+	return TT_CPU(w);
+}
+
+int tt_find(void *s)
+{
+	__u64 dline;
+
+	return tt_find_dl(s, &dline);
+}
+
+void tt_save(void *s, int nproc, FILE *f)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+	int i, level = 2;
+	__u64 w;
+
+	fprintf(f, "Tournament tree (%d leaves):\n", t->leaves);
+	for (i = 1; i < 2 * t->leaves; i++) {
+		w = tt_load(t, i);
+		if (w)
+			fprintf(f, "(%d, %llu) ", TT_CPU(w), TT_DL(w));
+		else
+			fprintf(f, "(-) ");
+		if (i == level - 1) {
+			fprintf(f, "\n");
+			level <<= 1;
+		}
+	}
+}
+
+void tt_print(void *s, int nproc)
+{
+	tt_save(s, nproc, stdout);
+}
+
+/*
+ * tt_check - verify that every internal node is the winner
+ * of its children and that leaves are in the right place;
+ * to be called while no update is in progress
+ */
+int tt_check(void *s, int nproc)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+	__u64 w;
+	int i;
+
+	for (i = 0; i < t->leaves; i++) {
+		w = tt_load(t, t->leaves + i);
+		if (w && (i >= nproc || TT_CPU(w) != i)) {
+			printf("Leaf %d holds CPU %d!\n", i, TT_CPU(w));
+			tt_print(s, nproc);
+			return 0;
+		}
+	}
+
+	for (i = 1; i < t->leaves; i++) {
+		w = tt_winner(t, tt_load(t, 2 * i), tt_load(t, 2 * i + 1));
+		if (tt_load(t, i) != w) {
+			printf("Node %d doesn't hold the winner of its children!\n", i);
+			tt_print(s, nproc);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int tt_check_cpu(void *s, int cpu, __u64 dline)
+{
+	tournament_tree_t *t = (tournament_tree_t *)s;
+
+	return tt_load(t, t->leaves + cpu) == (dline ? TT_PACK(dline, cpu) : 0);
+}
+
+const struct data_struct_ops tournament_tree_ops = {
+	.data_init = tt_init,
+	.data_cleanup = tt_cleanup,
+	.data_preempt = tt_set,
+	.data_finish = tt_set,
+	.data_find = tt_find,
+	.data_find_dl = tt_find_dl,
+	.data_max = tt_find,
+	.data_save = tt_save,
+	.data_print = tt_print,
+	.data_check = tt_check,
+	.data_check_cpu = tt_check_cpu
+};
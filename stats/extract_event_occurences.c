@@ -4,15 +4,12 @@
 #include <string.h>
 
 #define MAX_LINE	100
-#define MAX_SAMPLES	48
 
 int main(int argc, char *argv[])
 {
 	char line[MAX_LINE];
-	int rate[MAX_SAMPLES];
 	int index, sample;
 	char useless[MAX_LINE];
-	int i;
 	long long unsigned sum;
 	FILE *in;
 
@@ -24,18 +21,16 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	memset(rate, 0, sizeof(*rate) * MAX_SAMPLES);
-
+	sum = 0ULL;
 	while(fgets(line, MAX_LINE, in)){
-		if(strstr(line, "rate"))
-			if(sscanf(line, "[%d]: %s rate: %d event/s", &index, useless, &sample) != 3){
-				fprintf(stderr, "sscanf:\t%s\n", strerror(errno));
-				exit(1);
-			}
-			rate[index] = sample;
+		if(!strstr(line, "rate"))
+			continue;
+		if(sscanf(line, "[%d]: %s rate: %d event/s", &index, useless, &sample) != 3){
+			fprintf(stderr, "sscanf:\t%s\n", strerror(errno));
+			exit(1);
+		}
+		sum += sample;
 	}
-	for(i = 0, sum = 0ULL; i <= index; i++)
-		sum += rate[i];
 
 	printf("%llu\n", sum);
 
@@ -0,0 +1,173 @@
+#! /bin/bash
+# Build a scaling report out of a sweep of PRAcTISE simulations.
+#
+# usage: plot_sweep.sh sweep_dir [report_dir]
+#
+# sweep_dir must contain one directory for every backend, and each of
+# them the out_<probe>_<cpus> files of the runs made with that backend:
+#
+#	sweep_dir/array_heap/out_push_find_2
+#	sweep_dir/array_heap/out_push_find_4
+#	...
+#	sweep_dir/skiplist/out_push_find_2
+#	...
+#
+# For every probe the script writes into report_dir (default: report)
+# a latency-vs-CPUs graph with median and 99th percentile curves and a
+# boxplot graph, both with all the backends overlaid. If enqueue and
+# dequeue counters are there, it also writes a throughput-vs-CPUs graph.
+# The .dat and .gnu files are always generated, the svg graphs only if
+# gnuplot is installed.
+
+# Exit on errors
+set -e
+
+if [ -z "$1" ] || [ ! -d "$1" ]
+then
+	echo "usage: $0 sweep_dir [report_dir]"
+	exit 1
+fi
+
+sweep_dir=${1%/}
+report_dir=${2:-report}
+stats_dir=$(cd "$(dirname "$0")" && pwd)
+
+for tool in sweep_stats extract_event_occurences
+do
+	if [ ! -x "$stats_dir/$tool" ]
+	then
+		echo "$tool not found, run make in $stats_dir first"
+		exit 1
+	fi
+done
+
+mkdir -p "$report_dir"
+
+backends=$(cd "$sweep_dir" && ls -d */ | tr -d '/')
+# out_<probe>_<cpus> -> <probe>, event counters are handled apart
+probes=$(cd "$sweep_dir" && ls */out_* | sed 's|.*/out_||; s|_[0-9]*$||' | grep -v '_number$' | sort -u)
+cpus_list=$(cd "$sweep_dir" && ls */out_* | sed 's|.*_||' | sort -n -u)
+
+# xtics and positions for boxplots are given by the CPUs numbers found
+xtics=""
+pos=1
+for cpus in $cpus_list
+do
+	xtics="$xtics${xtics:+, }\"$cpus\" $pos"
+	pos=$((pos + 1))
+done
+n_backends=$(echo $backends | wc -w)
+box_width=$(awk "BEGIN { print 0.8 / $n_backends }")
+
+# common graph header
+header() {
+	echo "set terminal svg size 800,600 dynamic font 'Arial,12'"
+	echo "set output '$1.svg'"
+	echo "set title '$2'"
+	echo "set xlabel 'CPUs number'"
+	echo "set ylabel '$3'"
+	echo "set key outside right top"
+	echo "set grid"
+}
+
+for probe in $probes
+do
+	latency_plot=""
+	box_plot=""
+	b=0
+	for backend in $backends
+	do
+		# median and p99 for every CPUs number
+		dat="$report_dir/${probe}_$backend.dat"
+		: > "$dat"
+		pos=1
+		for cpus in $cpus_list
+		do
+			out="$sweep_dir/$backend/out_${probe}_$cpus"
+			if [ -s "$out" ]
+			then
+				echo -e "$cpus\t$("$stats_dir/sweep_stats" "$out")" >> "$dat"
+				samples="$report_dir/${probe}_${backend}_$cpus.samples"
+				"$stats_dir/sweep_stats" -s "$out" > "$samples"
+				x=$(awk "BEGIN { print $pos + ($b - ($n_backends - 1) / 2) * $box_width }")
+				if [ -z "$box_title_done" ]
+				then
+					title="title '$backend'"
+					box_title_done=1
+				else
+					title="notitle"
+				fi
+				box_plot="$box_plot${box_plot:+, }'${probe}_${backend}_$cpus.samples' using ($x):1 lc $((b + 1)) $title"
+			fi
+			pos=$((pos + 1))
+		done
+		unset box_title_done
+
+		latency_plot="$latency_plot${latency_plot:+, }'${probe}_$backend.dat' using 1:2 with linespoints lc $((b + 1)) dt 1 title '$backend median'"
+		latency_plot="$latency_plot, '${probe}_$backend.dat' using 1:3 with linespoints lc $((b + 1)) dt 2 title '$backend p99'"
+		b=$((b + 1))
+	done
+
+	{
+		header "${probe}_latency" "$probe" "cycles"
+		echo "set autoscale y"
+		echo "set xtics ($(echo $cpus_list | sed 's/ /, /g'))"
+		echo "plot $latency_plot"
+	} > "$report_dir/${probe}_latency.gnu"
+
+	{
+		header "${probe}_boxplot" "$probe" "cycles"
+		echo "set style boxplot nooutliers"
+		echo "set style fill empty"
+		echo "set style data boxplot"
+		echo "set boxwidth $box_width"
+		echo "set xtics ($xtics) scale 0.0"
+		echo "set xrange [0.5:$((pos - 1)).5]"
+		echo "plot $box_plot"
+	} > "$report_dir/${probe}_boxplot.gnu"
+done
+
+# throughput: enqueue + dequeue operations per second, all CPUs
+throughput_plot=""
+b=0
+for backend in $backends
+do
+	dat="$report_dir/throughput_$backend.dat"
+	: > "$dat"
+	for cpus in $cpus_list
+	do
+		enqueue="$sweep_dir/$backend/out_enqueue_number_$cpus"
+		dequeue="$sweep_dir/$backend/out_dequeue_number_$cpus"
+		if [ -s "$enqueue" ] && [ -s "$dequeue" ]
+		then
+			ops=$(( $("$stats_dir/extract_event_occurences" "$enqueue") + $("$stats_dir/extract_event_occurences" "$dequeue") ))
+			echo -e "$cpus\t$ops" >> "$dat"
+		fi
+	done
+	if [ -s "$dat" ]
+	then
+		throughput_plot="$throughput_plot${throughput_plot:+, }'throughput_$backend.dat' using 1:2 with linespoints lc $((b + 1)) title '$backend'"
+	fi
+	b=$((b + 1))
+done
+
+if [ -n "$throughput_plot" ]
+then
+	{
+		header "throughput" "enqueue + dequeue throughput" "operations/s"
+		echo "set autoscale y"
+		echo "set xtics ($(echo $cpus_list | sed 's/ /, /g'))"
+		echo "plot $throughput_plot"
+	} > "$report_dir/throughput.gnu"
+fi
+
+if which gnuplot > /dev/null 2>&1
+then
+	cd "$report_dir"
+	for script in *.gnu
+	do
+		gnuplot "$script"
+	done
+else
+	echo "gnuplot not found, only .dat and .gnu files have been written in $report_dir"
+fi
@@ -1,14 +1,17 @@
+/* floorl(), ceill() and roundl() are C99 */
+#define _ISOC99_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 #include <math.h>
 
-#define TRANSIENT_RATE		0.1
+#include "steady_state.h"
 
 #define BUFLEN						100
 
-//#define DEBUG
+/* #define DEBUG */
 
 void usage(const char *name);
 void remove_transient_samples(long long unsigned **samples, long long unsigned *total_number, const int cpus);
@@ -53,8 +56,8 @@ void remove_transient_samples(long long unsigned **samples, long long unsigned *
 	long long unsigned invalid;
 
 	for(i = 0; i < cpus; i++){
-		invalid = (long long unsigned)(total_number[i] * TRANSIENT_RATE);	
-		memcpy(&samples[i][0], &samples[i][invalid], (total_number[i] - invalid) * sizeof(**samples));
+		invalid = steady_state_start(samples[i], total_number[i]);
+		memmove(&samples[i][0], &samples[i][invalid], (total_number[i] - invalid) * sizeof(**samples));
 		total_number[i] -= invalid;
 	}
 }
@@ -62,7 +65,7 @@ void remove_transient_samples(long long unsigned **samples, long long unsigned *
 long long unsigned samples_avg(long long unsigned *samples, const long long unsigned total_number)
 {
 	long long unsigned sum = 0;
-	int i;
+	long long unsigned i;
 
 	for(i = 0; i < total_number; i++)
 		sum += samples[i];
@@ -100,7 +103,8 @@ void make_stats(FILE *in)
 	long long unsigned **samples;
 	long long unsigned *success_ops;
 	long long unsigned *fail_ops;
-	int i, j;
+	int i;
+	long long unsigned j;
 	char buffer[BUFLEN];
 	int ch, outcome_flag;
 	long double index;
@@ -220,7 +224,8 @@ int compare(const void *a, const void *b)
 
 void print_all(int cpus, long long unsigned *total_number, long long unsigned **samples, long long unsigned *success_ops, long long unsigned *fail_ops)
 {
-	int i, j;
+	int i;
+	long long unsigned j;
 
 	printf("cpus: %d\n\n", cpus);
 	for(i = 0; i < cpus; i++){
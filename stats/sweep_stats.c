@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+
+#include "steady_state.h"
+
+#define BUFLEN						100
+
+/*
+ * sweep_stats reads a single out_<probe>_<cpus> file written
+ * by the simulator (one sample per line, CPUs separated by an
+ * empty line), drops the warm-up samples of every CPU, as
+ * detected by steady_state_start(), and pools what is left.
+ * By default it prints "median p99 samples" on a single line,
+ * with -s it prints the pooled steady state samples instead
+ * (used by plot_sweep.sh to draw the boxplots).
+ */
+
+void usage(const char *name);
+void append_samples(long long unsigned **pool, long long unsigned *pool_size, long long unsigned *pool_len, long long unsigned *cpu_samples, const long long unsigned cpu_len);
+long long unsigned read_samples(FILE *in, long long unsigned **pool);
+double percentile_index(const long long unsigned total_number, const float percentage);
+double percentile_value(long long unsigned *samples, const double index, const long long unsigned total_number);
+
+int compare(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+	FILE *in;
+	long long unsigned *samples;
+	long long unsigned total_number, i;
+	int dump;
+
+	dump = argc > 2 && !strcmp(argv[1], "-s");
+	if(argc < 2 || (argc > 2 && !dump)){
+		usage(argv[0]);
+		exit(0);
+	}
+
+	in = fopen(argv[argc - 1], "r");
+	if(!in){
+		fprintf(stderr, "fopen: %s\n", strerror(errno));
+		exit(-1);
+	}
+
+	total_number = read_samples(in, &samples);
+	fclose(in);
+
+	if(dump){
+		for(i = 0; i < total_number; i++)
+			printf("%llu\n", samples[i]);
+	} else if(total_number){
+		qsort(samples, total_number, sizeof(*samples), compare);
+		printf("%.0f\t", percentile_value(samples, percentile_index(total_number, 0.50), total_number));
+		printf("%.0f\t", percentile_value(samples, percentile_index(total_number, 0.99), total_number));
+		printf("%llu\n", total_number);
+	}
+
+	free(samples);
+
+	return 0;
+}
+
+void usage(const char *name)
+{
+	printf("usage: %s [-s] file_name\n", name);
+}
+
+void append_samples(long long unsigned **pool, long long unsigned *pool_size, long long unsigned *pool_len, long long unsigned *cpu_samples, const long long unsigned cpu_len)
+{
+	long long unsigned invalid;
+
+	invalid = steady_state_start(cpu_samples, cpu_len);
+
+	while(*pool_len + cpu_len - invalid > *pool_size){
+		*pool_size = *pool_size ? *pool_size * 2 : BUFLEN;
+		*pool = (long long unsigned *)realloc(*pool, *pool_size * sizeof(**pool));
+		if(!*pool){
+			fprintf(stderr, "realloc: %s\n", strerror(errno));
+			exit(-1);
+		}
+	}
+
+	memcpy(&(*pool)[*pool_len], &cpu_samples[invalid], (cpu_len - invalid) * sizeof(*cpu_samples));
+	*pool_len += cpu_len - invalid;
+}
+
+long long unsigned read_samples(FILE *in, long long unsigned **pool)
+{
+	long long unsigned *cpu_samples = NULL;
+	long long unsigned cpu_size = 0, cpu_len = 0;
+	long long unsigned pool_size = 0, pool_len = 0;
+	char buffer[BUFLEN];
+	long long unsigned sample;
+
+	*pool = NULL;
+
+	while(fgets(buffer, BUFLEN, in)){
+		if(sscanf(buffer, "%llu", &sample) != 1){
+			/* an empty line closes the samples of a CPU */
+			append_samples(pool, &pool_size, &pool_len, cpu_samples, cpu_len);
+			cpu_len = 0;
+			continue;
+		}
+
+		if(cpu_len == cpu_size){
+			cpu_size = cpu_size ? cpu_size * 2 : BUFLEN;
+			cpu_samples = (long long unsigned *)realloc(cpu_samples, cpu_size * sizeof(*cpu_samples));
+			if(!cpu_samples){
+				fprintf(stderr, "realloc: %s\n", strerror(errno));
+				exit(-1);
+			}
+		}
+		cpu_samples[cpu_len++] = sample;
+	}
+	append_samples(pool, &pool_size, &pool_len, cpu_samples, cpu_len);
+
+	free(cpu_samples);
+
+	return pool_len;
+}
+
+double percentile_index(const long long unsigned total_number, const float percentage)
+{
+	double quantile = percentage;
+
+	return (total_number + 1) * quantile - 1;
+}
+
+double percentile_value(long long unsigned *samples, const double index, const long long unsigned total_number)
+{
+	long long unsigned prev, next;
+	double value;
+
+	if(index <= 0)
+		return (double)samples[0];
+
+	prev = (long long unsigned int)floor(index);
+	next = (long long unsigned int)ceil(index);
+	if(next >= total_number)
+		return (double)samples[total_number - 1];
+
+	/* linear interpolation */
+	value = (double)samples[prev] + (index - floor(index)) * ((double)samples[next] - samples[prev]);
+
+	return value;
+}
+
+int compare(const void *a, const void *b)
+{
+	long long unsigned first, second;
+
+	first = *(long long unsigned *)a;
+	second = *(long long unsigned *)b;
+
+	return (first > second) - (first < second);
+}